@@ -0,0 +1,61 @@
+/**
+ * Ensembles of simulations
+ *
+ * This example shows how to run many copies of a REBOUNDx simulation in parallel,
+ * here a sweep over the strength of stochastic forces acting on a planet, with several
+ * independent realizations for each strength. Compile with make OPENMP=1 to spread
+ * the members over all available cores (set OMP_NUM_THREADS to limit them).
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "rebound.h"
+#include "reboundx.h"
+
+int main(int argc, char* argv[]){
+    // We first set up a template simulation with the effects we want, as we would for a single run
+    struct reb_simulation* sim = reb_simulation_create();
+    sim->integrator     = REB_INTEGRATOR_WHFAST;
+    sim->dt             = 1e-2;
+
+    reb_simulation_add_fmt(sim, "m", 1.); // Sun
+    reb_simulation_add_fmt(sim, "m a", 1e-3, 1.0); // Jupiter mass planet at 1AU
+    reb_simulation_move_to_com(sim);
+
+    struct rebx_extras* rebx = rebx_attach(sim);
+    struct rebx_force* sto = rebx_load_force(rebx, "stochastic_forces");
+    rebx_add_force(rebx, sto);
+    rebx_set_param_double(rebx, &sim->particles[1].ap, "kappa", 1e-5);
+
+    // Now we make copies of the simulation (including the REBOUNDx effects and parameters).
+    // Each member gets a different random seed, so the stochastic forces differ between them.
+    const int N_kappa = 4;
+    const int N_realizations = 8;
+    const int N_members = N_kappa*N_realizations;
+    struct rebx_ensemble* ensemble = rebx_create_ensemble(sim, N_members);
+
+    // Override kappa on the planet in each member. Anything else can be changed by
+    // modifying ensemble->sims[m] and its extras (ensemble->sims[m]->extras) directly.
+    double kappas[N_members];
+    for (int m=0; m<N_members; m++){
+        kappas[m] = 1e-6*pow(10., m/N_realizations);
+    }
+    rebx_ensemble_set_particle_param_double(ensemble, 1, "kappa", kappas);
+
+    // Integrate all members and collect their final positions and velocities into one array
+    const double tmax = 1e3*2.*M_PI;
+    const int N_outputs = 6*sim->N;
+    double* outputs = malloc(N_members*N_outputs*sizeof(*outputs));
+    rebx_ensemble_integrate(ensemble, tmax, rebx_ensemble_collect_particles, outputs, N_outputs, NULL);
+
+    for (int m=0; m<N_members; m++){
+        struct reb_orbit o = reb_orbit_from_particle(sim->G, ensemble->sims[m]->particles[1], ensemble->sims[m]->particles[0]);
+        printf("kappa = %.1e\tx = %+.8e\ta = %.8f\n", kappas[m], outputs[m*N_outputs + 6], o.a);
+    }
+
+    free(outputs);
+    rebx_free_ensemble(ensemble);   // frees all the member simulations and their REBOUNDx extras
+    rebx_free(rebx);
+    reb_simulation_free(sim);
+}
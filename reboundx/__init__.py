@@ -42,9 +42,9 @@ def params(self):
 
 rebound.Particle.params = params
 
-from .extras import Extras, Param, Node, Force, Operator, integrators, Interpolator
+from .extras import Extras, Param, Node, Force, Operator, integrators, Interpolator, load_plugin
 from .simulationarchive import Simulationarchive
 from .tools import coordinates, install_test
 from .params import Params
 
-__all__ = ["__version__", "__build__", "__githash__", "Extras", "Simulationarchive", "Param", "Interpolator", "Params", "coordinates", "integrators"]
+__all__ = ["__version__", "__build__", "__githash__", "Extras", "Simulationarchive", "Param", "Interpolator", "Params", "coordinates", "integrators", "load_plugin"]
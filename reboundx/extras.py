@@ -1,8 +1,9 @@
 from . import clibreboundx
-from ctypes import Structure, c_double, POINTER, c_int, c_uint, c_long, c_ulong, c_void_p, c_char_p, CFUNCTYPE, byref, c_uint32, c_uint, cast, c_char, pointer
+from ctypes import Structure, c_double, POINTER, c_int, c_uint, c_long, c_ulong, c_ulonglong, c_size_t, c_void_p, c_char_p, CFUNCTYPE, byref, c_uint32, c_uint, cast, c_char, pointer
 import rebound
 import reboundx
 import warnings
+import os
 
 integrators = {"implicit_midpoint": 0, "rk4":1, "euler": 2, "rk2": 3, "none": -1}
 
@@ -28,6 +29,19 @@ REBX_BINARY_WARNINGS = [
     (False,16384, "REBOUNDx: Binary file was saved with a different version of REBOUNDx. Binary format might have changed. Check that effects and parameters are loaded as expected.")
 ]
 
+def load_plugin(filename):
+    """
+    Loads a shared library of user-defined effects, which can then be added by name with
+    Extras.load_force and Extras.load_operator. See :ref:`add_effect` for how to write one.
+
+    Parameters
+    ----------
+    filename : str
+        Path to the shared library.
+    """
+    if not clibreboundx.rebx_load_plugin(c_char_p(filename.encode('ascii'))):
+        raise RuntimeError("REBOUNDx: Could not load plugin {0}. See error message above.".format(filename))
+
 class Extras(Structure):
     """
     Main object used for all REBOUNDx operations, tied to a particular REBOUND simulation.
@@ -36,22 +50,33 @@ class Extras(Structure):
     The fastest way to understand it is to follow the examples at :ref:`ipython_examples`.
     """
 
-    def __new__(cls, sim, filename=None):
+    def __new__(cls, sim, filename=None, snapshot=None):
         rebx = super(Extras,cls).__new__(cls)
         return rebx
 
-    def __init__(self, sim, filename=None):
+    def __init__(self, sim, filename=None, snapshot=None):
+        """
+        Arguments
+        ---------
+        sim : rebound.Simulation
+            Simulation to attach to.
+        filename : str, optional
+            REBOUNDx binary or archive to load the effects and parameters from.
+        snapshot : int, optional
+            Index of the snapshot to load from an archive written with save_to_archive (negative values count from the end).
+            By default the first snapshot is loaded.
+        """
         sim._extras_ref = self # add a reference to this instance in sim to make sure it's not garbage collected_
-        clibreboundx.rebx_initialize(byref(sim), byref(self))
+        clibreboundx.rebx_initialize(byref(sim), byref(self)) # built-in params are always registered
         # Create simulation
-        if filename==None:
-            # Create a new rebx instance
-           clibreboundx.rebx_register_default_params(byref(self))
-        else:
+        if filename is not None:
             # Recreate existing simulation.
             # Load registered parameters from binary
             w = c_int(0)
-            clibreboundx.rebx_init_extras_from_binary(byref(self), c_char_p(filename.encode('ascii')), byref(w))
+            if snapshot is None:
+                clibreboundx.rebx_init_extras_from_binary(byref(self), c_char_p(filename.encode('ascii')), byref(w))
+            else:
+                clibreboundx.rebx_init_extras_from_archive(byref(self), c_char_p(filename.encode('ascii')), c_int(snapshot), byref(w))
             for majorerror, value, message in REBX_BINARY_WARNINGS:
                 if w.value & value:
                     if majorerror:
@@ -148,6 +173,22 @@ class Extras(Structure):
         if not success:
             raise AttributeError("REBOUNDx Error: Operator {0} passed to rebx.remove_operator not found in simulation.")
 
+    def enable_orbit_cache(self):
+        """
+        Lets effects share the orbital elements they calculate within one evaluation of the forces (off by default).
+        Results can differ from runs without the cache in the last bits.
+        """
+        clibreboundx.rebx_enable_orbit_cache(byref(self))
+        self.process_messages()
+
+    def disable_orbit_cache(self):
+        clibreboundx.rebx_disable_orbit_cache.restype = None
+        clibreboundx.rebx_disable_orbit_cache(byref(self))
+
+    @property
+    def orbit_cache_enabled(self):
+        return bool(self._orbit_cache)
+
     #######################################
     # Input/Output Routines
     #######################################
@@ -158,6 +199,65 @@ class Extras(Structure):
         clibreboundx.rebx_output_binary(byref(self), c_char_p(filename.encode("ascii")))
         self.process_messages()
 
+    def save_to_archive(self, filename, delete_file=False):
+        """
+        Append a snapshot of all effects and parameters, labeled with the simulation's t and steps_done, to a REBOUNDx archive.
+        Pair with sim.save_to_file to open both with reboundx.Simulationarchive.
+
+        Arguments
+        ---------
+        filename : str
+            Filename of the archive. Created if it doesn't exist.
+        delete_file : bool, optional
+            Start a new archive, deleting any existing file.
+        """
+        if delete_file and os.path.isfile(filename):
+            os.remove(filename)
+        clibreboundx.rebx_output_binary_archive(byref(self), c_char_p(filename.encode("ascii")))
+        self.process_messages()
+
+    def enable_async_output(self, max_pending=4, callback=None):
+        """
+        Start a background thread that writes the binaries passed to save_async.
+
+        Arguments
+        ---------
+        max_pending : int, optional
+            Number of snapshots that can wait to be written. While that many are waiting, save_async skips snapshots rather than waiting for the disk.
+        callback : function, optional
+            Called on the writer thread as callback(filename, success) after each snapshot. It must not use the simulation being integrated.
+        """
+        if callback is None:
+            acb = ASYNCOUTPUTFUNCPTR()
+        else:
+            acb = ASYNCOUTPUTFUNCPTR(lambda filename, success, context: callback(filename.decode('ascii'), bool(success)))
+        # The C call first writes out snapshots queued with the old callback, so only replace the reference to it (which keeps it from being garbage collected) afterwards
+        clibreboundx.rebx_enable_async_output(byref(self), c_int(max_pending), acb, None)
+        self._acb = acb
+        self.process_messages()
+
+    def disable_async_output(self):
+        """
+        Wait for the snapshots passed to save_async to be written, and stop the writer thread.
+        """
+        clibreboundx.rebx_disable_async_output.restype = None
+        clibreboundx.rebx_disable_async_output(byref(self))
+
+    def save_async(self, filename):
+        """
+        Same as save, but only copies the effects and parameters and leaves writing them to disk to a background thread (see enable_async_output).
+        Returns False if the snapshot was skipped because earlier ones are still being written.
+        """
+        queued = clibreboundx.rebx_output_binary_async(byref(self), c_char_p(filename.encode("ascii")))
+        self.process_messages()
+        return bool(queued)
+
+    def wait_async_output(self):
+        """
+        Wait until all snapshots passed to save_async have been written. Returns the number that could not be written since the last call.
+        """
+        return clibreboundx.rebx_wait_async_output(byref(self))
+
     #######################################
     # Effect Specific Functions
     #######################################
@@ -245,6 +345,7 @@ class Param(Structure): # need to define fields afterward because of circular re
     pass
 Param._fields_ =  [ ("name", c_char_p),
                     ("type", c_int),
+                    ("id", c_int),
                     ("value", c_void_p)]
 
 class Node(Structure): # need to define fields afterward because of circular ref in linked list
@@ -252,6 +353,18 @@ class Node(Structure): # need to define fields afterward because of circular ref
 Node._fields_ =  [  ("object", c_void_p),
                     ("next", POINTER(Node))]
 
+class Arena(Structure):
+    """
+    Memory pool REBOUNDx allocates its nodes, params, forces, operators and steps from.
+    used, peak and reserved are in bytes.
+    """
+    _fields_ = [("_chunks", c_void_p),
+                ("_large", c_void_p),
+                ("_free_lists", c_void_p*16),
+                ("used", c_size_t),
+                ("peak", c_size_t),
+                ("reserved", c_size_t)]
+
 class Operator(Structure):
     @property
     def operator_type(self):
@@ -284,7 +397,9 @@ Operator._fields_ = [   ("name", c_char_p),
                         ("ap", POINTER(Node)),
                         ("_sim", POINTER(rebound.Simulation)),
                         ("_operator_type", c_int),
-                        ("_step_function", STEPFUNCPTR)]
+                        ("_step_function", STEPFUNCPTR),
+                        ("_workspace", c_void_p),
+                        ("_workspace_size", c_size_t)]
 class Force(Structure):
     @property
     def force_type(self):
@@ -309,12 +424,22 @@ class Force(Structure):
         return params
 
 FORCEFUNCPTR = CFUNCTYPE(None, POINTER(rebound.Simulation), POINTER(Force), POINTER(rebound.Particle), c_int)
+ASYNCOUTPUTFUNCPTR = CFUNCTYPE(None, c_char_p, c_int, c_void_p)
 
 Force._fields_ = [  ("name", c_char_p),
                     ("ap", POINTER(Node)),
                     ("_sim", POINTER(rebound.Simulation)),
                     ("_force_type", c_int),
-                    ("_update_accelerations", FORCEFUNCPTR)]
+                    ("_update_accelerations", FORCEFUNCPTR),
+                    ("_prepare", c_void_p),
+                    ("_plan", c_void_p),
+                    ("_plan_N", c_int),
+                    ("_plan_version", c_ulong),
+                    ("_plan_param_ids", POINTER(c_int)),
+                    ("_N_plan_param_ids", c_int),
+                    ("_N_allocated_plan_param_ids", c_int),
+                    ("_workspace", c_void_p),
+                    ("_workspace_size", c_size_t)]
 
 # Need to put fields after class definition because of self-referencing
 Extras._fields_ =  [("_sim", POINTER(rebound.Simulation)),
@@ -323,7 +448,33 @@ Extras._fields_ =  [("_sim", POINTER(rebound.Simulation)),
                     ("_post_timestep_modifications", POINTER(Node)),
                     ("_registered_params", POINTER(Node)),
                     ("_allocated_forces", POINTER(Node)),
-                    ("_allocated_operators", POINTER(Node))]
+                    ("_allocated_operators", POINTER(Node)),
+                    ("_registered_param_table", POINTER(POINTER(Param))),
+                    ("_registered_param_hash", POINTER(c_int)),
+                    ("_N_registered_params", c_int),
+                    ("_N_allocated_registered_params", c_int),
+                    ("_registered_param_hash_size", c_int),
+                    ("_param_versions", POINTER(c_ulong)),
+                    ("_param_layout_version", c_ulong),
+                    ("_param_columns", POINTER(c_void_p)),
+                    ("_role_lists", POINTER(c_void_p)),
+                    ("_orbit_cache", c_void_p),
+                    ("_gravity_snapshot", c_void_p),
+                    ("_jacobi_frame", c_void_p),
+                    ("_evaluating_forces", c_int),
+                    ("_archive_state", c_void_p),
+                    ("archive_keyframe_interval", c_int),
+                    ("_async_output", c_void_p),
+                    ("_preparing_force", POINTER(Force)),
+                    ("arena", Arena)]
+
+class ArchiveEntry(Structure):
+    """
+    Entry in the index of a REBOUNDx archive (C struct rebx_archive_entry).
+    """
+    _fields_ = [("t", c_double),
+                ("steps_done", c_ulonglong),
+                ("offset", c_long)]
 
 class Interpolator(Structure):
     def __new__(cls, rebx, times, values, interpolation):
@@ -1,5 +1,9 @@
 import rebound
 import reboundx
+import bisect
+from ctypes import c_char_p, c_int
+from . import clibreboundx
+from .extras import ArchiveEntry
 
 class Simulationarchive(rebound.Simulationarchive):
     """
@@ -12,18 +16,45 @@ class Simulationarchive(rebound.Simulationarchive):
         filename : str
             Filename of the Simulationarchive file to be opened.
         rebxfilename : str
-            Filename of the REBOUNDx binary file.
+            Filename of the REBOUNDx archive written with Extras.save_to_archive. Each simulation snapshot is paired with
+            the REBOUNDx snapshot saved at the same steps_done, or else the last one saved before it. Getting a simulation
+            snapshot from before the first REBOUNDx snapshot raises a RuntimeError. A REBOUNDx binary written with
+            Extras.save is treated as an archive with a single snapshot.
         """
         super(Simulationarchive, self).__init__(filename, *args, **kwargs)
         self.rebxfilename = rebxfilename
-        sim, rebx = self[0] # test you can open rebxfilename to warn user if not
+        # Raises if rebxfilename can't be read. Doesn't load snapshot 0, which may predate every REBOUNDx snapshot.
+        self._read_rebx_index()
+
+    def _read_rebx_index(self):
+        name = c_char_p(self.rebxfilename.encode('ascii'))
+        N = clibreboundx.rebx_archive_read_index(name, None, c_int(0))
+        if N <= 0:
+            raise RuntimeError("REBOUNDx: Cannot read REBOUNDx binary {0}. Check filename.".format(self.rebxfilename))
+        entries = (ArchiveEntry*N)()
+        clibreboundx.rebx_archive_read_index(name, entries, c_int(N))
+        self._rebx_steps_done = {entry.steps_done: i for i, entry in enumerate(entries)}
+        # Snapshots are appended as the simulation goes, so steps_done only decreases if the archive mixes separate runs.
+        # Times can also decrease when integrating backwards, so snapshots are ordered by steps_done.
+        self._rebx_steps = [entry.steps_done for entry in entries]
+        self._rebx_monotonic = all(self._rebx_steps[i] <= self._rebx_steps[i+1] for i in range(N-1))
+
+    def _rebx_snapshot(self, sim):
+        snapshot = self._rebx_steps_done.get(sim.steps_done)
+        if snapshot is None:
+            if not self._rebx_monotonic:
+                raise RuntimeError("REBOUNDx: No snapshot in {0} was saved at steps_done = {1}, and the last one saved before it can't be found because steps_done in the archive is not increasing.".format(self.rebxfilename, sim.steps_done))
+            snapshot = bisect.bisect_right(self._rebx_steps, sim.steps_done) - 1
+            if snapshot < 0:
+                raise RuntimeError("REBOUNDx: No snapshot in {0} was saved at or before steps_done = {1}.".format(self.rebxfilename, sim.steps_done))
+        return snapshot
 
     def __getitem__(self, key):
         sim = super(Simulationarchive, self).__getitem__(key)
-        rebx = reboundx.Extras(sim, self.rebxfilename)
+        rebx = reboundx.Extras(sim, self.rebxfilename, snapshot=self._rebx_snapshot(sim))
         return sim, rebx
 
     def getSimulation(self, *args, **kwargs):
         sim = super(Simulationarchive, self).getSimulation(*args, **kwargs)
-        rebx = reboundx.Extras(sim, self.rebxfilename)
+        rebx = reboundx.Extras(sim, self.rebxfilename, snapshot=self._rebx_snapshot(sim))
         return sim, rebx
@@ -1,6 +1,26 @@
 import rebound
 import reboundx
 import unittest
+from ctypes import Structure, POINTER, byref, cast, c_char_p, c_int, c_void_p
+from reboundx import clibreboundx
+from reboundx.extras import FORCEFUNCPTR, REBX_FORCE_TYPE
+
+class ParamSchema(Structure):
+    _fields_ = [("name", c_char_p),
+                ("type", c_int)]
+
+class EffectDescriptor(Structure):
+    _fields_ = [("name", c_char_p),
+                ("update_accelerations", c_void_p),
+                ("prepare", c_void_p),
+                ("force_type", c_int),
+                ("step_function", c_void_p),
+                ("operator_type", c_int),
+                ("free_arrays", c_void_p),
+                ("params", POINTER(ParamSchema)),
+                ("N_params", c_int)]
+
+registered_descriptors = []
 
 class TestForces(unittest.TestCase):
     def setUp(self):
@@ -16,6 +36,40 @@ class TestForces(unittest.TestCase):
         with self.assertRaises(RuntimeError):
             gr = self.rebx.load_force('gr2')
 
+    def test_loadoperatorasforce(self):
+        with self.assertRaises(RuntimeError):
+            mm = self.rebx.load_force('modify_mass')
+
+    def test_loadpluginnotfound(self):
+        with self.assertRaises(RuntimeError):
+            reboundx.load_plugin('nonexistent_plugin.so')
+
+    def test_registereffect(self):
+        calls = []
+        def central_force(sim, force, particles, N):
+            calls.append(N)
+        ffp = FORCEFUNCPTR(central_force)
+        schema = (ParamSchema*1)(ParamSchema(b"test_registered_strength", 1)) # REBX_TYPE_DOUBLE
+        override = EffectDescriptor(name=b"central_force", update_accelerations=cast(ffp, c_void_p), force_type=REBX_FORCE_TYPE["pos"], params=schema, N_params=1)
+        # registrations are never dropped, so put the built-in back afterwards by registering it again
+        builtin = EffectDescriptor(name=b"central_force", update_accelerations=cast(clibreboundx.rebx_central_force, c_void_p), force_type=REBX_FORCE_TYPE["pos"])
+        # descriptors are not copied, and lookups of other names walk past these for the rest of the process
+        registered_descriptors.extend([ffp, schema, override, builtin])
+        self.assertEqual(clibreboundx.rebx_get_type(byref(self.rebx), b"test_registered_strength"), 0)
+        self.assertEqual(clibreboundx.rebx_register_effect(byref(override)), 1)
+        try:
+            force = self.rebx.load_force('central_force')
+            self.assertEqual(clibreboundx.rebx_get_type(byref(self.rebx), b"test_registered_strength"), 1)
+            force.params['test_registered_strength'] = 2.
+            self.assertEqual(force.params['test_registered_strength'], 2.)
+            self.rebx.add_force(force)
+            self.sim.integrate(1.)
+            self.assertGreater(len(calls), 0)
+            self.assertEqual(calls[0], self.sim.N)
+        finally:
+            self.assertEqual(clibreboundx.rebx_register_effect(byref(builtin)), 1)
+        self.assertNotEqual(cast(self.rebx.load_force('central_force').update_accelerations, c_void_p).value, cast(ffp, c_void_p).value)
+
     def test_customforce(self):
         cust = self.rebx.create_force('myforce')
         def myforce(sim, force, particles, N):
@@ -73,6 +127,130 @@ class TestForces(unittest.TestCase):
         self.rebx.add_force(cust)
         self.rebx.remove_force(gr)
     
+    def test_forceplaninvalidation(self):
+        # gr caches c in its plan, which must be rebuilt when c is changed between integrations
+        sim2 = self.sim.copy()
+        gr = self.rebx.load_force('gr')
+        self.rebx.add_force(gr)
+        gr.params['c'] = 1.e30
+        self.sim.integrate(10.)
+        sim2.integrate(10.)
+        self.assertAlmostEqual(self.sim.particles[1].pomega, sim2.particles[1].pomega, delta=1.e-12)
+        gr.params['c'] = 10.
+        self.sim.integrate(20.)
+        sim2.integrate(20.)
+        self.assertGreater(abs(self.sim.particles[1].pomega - sim2.particles[1].pomega), 1.e-6)
+
+    def test_rolecacheinvalidation(self):
+        # radiation_forces caches which particle is the radiation source, which has to move with it when a particle is removed
+        sims = []
+        for extra in [True, False]:
+            sim = rebound.Simulation()
+            if extra:
+                sim.add(m=0., x=100.)
+            sim.add(m=1.)
+            sim.add(a=1., e=0.1)
+            rebx = reboundx.Extras(sim)
+            rad = rebx.load_force('radiation_forces')
+            rebx.add_force(rad)
+            rad.params['c'] = 1.e4
+            sim.particles[-2].params['radiation_source'] = 1
+            sim.particles[-1].params['beta'] = 0.1
+            sim.integrate(1.)
+            sims.append((sim, rebx))
+        sim, sim2 = sims[0][0], sims[1][0]
+        sim.remove(0)
+        sim.integrate(10.)
+        sim2.integrate(10.)
+        self.assertAlmostEqual(sim.particles[1].x, sim2.particles[1].x, delta=1.e-8)
+
+    def test_orbitcache(self):
+        # exponential_migration and modify_orbits_forces both need semimajor axes in Jacobi coordinates, which the cache shares
+        sims = []
+        for cache in [False, True]:
+            sim = rebound.Simulation()
+            sim.add(m=1.)
+            sim.add(m=1.e-4, a=1., e=0.1)
+            sim.add(m=1.e-4, a=2., e=0.1, inc=0.1)
+            rebx = reboundx.Extras(sim)
+            if cache:
+                rebx.enable_orbit_cache()
+            em = rebx.load_force('exponential_migration')
+            rebx.add_force(em)
+            mof = rebx.load_force('modify_orbits_forces')
+            rebx.add_force(mof)
+            mof.params['ide_position'] = 0.5
+            mof.params['ide_width'] = 0.1
+            for p in sim.particles[1:]:
+                p.params['em_tau_a'] = 1.e3
+                p.params['em_aini'] = 1.
+                p.params['em_afin'] = 2.
+                p.params['tau_a'] = -1.e4
+            sim.integrate(100.)
+            self.assertEqual(rebx.orbit_cache_enabled, cache)
+            sims.append((sim, rebx))
+        for i in [1, 2]:
+            self.assertAlmostEqual(sims[0][0].particles[i].a, sims[1][0].particles[i].a, delta=1.e-10)
+        sims[1][1].disable_orbit_cache()
+        self.assertFalse(sims[1][1].orbit_cache_enabled)
+
+    def test_grreusegravity(self):
+        # WHFast skips the interaction between the star and the first planet in its gravity routine, which has to be added back
+        for integrator in ['ias15', 'whfast']:
+            for name in ['gr', 'gr_full']:
+                sims = []
+                for reuse in [0, 1]:
+                    sim = rebound.Simulation()
+                    sim.integrator = integrator
+                    sim.dt = 1.e-3
+                    sim.add(m=1.)
+                    sim.add(m=1.e-3, a=1., e=0.2)
+                    sim.add(m=1.e-3, a=2., e=0.1)
+                    rebx = reboundx.Extras(sim)
+                    gr = rebx.load_force(name)
+                    rebx.add_force(gr)
+                    gr.params['c'] = 100.
+                    gr.params['gr_reuse_gravity'] = reuse
+                    sim.integrate(10.)
+                    sims.append((sim, rebx))
+                for i in [1, 2]:
+                    self.assertAlmostEqual(sims[0][0].particles[i].pomega, sims[1][0].particles[i].pomega, delta=1.e-10)
+
+    def test_jacobiframe(self):
+        # Jacobi coordinates are shared between forces within an evaluation, but have to be recalculated once the particles move
+        gr = self.rebx.load_force('gr')
+        self.rebx.add_force(gr)
+        gr.params['c'] = 100.
+        mof = self.rebx.load_force('modify_orbits_forces')
+        self.rebx.add_force(mof)
+        mof.params['coordinates'] = reboundx.coordinates['JACOBI']
+        self.sim.add(m=1.e-3, a=2.)
+        self.sim.particles[2].params['tau_a'] = -1.e4
+        self.rebx.gr_hamiltonian(gr)
+        self.sim.integrate(10.)
+        sim2 = self.sim.copy()
+        rebx2 = reboundx.Extras(sim2)
+        gr2 = rebx2.load_force('gr')
+        gr2.params['c'] = 100.
+        self.assertEqual(self.rebx.gr_hamiltonian(gr), rebx2.gr_hamiltonian(gr2))
+
+    def test_grwarmstarttelemetry(self):
+        sim2 = self.sim.copy()
+        rebx2 = reboundx.Extras(sim2)
+        gr = self.rebx.load_force('gr_full')
+        self.rebx.add_force(gr)
+        gr.params['c'] = 100.
+        gr2 = rebx2.load_force('gr_full')
+        rebx2.add_force(gr2)
+        gr2.params['c'] = 100.
+        gr2.params['gr_warm_start'] = 1
+        self.sim.integrate(10.)
+        sim2.integrate(10.)
+        self.assertAlmostEqual(self.sim.particles[1].pomega, sim2.particles[1].pomega, delta=1.e-12)
+        self.assertEqual(gr.params['gr_nonconverged'], 0)
+        self.assertLessEqual(gr2.params['gr_iterations'], gr.params['gr_iterations'])
+        self.assertLess(gr2.params['gr_max_residual'], 1.e-15)
+
     def test_removenonforce(self):
         with self.assertRaises(TypeError):
             self.rebx.remove_force(self.sim)
@@ -167,6 +345,26 @@ class TestOperators(unittest.TestCase):
         self.rebx.add_operator(cust, dtfraction=0.5, timing='pre')
         self.rebx.remove_operator(mm)
     
+    def test_paramcolumnupdates(self):
+        # modify_mass reads tau_mass from a cached column, which must see params set, added and removed between steps
+        self.sim.add(m=1.e-3, a=2.)
+        self.sim.integrator = "whfast"
+        self.sim.dt = 0.01
+        mm = self.rebx.load_operator('modify_mass')
+        self.rebx.add_operator(mm)
+        self.sim.particles[2].params['tau_mass'] = -1.e2
+        self.sim.integrate(1.)
+        m1 = self.sim.particles[2].m
+        self.assertLess(m1, 1.e-3)
+        self.sim.particles[2].params['tau_mass'] = 1.e2
+        self.sim.integrate(2.)
+        self.assertGreater(self.sim.particles[2].m, m1)
+        self.sim.add(m=1.e-3, a=3.)
+        self.sim.particles[3].params['tau_mass'] = -1.e2
+        self.sim.remove(2)
+        self.sim.integrate(3.)
+        self.assertLess(self.sim.particles[2].m, 1.e-3)
+
     def test_removenonoperator(self):
         with self.assertRaises(TypeError):
             self.rebx.remove_operator(self.sim)
@@ -3,6 +3,7 @@ import reboundx
 from reboundx import data
 import unittest
 import math
+import os
 import numpy as np
 from ctypes import c_uint, c_uint8, c_uint32, c_uint64
 
@@ -174,6 +175,19 @@ class TestParams(unittest.TestCase):
         with self.assertRaises(AttributeError):
             b = self.gr.params['my_custom']
 
+    def test_registeredperinstance(self):
+        # built-in params are shared by all instances, but user registered ones are not
+        self.rebx.register_param('my_new_double', 'REBX_TYPE_DOUBLE')
+        sim2 = rebound.Simulation()
+        sim2.add(m=1.)
+        rebx2 = reboundx.Extras(sim2)
+        sim2.particles[0].params['c'] = 1.2
+        self.assertAlmostEqual(sim2.particles[0].params['c'], 1.2, delta=1.e-15)
+        with self.assertRaises(AttributeError):
+            sim2.particles[0].params['my_new_double'] = 1.2
+        self.p.params['my_new_double'] = 3.4
+        self.assertAlmostEqual(self.p.params['my_new_double'], 3.4, delta=1.e-15)
+
     def test_newdouble(self):
         self.rebx.register_param('my_new_double', 'REBX_TYPE_DOUBLE')
         self.gr.params['my_new_double'] = 1.2
@@ -190,6 +204,47 @@ class TestParams(unittest.TestCase):
         self.gr.params['tau_mass'] = 3.2
         self.assertEqual(len(self.gr.params), 3)
 
+    def test_insertionorder(self):
+        # lists are kept sorted by registration id, so params added in any order must all be found
+        self.p.params['tau_mass'] = 3.2
+        self.p.params['c'] = 1.3
+        self.p.params['gr_source'] = 7
+        self.p.params['c'] = 1.5
+        self.assertEqual(len(self.p.params), 3)
+        self.assertAlmostEqual(self.p.params["tau_mass"], 3.2, delta=1.e-15)
+        self.assertAlmostEqual(self.p.params["c"], 1.5, delta=1.e-15)
+        self.assertEqual(self.p.params["gr_source"], 7)
+
+    def test_binaryroundtrip(self):
+        # particle params are stored in compact blocks, which must be rebuilt with the right values when loading
+        self.p.params['c'] = 1.3
+        self.p.params['gr_source'] = 7
+        self.p.params['min_distance_from'] = 3
+        self.p.params['Omega'] = [1.,2.,3.]
+        self.sim.save_to_file('params.bin', delete_file=True)
+        self.rebx.save('params.rebx')
+        sim2 = rebound.Simulation('params.bin')
+        rebx2 = reboundx.Extras(sim2, 'params.rebx')
+        p2 = sim2.particles[1]
+        self.assertEqual(len(p2.params), 4)
+        self.assertAlmostEqual(p2.params['c'], 1.3, delta=1.e-15)
+        self.assertEqual(p2.params['gr_source'], 7)
+        self.assertEqual(p2.params['min_distance_from'], 3)
+        self.assertEqual(p2.params['Omega'].z, 3.)
+        os.remove('params.bin')
+        os.remove('params.rebx')
+
+    def test_arenausage(self):
+        # params of removed particles go back to the arena, which keeps track of the high-water mark
+        used = self.rebx.arena.used
+        self.p.params['c'] = 1.3
+        self.p.params['gr_source'] = 7
+        self.assertGreater(self.rebx.arena.used, used)
+        peak = self.rebx.arena.used
+        self.sim.remove(1)
+        self.assertEqual(self.rebx.arena.used, used)
+        self.assertGreaterEqual(self.rebx.arena.peak, peak)
+
     def test_iter(self):
         with self.assertRaises(AttributeError):
             for p in self.gr.params:
@@ -1,6 +1,7 @@
 import rebound
 import reboundx
 import unittest
+import os
 import numpy as np
 
 """
@@ -143,6 +144,142 @@ class TestSimulationarchive(unittest.TestCase):
                 sim.integrate(tmax)
                 self.assertEqual(self.sim.particles[1].x, sim.particles[1].x, msg='REB integrator: {0}, REBX integrator: {1}'.format(integrator, rebxintegrator))
 
+    def test_rebxarchive(self):
+        # Each simulation snapshot should get the REBOUNDx parameters saved with it, not the first ones
+        mof = self.rebx.load_force('modify_orbits_forces')
+        self.rebx.add_force(mof)
+        taus = [-1.e4, -2.e4, -3.e4]
+        for i, tau_a in enumerate(taus):
+            self.sim.particles[1].params['tau_a'] = tau_a
+            self.sim.save_to_file('test.sa', delete_file=(i==0))
+            self.rebx.save_to_archive('test.rebxa', delete_file=(i==0))
+            self.sim.integrate(self.sim.t + 10.)
+
+        sa = reboundx.Simulationarchive('test.sa', 'test.rebxa')
+        for i, tau_a in enumerate(taus):
+            sim, rebx = sa[i]
+            self.assertEqual(sim.particles[1].params['tau_a'], tau_a)
+        sim, rebx = sa[-1]
+        sim.integrate(sim.t + 10.)
+        self.assertEqual(self.sim.particles[1].x, sim.particles[1].x)
+
+    def test_rebxarchive_between(self):
+        # Simulation snapshots without a REBOUNDx snapshot at the same steps_done get the last one saved before them
+        self.sim.particles[1].params['tau_a'] = -1.e4
+        self.rebx.save_to_archive('test.rebxa', delete_file=True)
+        self.sim.save_to_file('test.sa', delete_file=True)
+        self.sim.integrate(self.sim.t + 10.)
+        self.sim.save_to_file('test.sa')
+        sa = reboundx.Simulationarchive('test.sa', 'test.rebxa')
+        sim, rebx = sa[1]
+        self.assertEqual(sim.particles[1].params['tau_a'], -1.e4)
+
+        # Simulation snapshots taken before the first REBOUNDx one have none to load
+        self.sim.save_to_file('test_early.sa', delete_file=True)
+        self.sim.integrate(self.sim.t + 10.)
+        self.rebx.save_to_archive('test_early.rebxa', delete_file=True)
+        self.sim.save_to_file('test_early.sa')
+        sa = reboundx.Simulationarchive('test_early.sa', 'test_early.rebxa')
+        with self.assertRaises(RuntimeError):
+            sim, rebx = sa[0]
+        sim, rebx = sa[1]
+        self.assertEqual(sim.particles[1].params['tau_a'], -1.e4)
+
+        # An archive from two runs can't be searched that way
+        self.sim.integrate(self.sim.t + 10.)
+        self.rebx.save_to_archive('test.rebxa')
+        self.sim.steps_done = 0
+        self.sim.particles[1].params['tau_a'] = -2.e4
+        self.rebx.save_to_archive('test.rebxa')
+        sa = reboundx.Simulationarchive('test.sa', 'test.rebxa')
+        with self.assertRaises(RuntimeError):
+            sim, rebx = sa[1]
+
+    def test_rebxarchive_deltas(self):
+        # Snapshots between keyframes only store changed values, and should load the same as full ones
+        taus = [-1.e4*(i+1) for i in range(7)]
+        for interval, filename in [(1, 'test_full.rebxa'), (3, 'test_delta.rebxa')]:
+            self.setUp()
+            self.rebx.add_force(self.rebx.load_force('modify_orbits_forces'))
+            self.rebx.archive_keyframe_interval = interval
+            self.sim.save_to_file('test.sa', delete_file=True)
+            for i, tau_a in enumerate(taus):
+                self.sim.particles[1].params['tau_a'] = tau_a
+                if i == 4:
+                    self.sim.particles[1].params['tau_e'] = -1.e3 # new param forces a keyframe
+                self.rebx.save_to_archive(filename, delete_file=(i==0))
+            for i, tau_a in enumerate(taus):
+                sim = rebound.Simulation('test.sa')
+                rebx = reboundx.Extras(sim, filename, snapshot=i)
+                self.assertEqual(sim.particles[1].params['tau_a'], tau_a)
+                self.assertEqual(len(sim.particles[1].params), 2 if i >= 4 else 1)
+        self.assertLess(os.path.getsize('test_delta.rebxa'), os.path.getsize('test_full.rebxa'))
+
+    def test_rebxarchive_deltas_inplace(self):
+        # Effects like track_min_distance update params through pointers rather than rebx_set_param_*. Deltas should still pick them up.
+        sim = rebound.Simulation()
+        sim.add(m=1.)
+        sim.add(m=1.e-4, a=1., e=0.2, f=3.) # near apocenter, so the distance keeps shrinking for the integrations below
+        rebx = reboundx.Extras(sim)
+        rebx.add_operator(rebx.load_operator('track_min_distance'))
+        rebx.archive_keyframe_interval = 3
+        sim.particles[1].params['min_distance'] = 10.
+        sim.save_to_file('test.sa', delete_file=True)
+        min_distances = []
+        for i in range(7):
+            sim.integrate(sim.t + 0.4)
+            min_distances.append(sim.particles[1].params['min_distance'])
+            rebx.save_to_archive('test.rebxa', delete_file=(i==0))
+        self.assertEqual(len(set(min_distances)), len(min_distances))
+        for i, min_distance in enumerate(min_distances):
+            sim = rebound.Simulation('test.sa')
+            rebx = reboundx.Extras(sim, 'test.rebxa', snapshot=i)
+            self.assertEqual(sim.particles[1].params['min_distance'], min_distance)
+
+    def test_rebxarchive_deltas_moved_particles(self):
+        # Removing a particle without params and adding one keeps N, but moves the params of the particles after it to new indices
+        self.rebx.archive_keyframe_interval = 10
+        self.sim.add(m=1.e-4, a=2.)
+        self.sim.particles[2].params['tau_a'] = -1.e4
+        self.rebx.save_to_archive('test.rebxa', delete_file=True)
+        self.sim.remove(1)
+        self.sim.add(m=1.e-4, a=3.)
+        self.sim.particles[1].params['tau_a'] = -2.e4
+        self.sim.save_to_file('test.sa', delete_file=True)
+        self.rebx.save_to_archive('test.rebxa')
+        sim = rebound.Simulation('test.sa')
+        rebx = reboundx.Extras(sim, 'test.rebxa', snapshot=1)
+        self.assertEqual(sim.particles[1].params['tau_a'], -2.e4)
+        self.assertEqual(len(sim.particles[2].params), 0)
+
+    def test_async_output(self):
+        written = []
+        self.rebx.enable_async_output(max_pending=2, callback=lambda filename, success: written.append((filename, success)))
+        self.sim.particles[1].params['tau_a'] = -1.e4
+        self.assertTrue(self.rebx.save_async('test_async.rebx'))
+        self.sim.particles[1].params['tau_a'] = -2.e4 # changes after queuing shouldn't end up in the file
+        self.assertEqual(self.rebx.wait_async_output(), 0)
+        self.assertEqual(written, [('test_async.rebx', True)])
+        sim = rebound.Simulation()
+        sim.add(m=1.)
+        sim.add(m=1.e-4, a=1., e=0.2)
+        rebx = reboundx.Extras(sim, 'test_async.rebx')
+        self.assertEqual(sim.particles[1].params['tau_a'], -1.e4)
+        self.rebx.disable_async_output()
+
+    def test_async_output_reenable(self):
+        # Snapshots still queued when the output is re-enabled are written and reported to the old callback
+        old, new = [], []
+        self.rebx.enable_async_output(max_pending=4, callback=lambda filename, success: old.append(filename))
+        for i in range(3):
+            self.assertTrue(self.rebx.save_async('test_async_{0}.rebx'.format(i)))
+        self.rebx.enable_async_output(max_pending=4, callback=lambda filename, success: new.append(filename))
+        self.assertEqual(old, ['test_async_{0}.rebx'.format(i) for i in range(3)])
+        self.assertTrue(self.rebx.save_async('test_async_3.rebx'))
+        self.assertEqual(self.rebx.wait_async_output(), 0)
+        self.assertEqual(new, ['test_async_3.rebx'])
+        self.rebx.disable_async_output()
+
 if __name__ == '__main__':
     unittest.main()
 
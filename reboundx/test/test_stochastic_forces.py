@@ -1,8 +1,16 @@
 import rebound
 import reboundx
 import unittest
+import math
 import os
 import numpy as np
+from ctypes import Structure, POINTER, c_int, c_double, byref
+from reboundx import clibreboundx
+
+class Ensemble(Structure):
+    _fields_ = [("N_members", c_int),
+                ("sims", POINTER(POINTER(rebound.Simulation))),
+                ("status", POINTER(c_int))]
 
 class TestStochastic(unittest.TestCase):
     def test_default(self):
@@ -37,7 +45,6 @@ class TestStochastic(unittest.TestCase):
         self.sim.integrate(ps[1].P*1000)
         self.assertLess(np.abs(0.001-ps[1].a), 0.00001)
 
-    '''
     def test_binary(self):
         self.sim = rebound.Simulation()
         self.sim.add(m=1., r=0.005)
@@ -64,6 +71,78 @@ class TestStochastic(unittest.TestCase):
         sim2.integrate(self.sim.t)
         self.assertEqual(self.sim.particles[1].x, sim2.particles[1].x)
         self.assertEqual(self.sim.particles[1].params["kappa"], sim2.particles[1].params["kappa"])
-    '''
+        os.remove("binary.bin")
+        os.remove("binary.rebx")
+
+    def test_particlestreams(self):
+        # a particle's kicks only depend on the seed, its hash and the step, not on which other particles have stochastic forces
+        sims = []
+        for extra in [False, True]:
+            sim = rebound.Simulation()
+            sim.add(m=1.)
+            sim.add(m=1.e-3, a=1.0, e=0.1, hash="planet")
+            if extra:
+                sim.add(m=0., a=30., hash="test")
+            sim.integrator = "whfast"
+            sim.rand_seed = 7
+            sim.dt = sim.particles[1].P/20.2
+            rebx = reboundx.Extras(sim)
+            force = rebx.load_force("stochastic_forces")
+            rebx.add_force(force)
+            sim.particles[1].params['kappa'] = 1e-5
+            if extra:
+                sim.particles[2].params['kappa'] = 1e-5
+            sim.step()
+            sims.append((sim, rebx))
+        self.assertEqual(sims[0][0].particles[1].params['stochastic_force_r'], sims[1][0].particles[1].params['stochastic_force_r'])
+        self.assertEqual(sims[0][0].particles[1].params['stochastic_force_phi'], sims[1][0].particles[1].params['stochastic_force_phi'])
+        self.assertNotEqual(sims[1][0].particles[1].params['stochastic_force_r'], sims[1][0].particles[2].params['stochastic_force_r'])
+
+    def test_ensemble(self):
+        # Members get the force and particle params of the original, different seeds, and the same results however many threads run them
+        sim = rebound.Simulation()
+        sim.add(m=1.)
+        sim.add(m=1.e-3, a=1.0, e=0.1)
+        sim.integrator = "whfast"
+        sim.rand_seed = 3
+        sim.dt = sim.particles[1].P/20.2
+        sim.move_to_com()
+        rebx = reboundx.Extras(sim)
+        rebx.add_force(rebx.load_force("stochastic_forces"))
+        sim.particles[1].params['kappa'] = 1e-5
+
+        clibreboundx.rebx_create_ensemble.restype = POINTER(Ensemble)
+        clibreboundx.rebx_free_ensemble.restype = None
+        N_members = 4
+        N_outputs = 6*sim.N
+        set_threads = getattr(clibreboundx, 'omp_set_num_threads', None) # only in OpenMP builds
+        results = []
+        for threads in [1, 4]:
+            ensemble = clibreboundx.rebx_create_ensemble(byref(sim), c_int(N_members))
+            self.assertTrue(ensemble)
+            seeds = [ensemble.contents.sims[m].contents.rand_seed for m in range(N_members)]
+            self.assertEqual(len(set(seeds)), N_members)
+            self.assertEqual(ensemble.contents.sims[0].contents.particles[1].params['kappa'], 1e-5)
+            if set_threads is not None:
+                set_threads(c_int(threads))
+            outputs = (c_double*(N_members*N_outputs))()
+            N_failed = clibreboundx.rebx_ensemble_integrate(ensemble, c_double(10.*sim.particles[1].P), clibreboundx.rebx_ensemble_collect_particles, outputs, c_int(N_outputs), None)
+            self.assertEqual(N_failed, 0)
+            results.append(list(outputs))
+            clibreboundx.rebx_free_ensemble(ensemble)
+        self.assertEqual(results[0], results[1])
+        members = [results[0][m*N_outputs:(m+1)*N_outputs] for m in range(N_members)]
+        self.assertNotEqual(members[0], members[1]) # different seeds give different kicks
+
+        # Slots with room for more particles than a member has are padded with NaN
+        ensemble = clibreboundx.rebx_create_ensemble(byref(sim), c_int(N_members))
+        outputs = (c_double*(N_members*(N_outputs+6)))()
+        clibreboundx.rebx_ensemble_integrate(ensemble, c_double(10.*sim.particles[1].P), clibreboundx.rebx_ensemble_collect_particles, outputs, c_int(N_outputs+6), None)
+        clibreboundx.rebx_free_ensemble(ensemble)
+        for m in range(N_members):
+            slot = outputs[m*(N_outputs+6):(m+1)*(N_outputs+6)]
+            self.assertEqual(slot[:N_outputs], members[m])
+            self.assertTrue(all(math.isnan(x) for x in slot[N_outputs:]))
+
 if __name__ == '__main__':
     unittest.main()
@@ -35,6 +35,12 @@ REBX_BINARY_FIELD_TYPE = {
         24: 'Particles',
         25: 'Force',
         26: 'Snapshot',
+        27: 'Snapshot time',
+        28: 'Snapshot steps done',
+        29: 'Archive index',
+        30: 'Archive index offset',
+        31: 'Snapshot keyframe offset',
+        32: 'Snapshot delta',
         }
 
 class BinaryField(Structure):
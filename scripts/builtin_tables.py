@@ -0,0 +1,89 @@
+#!/usr/bin/python
+# Call this after adding or removing a line in the tables of built-in parameters (rebx_builtin_params) or
+# effects (rebx_builtin_effects) in ../src/core.c. It renumbers the parameter ids and regenerates the perfect
+# hashes REBOUNDx uses to look up built-in names.
+
+import re
+import sys
+
+# Must match rebx_builtin_hash in core.c (32 bit FNV-1a with the seed mixed into the offset basis)
+def builtin_hash(name, seed):
+    h = (2166136261 ^ seed) & 0xffffffff
+    for b in name.encode('ascii'):
+        h ^= b
+        h = (h*16777619) & 0xffffffff
+    return h
+
+# Two level hash: the first level sorts names into buckets, and each bucket gets the seed for the second level
+def perfect_hash(names, N_buckets, N_slots):
+    if 2*len(names) > N_slots:
+        sys.exit("Too many built-in names for {0} slots.".format(N_slots))
+    duplicates = set(name for name in names if names.count(name) > 1)
+    if duplicates:
+        sys.exit("Duplicate built-in names: {0}".format(", ".join(sorted(duplicates))))
+    buckets = [[] for b in range(N_buckets)]
+    for i, name in enumerate(names):
+        buckets[builtin_hash(name, 0) % N_buckets].append(i)
+    seeds = [0]*N_buckets
+    slots = [-1]*N_slots
+    # Place the largest buckets first while the table is still empty
+    for b in sorted(range(N_buckets), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            continue
+        for seed in range(1, 65536):
+            trial = [builtin_hash(names[i], seed) % N_slots for i in buckets[b]]
+            if len(set(trial)) == len(trial) and all(slots[s] == -1 for s in trial):
+                break
+        else:
+            sys.exit("Could not find a perfect hash. Increase the number of slots.")
+        seeds[b] = seed
+        for i, s in zip(buckets[b], trial):
+            slots[s] = i
+    return seeds, slots
+
+def format_array(values, per_line):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join("{0:d}".format(v) for v in values[i:i+per_line]) + ",")
+    return "\n".join(lines)
+
+def hash_block(names, macro, array, N_buckets, N_slots):
+    seeds, slots = perfect_hash(names, N_buckets, N_slots)
+    block = "#define REBX_N_BUILTIN_{0}S {1}\n".format(macro, len(names))
+    block += "#define REBX_BUILTIN_{0}_N_BUCKETS {1}\n".format(macro, N_buckets)
+    block += "#define REBX_BUILTIN_{0}_N_SLOTS {1}\n".format(macro, N_slots)
+    block += "static const uint16_t rebx_builtin_{0}_seeds[REBX_BUILTIN_{1}_N_BUCKETS] = {{\n".format(array, macro) + format_array(seeds, 16) + "\n};\n"
+    block += "static const int16_t rebx_builtin_{0}_slots[REBX_BUILTIN_{1}_N_SLOTS] = {{\n".format(array, macro) + format_array(slots, 16) + "\n};\n"
+    return block
+
+# Returns start and end of the text between the lines with the START and END markers
+def generated_region(source, marker):
+    start = source.index("// **{0}** ".format(marker))
+    start = source.index("\n", start) + 1
+    end = source.index("// **{0} END**".format(marker))
+    return start, end
+
+with open("../src/core.c") as f:
+    source = f.read()
+
+# Parameters: the table itself is generated, since ids are positions in it
+start, end = generated_region(source, "BUILTINPARAMS")
+rows = re.findall(r'\{\s*"(\w+)"\s*,\s*(REBX_TYPE_\w+)', source[start:end])
+param_names = [name for name, type in rows]
+block = "static struct rebx_param rebx_builtin_params[] = {\n"
+for i, (name, type) in enumerate(rows):
+    block += '    {{"{0}", {1}, {2}, NULL}},\n'.format(name, type, i)
+block += "};\n"
+block += hash_block(param_names, "PARAM", "param", 32, 256)
+source = source[:start] + block + source[end:]
+
+# Effects: the table is written by hand just above the generated region
+start, end = generated_region(source, "BUILTINEFFECTS")
+table_start = source.index("rebx_builtin_effects[] = {")
+effect_names = re.findall(r'\.name\s*=\s*"(\w+)"', source[table_start:start])
+source = source[:start] + hash_block(effect_names, "EFFECT", "effect", 8, 64) + source[end:]
+
+with open("../src/core.c", "w") as f:
+    f.write(source)
+
+print("Generated perfect hashes for {0} built-in parameters and {1} built-in effects".format(len(param_names), len(effect_names)))
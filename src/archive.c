@@ -0,0 +1,864 @@
+/**
+ * @file    archive.c
+ * @brief   REBOUNDx archives holding many snapshots of the effects and parameters in one file.
+ * @author  Dan Tamayo <tamayo.daniel@gmail.com>
+ *
+ * @section LICENSE
+ * Copyright (c) 2015 Dan Tamayo, Hanno Rein
+ *
+ * This file is part of reboundx.
+ *
+ * reboundx is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * reboundx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rebound.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ An archive is a binary (see output.c) with one SNAPSHOT after another, with index blocks in between, and a fixed size trailer pointing to the last index block:
+
+ HEADER (64 bytes)
+ SNAPSHOT {type=SNAPSHOT, size=skip_to_next_snapshot}
+    SNAPSHOT_T, SNAPSHOT_STEPS_DONE, REBX_STRUCTURE, PARTICLES
+ END (SNAPSHOT)
+ ARCHIVE_INDEX_BLOCK {type=ARCHIVE_INDEX_BLOCK, size=sizeof(struct rebx_archive_block) + capacity*sizeof(struct rebx_archive_entry)}
+    struct rebx_archive_block, then capacity entries, of which the first N are in use
+ SNAPSHOT, or a delta SNAPSHOT holding only the param values that changed since a full one (see below)
+ ...
+ ARCHIVE_INDEX_OFFSET {type=ARCHIVE_INDEX_OFFSET, size=sizeof(long)}
+ OFFSET of the last ARCHIVE_INDEX_BLOCK field
+
+ Readers find any snapshot from the trailer and the chain of index blocks, without scanning the file. Appending writes the new snapshot over
+ the trailer, its entry into the last index block (which is then rewritten in place) and a new trailer, so the bytes written don't grow with
+ the number of snapshots. When the last block is full, a new one with twice the capacity is written after the snapshot, so a long archive
+ has only a few blocks. Snapshots are never rewritten. If the trailer is missing (a binary from rebx_output_binary, or an append that was
+ interrupted) the index is rebuilt by walking the snapshots, anything after the last complete one is ignored, and the next append writes
+ the whole index into a new block. Archives written before index blocks end in a single ARCHIVE_INDEX {size=N*sizeof(struct rebx_archive_entry)}
+ field with all the entries, which is read the same way and replaced by a block on the next append.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "rebound.h"
+#include "reboundx.h"
+#include "core.h"
+
+#define REBX_ARCHIVE_HEADER_SIZE 64
+#define REBX_ARCHIVE_TRAILER_SIZE (sizeof(struct rebx_binary_field) + sizeof(long))
+#define REBX_ARCHIVE_FIRST_BLOCK_CAPACITY 64
+
+struct rebx_archive_block{
+    long previous;          // offset of the previous ARCHIVE_INDEX_BLOCK field, -1 for the first
+    int N;                  // entries in use
+    int capacity;           // entries the block has room for
+};
+
+// Index of an archive as found by rebx_archive_read
+struct rebx_archive_index{
+    struct rebx_archive_entry* entries; // all entries, with room to append one more. NULL if they weren't needed and the index is in blocks.
+    int N;                              // number of snapshots
+    long end;                           // where the next snapshot goes
+    long block;                         // offset of the last ARCHIVE_INDEX_BLOCK field, -1 if the next append has to write the whole index into a new block
+    struct rebx_archive_block last;     // its header
+};
+
+static struct rebx_binary_field rebx_archive_field_at(const char* const data, const long position){
+    struct rebx_binary_field field;
+    memcpy(&field, data + position, sizeof(field));
+    return field;
+}
+
+// Reads t and steps_done of the SNAPSHOT at position, and sets next to the position after it. Returns 0 if there isn't one.
+// t and steps_done are 0 for snapshots written before they were stored.
+static int rebx_archive_entry_at(const char* const data, const long size, const long position, struct rebx_archive_entry* const entry, long* const next){
+    if (position < REBX_ARCHIVE_HEADER_SIZE || position + (long)sizeof(struct rebx_binary_field) > size){
+        return 0;
+    }
+    const struct rebx_binary_field field = rebx_archive_field_at(data, position);
+    const long contents = position + sizeof(field);
+    if (field.type != REBX_BINARY_FIELD_TYPE_SNAPSHOT || field.size < 0 || field.size > size - contents){
+        return 0;
+    }
+    entry->t = 0.;
+    entry->steps_done = 0;
+    entry->offset = position;
+    long child = contents;
+    while (child + (long)sizeof(struct rebx_binary_field) <= contents + field.size){
+        const struct rebx_binary_field child_field = rebx_archive_field_at(data, child);
+        child += sizeof(child_field);
+        if (child_field.size < 0 || child_field.size > contents + field.size - child){
+            break;
+        }
+        if (child_field.type == REBX_BINARY_FIELD_TYPE_SNAPSHOT_T && child_field.size == sizeof(entry->t)){
+            memcpy(&entry->t, data + child, sizeof(entry->t));
+        }
+        if (child_field.type == REBX_BINARY_FIELD_TYPE_SNAPSHOT_STEPS_DONE && child_field.size == sizeof(entry->steps_done)){
+            memcpy(&entry->steps_done, data + child, sizeof(entry->steps_done));
+        }
+        child += child_field.size;
+    }
+    *next = contents + field.size;
+    return 1;
+}
+
+// Header of the ARCHIVE_INDEX_BLOCK field at position, which has to lie before limit. Returns 0 if there isn't a valid one.
+static int rebx_archive_block_at(const char* const data, const long position, const long limit, struct rebx_archive_block* const block){
+    if (position < REBX_ARCHIVE_HEADER_SIZE || position > limit - (long)(sizeof(struct rebx_binary_field) + sizeof(*block))){
+        return 0;
+    }
+    const struct rebx_binary_field field = rebx_archive_field_at(data, position);
+    if (field.type != REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX_BLOCK){
+        return 0;
+    }
+    memcpy(block, data + position + sizeof(field), sizeof(*block));
+    if (block->capacity < 1 || block->N < 0 || block->N > block->capacity || block->previous >= position
+            || field.size != (long)(sizeof(*block) + (size_t)block->capacity*sizeof(struct rebx_archive_entry)) || field.size > limit - position - (long)sizeof(field)){
+        return 0;
+    }
+    return 1;
+}
+
+// Index from the trailer. Entries are only read if with_entries is set, or if the index has to be rewritten anyway. Returns 0 if there isn't a valid one.
+static int rebx_archive_index_from_trailer(const char* const data, const long size, struct rebx_archive_index* const index, const int with_entries){
+    if (size < (long)(REBX_ARCHIVE_HEADER_SIZE + sizeof(struct rebx_binary_field) + REBX_ARCHIVE_TRAILER_SIZE)){
+        return 0;
+    }
+    const long trailer = size - REBX_ARCHIVE_TRAILER_SIZE;
+    const struct rebx_binary_field trailer_field = rebx_archive_field_at(data, trailer);
+    if (trailer_field.type != REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX_OFFSET || trailer_field.size != sizeof(long)){
+        return 0;
+    }
+    long position;
+    memcpy(&position, data + trailer + sizeof(trailer_field), sizeof(position));
+    if (position < REBX_ARCHIVE_HEADER_SIZE || position > trailer - (long)sizeof(struct rebx_binary_field)){
+        return 0;
+    }
+    const struct rebx_binary_field field = rebx_archive_field_at(data, position);
+    if (field.type == REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX){ // single index from older versions, right before the trailer
+        if (field.size != trailer - position - (long)sizeof(field) || field.size % sizeof(struct rebx_archive_entry) != 0){
+            return 0;
+        }
+        index->N = field.size/sizeof(struct rebx_archive_entry);
+        index->entries = malloc(field.size + sizeof(struct rebx_archive_entry)); // room to append one more
+        if (index->entries == NULL){
+            return 0;
+        }
+        memcpy(index->entries, data + position + sizeof(field), field.size);
+        index->end = position;
+        index->block = -1;
+        return 1;
+    }
+
+    // Count the entries in the chain of blocks, checking each block lies before the next
+    struct rebx_archive_block block;
+    if (!rebx_archive_block_at(data, position, trailer, &block)){
+        return 0;
+    }
+    index->block = position;
+    index->last = block;
+    index->end = trailer;
+    long N = block.N;
+    while (block.previous >= 0){
+        const long limit = position;
+        position = block.previous;
+        if (!rebx_archive_block_at(data, position, limit, &block)){
+            return 0;
+        }
+        N += block.N;
+    }
+    if (N > 0x7fffffff - 1){
+        return 0;
+    }
+    index->N = N;
+    index->entries = NULL;
+    if (!with_entries){
+        return 1;
+    }
+    index->entries = malloc((N + 1)*sizeof(struct rebx_archive_entry)); // room to append one more
+    if (index->entries == NULL){
+        return 0;
+    }
+    // Fill from the end, walking the chain backwards again
+    position = index->block;
+    block = index->last;
+    while (1){
+        N -= block.N;
+        memcpy(index->entries + N, data + position + sizeof(struct rebx_binary_field) + sizeof(block), (size_t)block.N*sizeof(struct rebx_archive_entry));
+        if (block.previous < 0){
+            break;
+        }
+        position = block.previous;
+        memcpy(&block, data + position + sizeof(struct rebx_binary_field), sizeof(block));
+    }
+    return 1;
+}
+
+// Index from walking the snapshots, skipping the index blocks between them
+static int rebx_archive_index_from_snapshots(const char* const data, const long size, struct rebx_archive_index* const index){
+    int N_allocated = 16;
+    index->N = 0;
+    index->block = -1;
+    index->entries = malloc(N_allocated*sizeof(*index->entries));
+    if (index->entries == NULL){
+        return 0;
+    }
+    long position = REBX_ARCHIVE_HEADER_SIZE;
+    while (1){
+        struct rebx_archive_block block;
+        if (rebx_archive_block_at(data, position, size, &block)){
+            position += sizeof(struct rebx_binary_field) + rebx_archive_field_at(data, position).size;
+            continue;
+        }
+        struct rebx_archive_entry entry;
+        long next;
+        if (!rebx_archive_entry_at(data, size, position, &entry, &next)){
+            break;
+        }
+        if (index->N + 1 >= N_allocated){ // keep room to append one more
+            N_allocated *= 2;
+            struct rebx_archive_entry* const larger = realloc(index->entries, N_allocated*sizeof(*index->entries));
+            if (larger == NULL){
+                free(index->entries);
+                index->entries = NULL;
+                return 0;
+            }
+            index->entries = larger;
+        }
+        index->entries[index->N++] = entry;
+        position = next;
+    }
+    index->end = position;
+    return 1;
+}
+
+// Returns 0 if data isn't a REBOUNDx binary or out of memory. Free index->entries when done.
+static int rebx_archive_read(const char* const data, const long size, struct rebx_archive_index* const index, const int with_entries){
+    if (size < REBX_ARCHIVE_HEADER_SIZE || strncmp(data, "REBOUNDx Binary File.", strlen("REBOUNDx Binary File.")) != 0){
+        return 0;
+    }
+    if (rebx_archive_index_from_trailer(data, size, index, with_entries)){
+        return 1;
+    }
+    return rebx_archive_index_from_snapshots(data, size, index);
+}
+
+// data is NULL for objects, whose contents are written as separate fields after the header
+static void rebx_archive_write_field(FILE* of, const enum rebx_binary_field_type type, const void* const data, const long size){
+    struct rebx_binary_field field;
+    memset(&field, 0, sizeof(field)); // same as output.c, so identical archives are identical files
+    field.type = type;
+    field.size = size;
+    fwrite(&field, sizeof(field), 1, of);
+    if (data != NULL && size > 0){
+        fwrite(data, size, 1, of);
+    }
+}
+
+/*
+ Delta snapshots. Most snapshots in a long run differ from the last keyframe (a full snapshot) only in a few param values, so between keyframes
+ the writer stores a SNAPSHOT with only
+
+    SNAPSHOT_T, SNAPSHOT_STEPS_DONE,
+    SNAPSHOT_KEYFRAME {size=sizeof(long)} offset of the keyframe,
+    SNAPSHOT_DELTA {size} int N_values, then a record {int slot; int type;} followed by the value for each param whose value changed
+
+ Slots number the value params (see rebx_archive_is_value) in rebx_archive_walk order, which loading the keyframe reproduces; N_values is their
+ number at the keyframe. Changes are found by comparing against a copy of the values at the keyframe rather than by flagging the setters, since
+ effects also update their params in place (e.g., track_min_distance). Any change in the effects, the particles or which params they carry
+ makes the next snapshot a keyframe.
+*/
+
+// Params whose values delta snapshots store. Force params only change with the effects, and pointer params aren't stored at all.
+static int rebx_archive_is_value(const enum rebx_param_type type){
+    return type == REBX_TYPE_DOUBLE || type == REBX_TYPE_INT || type == REBX_TYPE_UINT32 || type == REBX_TYPE_VEC3D;
+}
+
+struct rebx_archive_slot{
+    const struct rebx_node* node;       // param at the keyframe. Params are identified by the address of their node.
+    const void* value;                  // its value pointer, which for force params is the force
+    int particle;                       // index of the particle carrying it, -1 for params of effects. Particles can be removed and added without reallocating their params.
+    unsigned char keyframe_value[sizeof(struct reb_vec3d)]; // value at the keyframe (value params only)
+};
+
+struct rebx_archive_state{
+    char* filename;                     // archive holding the keyframe
+    long keyframe;                      // offset of the keyframe in it
+    double t;                           // t and steps_done of the keyframe, to check it's still in the archive
+    unsigned long long steps_done;
+    int N_deltas;                       // delta snapshots written since the keyframe
+    int N_particles;
+    unsigned long layout_version;       // rebx->param_layout_version at the keyframe, since freed params' addresses can be reused
+    const void** objects;               // forces, operators and steps at the keyframe, in rebx_archive_walk order
+    int N_objects;
+    int N_allocated_objects;
+    struct rebx_archive_slot* slots;    // params at the keyframe, in rebx_archive_walk order
+    int N_slots;
+    int N_allocated_slots;
+    int N_values;                       // number of value params among the slots
+};
+
+void rebx_free_archive_state(struct rebx_archive_state* const state){
+    if (state == NULL){
+        return;
+    }
+    free(state->filename);
+    free(state->objects);
+    free(state->slots);
+    free(state);
+}
+
+// Called with either an object (force, operator or step) or the node of a param (see rebx_create_param_node) and the index of the particle carrying it
+// (-1 for params of effects). Returns 0 to stop the walk.
+typedef int (*rebx_archive_visitor)(struct rebx_extras* const rebx, void* const data, const void* const object, struct rebx_node* const node, const int particle);
+
+static int rebx_archive_walk_params(struct rebx_extras* const rebx, struct rebx_node* ap, const int particle, rebx_archive_visitor visit, void* const data){
+    for (struct rebx_node* node = ap; node != NULL; node = node->next){
+        const struct rebx_param* const param = node->object;
+        if (param->type != REBX_TYPE_POINTER && !visit(rebx, data, NULL, node, particle)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Visits what a snapshot stores, in the same order after loading it as before writing it
+static int rebx_archive_walk(struct rebx_extras* const rebx, rebx_archive_visitor visit, void* const data){
+    for (struct rebx_node* node = rebx->allocated_forces; node != NULL; node = node->next){
+        struct rebx_force* const force = node->object;
+        if (!visit(rebx, data, force, NULL, -1) || !rebx_archive_walk_params(rebx, force->ap, -1, visit, data)){
+            return 0;
+        }
+    }
+    for (struct rebx_node* node = rebx->allocated_operators; node != NULL; node = node->next){
+        struct rebx_operator* const operator = node->object;
+        if (!visit(rebx, data, operator, NULL, -1) || !rebx_archive_walk_params(rebx, operator->ap, -1, visit, data)){
+            return 0;
+        }
+    }
+    struct rebx_node* const lists[3] = {rebx->additional_forces, rebx->pre_timestep_modifications, rebx->post_timestep_modifications};
+    for (int i=0; i<3; i++){
+        for (struct rebx_node* node = lists[i]; node != NULL; node = node->next){
+            if (!visit(rebx, data, node->object, NULL, -1)){
+                return 0;
+            }
+        }
+    }
+    struct reb_simulation* const sim = rebx->sim;
+    for (int i=0; i<sim->N; i++){
+        if (!rebx_archive_walk_params(rebx, sim->particles[i].ap, i, visit, data)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Records the structure and values at a keyframe
+static int rebx_archive_record_visit(struct rebx_extras* const rebx, void* const data, const void* const object, struct rebx_node* const node, const int particle){
+    struct rebx_archive_state* const state = data;
+    if (object != NULL){
+        if (state->N_objects == state->N_allocated_objects){
+            const int N_allocated = state->N_allocated_objects ? 2*state->N_allocated_objects : 16;
+            const void** const larger = realloc(state->objects, N_allocated*sizeof(*state->objects));
+            if (larger == NULL){
+                return 0;
+            }
+            state->objects = larger;
+            state->N_allocated_objects = N_allocated;
+        }
+        state->objects[state->N_objects++] = object;
+        return 1;
+    }
+    if (state->N_slots == state->N_allocated_slots){
+        const int N_allocated = state->N_allocated_slots ? 2*state->N_allocated_slots : 64;
+        struct rebx_archive_slot* const larger = realloc(state->slots, N_allocated*sizeof(*state->slots));
+        if (larger == NULL){
+            return 0;
+        }
+        state->slots = larger;
+        state->N_allocated_slots = N_allocated;
+    }
+    struct rebx_archive_slot* const slot = &state->slots[state->N_slots++];
+    const struct rebx_param* const param = node->object;
+    slot->node = node;
+    slot->value = rebx_param_node_value(node);
+    slot->particle = particle;
+    if (rebx_archive_is_value(param->type)){
+        memcpy(slot->keyframe_value, slot->value, rebx_sizeof(rebx, param->type));
+        state->N_values++;
+    }
+    return 1;
+}
+
+// Starts a new keyframe. Returns 0 if out of memory, in which case the next snapshot is a keyframe again.
+static int rebx_archive_record_keyframe(struct rebx_extras* const rebx, const char* const filename, const long offset){
+    struct rebx_archive_state* state = rebx->archive_state;
+    if (state == NULL){
+        state = calloc(1, sizeof(*state));
+        if (state == NULL){
+            return 0;
+        }
+        rebx->archive_state = state;
+    }
+    if (state->filename == NULL || strcmp(state->filename, filename) != 0){
+        free(state->filename);
+        state->filename = malloc(strlen(filename) + 1);
+        if (state->filename == NULL){
+            return 0;
+        }
+        strcpy(state->filename, filename);
+    }
+    state->keyframe = offset;
+    state->t = rebx->sim->t;
+    state->steps_done = rebx->sim->steps_done;
+    state->N_deltas = 0;
+    state->N_particles = rebx->sim->N;
+    state->layout_version = rebx->param_layout_version;
+    state->N_objects = 0;
+    state->N_slots = 0;
+    state->N_values = 0;
+    if (!rebx_archive_walk(rebx, rebx_archive_record_visit, state)){
+        state->filename[0] = '\0'; // doesn't match any archive
+        return 0;
+    }
+    return 1;
+}
+
+// Whether the keyframe is still in the archive being appended to (it can have been deleted or rewritten since)
+static int rebx_archive_keyframe_current(const struct rebx_archive_state* const state, const char* const filename, const char* const data, const long end){
+    if (state == NULL || state->filename == NULL || strcmp(state->filename, filename) != 0){
+        return 0;
+    }
+    struct rebx_archive_entry entry;
+    long next;
+    return rebx_archive_entry_at(data, end, state->keyframe, &entry, &next) && entry.t == state->t && entry.steps_done == state->steps_done;
+}
+
+struct rebx_archive_delta{
+    const struct rebx_archive_state* state;
+    int N_objects;      // objects visited so far
+    int N_slots;        // params visited so far
+    int N_values;       // value params visited so far
+    char* records;      // contents of the SNAPSHOT_DELTA field
+    long size;
+    long allocated;
+};
+
+static int rebx_archive_delta_append(struct rebx_archive_delta* const delta, const void* const data, const long size){
+    if (delta->size + size > delta->allocated){
+        long allocated = delta->allocated ? 2*delta->allocated : 1024;
+        while (allocated < delta->size + size){
+            allocated *= 2;
+        }
+        char* const larger = realloc(delta->records, allocated);
+        if (larger == NULL){
+            return 0;
+        }
+        delta->records = larger;
+        delta->allocated = allocated;
+    }
+    memcpy(delta->records + delta->size, data, size);
+    delta->size += size;
+    return 1;
+}
+
+// Checks the structure against the keyframe while collecting the changed values. Stops if anything but a value changed.
+static int rebx_archive_delta_visit(struct rebx_extras* const rebx, void* const data, const void* const object, struct rebx_node* const node, const int particle){
+    struct rebx_archive_delta* const delta = data;
+    const struct rebx_archive_state* const state = delta->state;
+    if (object != NULL){
+        return delta->N_objects < state->N_objects && state->objects[delta->N_objects++] == object;
+    }
+    if (delta->N_slots >= state->N_slots){
+        return 0;
+    }
+    const struct rebx_archive_slot* const slot = &state->slots[delta->N_slots++];
+    const struct rebx_param* const param = node->object;
+    const void* const value = rebx_param_node_value(node);
+    if (slot->node != node || slot->value != value || slot->particle != particle){
+        return 0;
+    }
+    if (!rebx_archive_is_value(param->type)){
+        return 1;
+    }
+    const int record[2] = {delta->N_values++, (int)param->type};
+    const size_t size = rebx_sizeof(rebx, param->type);
+    if (memcmp(slot->keyframe_value, value, size) == 0){
+        return 1;
+    }
+    return rebx_archive_delta_append(delta, record, sizeof(record)) && rebx_archive_delta_append(delta, value, size);
+}
+
+// Collects the values that changed since the keyframe. Returns 0 if the snapshot has to be a keyframe.
+static int rebx_archive_diff(struct rebx_extras* const rebx, struct rebx_archive_delta* const delta){
+    const struct rebx_archive_state* const state = delta->state;
+    if (rebx->sim->N != state->N_particles || rebx->param_layout_version != state->layout_version){
+        return 0;
+    }
+    if (!rebx_archive_delta_append(delta, &state->N_values, sizeof(state->N_values))){
+        return 0;
+    }
+    return rebx_archive_walk(rebx, rebx_archive_delta_visit, delta) && delta->N_objects == state->N_objects && delta->N_slots == state->N_slots;
+}
+
+static void rebx_archive_write_delta(FILE* of, struct rebx_extras* const rebx, const struct rebx_archive_delta* const delta){
+    struct reb_simulation* const sim = rebx->sim;
+    const long header = sizeof(struct rebx_binary_field);
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_SNAPSHOT, NULL, 5*header + sizeof(sim->t) + sizeof(sim->steps_done) + sizeof(delta->state->keyframe) + delta->size);
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_SNAPSHOT_T, &sim->t, sizeof(sim->t));
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_SNAPSHOT_STEPS_DONE, &sim->steps_done, sizeof(sim->steps_done));
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_SNAPSHOT_KEYFRAME, &delta->state->keyframe, sizeof(delta->state->keyframe));
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_SNAPSHOT_DELTA, delta->records, delta->size);
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_END, NULL, 0);
+}
+
+// Writes an ARCHIVE_INDEX_BLOCK with room for capacity entries, of which the first N are passed
+static void rebx_archive_write_block(FILE* of, const long previous, const struct rebx_archive_entry* const entries, const int N, const int capacity){
+    const struct rebx_archive_block block = {.previous = previous, .N = N, .capacity = capacity};
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX_BLOCK, NULL, sizeof(block) + (size_t)capacity*sizeof(*entries));
+    fwrite(&block, sizeof(block), 1, of);
+    fwrite(entries, sizeof(*entries), N, of);
+    struct rebx_archive_entry empty;
+    memset(&empty, 0, sizeof(empty));
+    for (int i=N; i<capacity; i++){
+        fwrite(&empty, sizeof(empty), 1, of);
+    }
+}
+
+int rebx_output_binary_archive(struct rebx_extras* rebx, const char* const filename){
+    struct reb_simulation* const sim = rebx->sim;
+    if (sim == NULL){
+        rebx_error(rebx, ""); // rebx_error gives meaningful err
+        return 0;
+    }
+    char str[300];
+    struct rebx_archive_index index = {.entries = NULL, .N = 0, .end = 0, .block = -1};
+    const int interval = rebx->archive_keyframe_interval;
+    struct rebx_archive_delta delta = {.state = rebx->archive_state, .N_objects = 0, .N_slots = 0, .N_values = 0, .records = NULL, .size = 0, .allocated = 0};
+    int keyframe_current = 0;
+    enum rebx_input_binary_messages warnings = REBX_INPUT_BINARY_WARNING_NONE;
+    struct rebx_binary_file file;
+    const int exists = rebx_open_binary_file(filename, &file, &warnings);
+    if (warnings & REBX_INPUT_BINARY_ERROR_NO_MEMORY){
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    if (exists && file.size > 0){
+        const int success = rebx_archive_read(file.data, file.size, &index, 0);
+        if (success){
+            keyframe_current = rebx_archive_keyframe_current(delta.state, filename, file.data, index.end);
+        }
+        rebx_close_binary_file(&file);
+        if (!success){
+            sprintf(str, "REBOUNDx Error: Could not append to %.200s, which is not a REBOUNDx binary.\n", filename);
+            rebx_error(rebx, str);
+            return 0;
+        }
+    }
+    else if (exists){
+        rebx_close_binary_file(&file);
+    }
+    if (index.block < 0 && index.entries == NULL){ // new file
+        index.entries = malloc(sizeof(*index.entries));
+        if (index.entries == NULL){
+            rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+            return 0;
+        }
+    }
+
+    FILE* of = fopen(filename, index.end > 0 ? "r+b" : "wb");
+    if (of == NULL){
+        sprintf(str, "REBOUNDx Error: Can not open file %.200s passed to rebx_output_binary_archive.\n", filename);
+        rebx_error(rebx, str);
+        free(index.entries);
+        return 0;
+    }
+    int success = 1;
+    int keyframe = (index.end == 0 || interval <= 1 || !keyframe_current || delta.state->N_deltas + 1 >= interval);
+    if (!keyframe && !rebx_archive_diff(rebx, &delta)){
+        keyframe = 1;
+    }
+    struct rebx_archive_entry entry = {.t = sim->t, .steps_done = sim->steps_done};
+    if (index.end > 0){
+        fseek(of, index.end, SEEK_SET);
+        entry.offset = index.end;
+        if (keyframe){
+            success = rebx_output_snapshot_stream(rebx, of);
+        }
+        else{
+            rebx_archive_write_delta(of, rebx, &delta);
+            rebx->archive_state->N_deltas++;
+        }
+    }
+    else{
+        entry.offset = REBX_ARCHIVE_HEADER_SIZE;
+        success = rebx_output_binary_stream(rebx, of);
+    }
+    free(delta.records);
+    if (keyframe && interval > 1 && success){
+        rebx_archive_record_keyframe(rebx, filename, entry.offset);
+    }
+
+    long block = index.block;
+    if (block >= 0 && index.last.N < index.last.capacity){
+        // Room in the last block: only its header and the new entry change
+        const long snapshot_end = ftell(of);
+        struct rebx_archive_block header = index.last;
+        fseek(of, block + sizeof(struct rebx_binary_field) + sizeof(header) + (size_t)header.N*sizeof(entry), SEEK_SET);
+        fwrite(&entry, sizeof(entry), 1, of);
+        header.N++;
+        fseek(of, block + sizeof(struct rebx_binary_field), SEEK_SET);
+        fwrite(&header, sizeof(header), 1, of);
+        fseek(of, snapshot_end, SEEK_SET);
+    }
+    else if (block >= 0){
+        // Last block is full: start a new one holding just this entry
+        const int capacity = index.last.capacity <= 0x3fffffff ? 2*index.last.capacity : 0x7fffffff;
+        const long previous = block;
+        block = ftell(of);
+        rebx_archive_write_block(of, previous, &entry, 1, capacity);
+    }
+    else{
+        // No blocks to extend (new file, older archive or rebuilt index): write all entries into the first block
+        index.entries[index.N] = entry;
+        const int capacity = 2*(index.N + 1) > REBX_ARCHIVE_FIRST_BLOCK_CAPACITY ? 2*(index.N + 1) : REBX_ARCHIVE_FIRST_BLOCK_CAPACITY;
+        block = ftell(of);
+        rebx_archive_write_block(of, -1, index.entries, index.N + 1, capacity);
+    }
+    free(index.entries);
+    rebx_archive_write_field(of, REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX_OFFSET, &block, sizeof(block));
+    // Drop anything left over from an interrupted append, so the trailer is at the end of the file
+    fflush(of);
+#ifdef _WIN32
+    _chsize(_fileno(of), ftell(of));
+#else
+    if (ftruncate(fileno(of), ftell(of)) != 0){
+        success = 0;
+    }
+#endif
+    if (ferror(of)){
+        success = 0;
+    }
+    if (fclose(of) != 0){
+        success = 0;
+    }
+    if (!success){
+        rebx_free_archive_state(rebx->archive_state); // the keyframe may not have made it to the file
+        rebx->archive_state = NULL;
+        sprintf(str, "REBOUNDx Error: Could not write snapshot to archive %.200s.\n", filename);
+        rebx_error(rebx, str);
+    }
+    return success;
+}
+
+// Finds the keyframe offset (-1 for full snapshots) and the delta of the snapshot at offset. Returns 0 if there isn't a snapshot there.
+static int rebx_archive_find_delta(const char* const data, const long size, const long offset, long* const keyframe, const char** const delta, long* const delta_size){
+    *keyframe = -1;
+    *delta = NULL;
+    *delta_size = 0;
+    if (offset < REBX_ARCHIVE_HEADER_SIZE || offset > size - (long)sizeof(struct rebx_binary_field)){
+        return 0;
+    }
+    const struct rebx_binary_field field = rebx_archive_field_at(data, offset);
+    const long contents = offset + sizeof(field);
+    if (field.type != REBX_BINARY_FIELD_TYPE_SNAPSHOT || field.size < 0 || field.size > size - contents){
+        return 0;
+    }
+    long child = contents;
+    while (child + (long)sizeof(struct rebx_binary_field) <= contents + field.size){
+        const struct rebx_binary_field child_field = rebx_archive_field_at(data, child);
+        child += sizeof(child_field);
+        if (child_field.size < 0 || child_field.size > contents + field.size - child){
+            return 0;
+        }
+        if (child_field.type == REBX_BINARY_FIELD_TYPE_SNAPSHOT_KEYFRAME && child_field.size == sizeof(*keyframe)){
+            memcpy(keyframe, data + child, sizeof(*keyframe));
+        }
+        if (child_field.type == REBX_BINARY_FIELD_TYPE_SNAPSHOT_DELTA){
+            *delta = data + child;
+            *delta_size = child_field.size;
+        }
+        child += child_field.size;
+    }
+    return 1;
+}
+
+struct rebx_archive_values{
+    struct rebx_node** nodes;       // value params indexed by slot
+    int N;
+    int N_allocated;
+};
+
+static int rebx_archive_values_visit(struct rebx_extras* const rebx, void* const data, const void* const object, struct rebx_node* const node, const int particle){
+    struct rebx_archive_values* const values = data;
+    if (node == NULL || !rebx_archive_is_value(((const struct rebx_param*)node->object)->type)){
+        return 1;
+    }
+    if (values->N == values->N_allocated){
+        const int N_allocated = values->N_allocated ? 2*values->N_allocated : 64;
+        struct rebx_node** const larger = realloc(values->nodes, N_allocated*sizeof(*values->nodes));
+        if (larger == NULL){
+            return 0;
+        }
+        values->nodes = larger;
+        values->N_allocated = N_allocated;
+    }
+    values->nodes[values->N++] = node;
+    return 1;
+}
+
+// Applies a delta to the params just loaded from its keyframe
+static void rebx_archive_apply_delta(struct rebx_extras* const rebx, const char* const delta, const long size, enum rebx_input_binary_messages* warnings){
+    int N_values;
+    if (size < (long)sizeof(N_values)){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        return;
+    }
+    memcpy(&N_values, delta, sizeof(N_values));
+    struct rebx_archive_values values = {.nodes = NULL, .N = 0, .N_allocated = 0};
+    if (!rebx_archive_walk(rebx, rebx_archive_values_visit, &values)){
+        *warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;
+        free(values.nodes);
+        return;
+    }
+    if (values.N != N_values){ // keyframe didn't load completely (e.g., an effect this version doesn't have), so slots don't line up
+        *warnings |= REBX_INPUT_BINARY_WARNING_PARAM_NOT_LOADED;
+        free(values.nodes);
+        return;
+    }
+    long position = sizeof(N_values);
+    while (position < size){
+        int record[2];
+        if (size - position < (long)sizeof(record)){
+            *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+            break;
+        }
+        memcpy(record, delta + position, sizeof(record));
+        position += sizeof(record);
+        if (record[0] < 0 || record[0] >= values.N || (int)((const struct rebx_param*)values.nodes[record[0]]->object)->type != record[1]){
+            *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+            break;
+        }
+        const struct rebx_param* const param = values.nodes[record[0]]->object;
+        const long value_size = rebx_sizeof(rebx, param->type);
+        if (size - position < value_size){
+            *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+            break;
+        }
+        memcpy(rebx_param_node_storage(values.nodes[record[0]]), delta + position, value_size);
+        position += value_size;
+        rebx->param_versions[param->id]++;
+    }
+    free(values.nodes);
+}
+
+// Loads a full snapshot, or the keyframe of a delta snapshot followed by the delta
+static void rebx_archive_load(struct rebx_extras* const rebx, const char* const data, const long size, const long offset, enum rebx_input_binary_messages* warnings){
+    long keyframe;
+    const char* delta;
+    long delta_size;
+    if (!rebx_archive_find_delta(data, size, offset, &keyframe, &delta, &delta_size)){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        return;
+    }
+    if (keyframe < 0){
+        rebx_init_extras_from_snapshot(rebx, data, size, offset, warnings);
+        return;
+    }
+    // Deltas always point back to a full snapshot
+    long keyframe_keyframe;
+    const char* keyframe_delta;
+    long keyframe_delta_size;
+    if (delta == NULL || keyframe >= offset || !rebx_archive_find_delta(data, size, keyframe, &keyframe_keyframe, &keyframe_delta, &keyframe_delta_size) || keyframe_keyframe >= 0){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        return;
+    }
+    rebx_init_extras_from_snapshot(rebx, data, size, keyframe, warnings);
+    if (*warnings & (REBX_INPUT_BINARY_ERROR_CORRUPT | REBX_INPUT_BINARY_ERROR_NO_MEMORY | REBX_INPUT_BINARY_ERROR_REBX_NOT_LOADED)){
+        return;
+    }
+    rebx_archive_apply_delta(rebx, delta, delta_size, warnings);
+}
+
+int rebx_archive_read_index(const char* const filename, struct rebx_archive_entry* const entries, const int N_entries){
+    enum rebx_input_binary_messages warnings = REBX_INPUT_BINARY_WARNING_NONE;
+    struct rebx_binary_file file;
+    if (!rebx_open_binary_file(filename, &file, &warnings)){
+        return -1;
+    }
+    struct rebx_archive_index index;
+    const int success = rebx_archive_read(file.data, file.size, &index, entries != NULL);
+    rebx_close_binary_file(&file);
+    if (!success){
+        return -1;
+    }
+    if (entries != NULL){
+        memcpy(entries, index.entries, (N_entries < index.N ? N_entries : index.N)*sizeof(*entries));
+    }
+    free(index.entries);
+    return index.N;
+}
+
+void rebx_init_extras_from_archive(struct rebx_extras* rebx, const char* const filename, int snapshot, enum rebx_input_binary_messages* warnings){
+    if (rebx->sim == NULL){
+        rebx_error(rebx, ""); // rebx_error gives meaningful err
+        return;
+    }
+    struct rebx_binary_file file;
+    if (!rebx_open_binary_file(filename, &file, warnings)){
+        return;
+    }
+    struct rebx_archive_index index;
+    if (!rebx_archive_read(file.data, file.size, &index, 1)){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        rebx_close_binary_file(&file);
+        return;
+    }
+    const int N = index.N;
+    if (snapshot < 0){
+        snapshot += N;
+    }
+    if (snapshot < 0 || snapshot >= N){
+        char str[300];
+        sprintf(str, "REBOUNDx Error: Snapshot index out of range for archive %.200s, which has %d snapshots.\n", filename, N);
+        rebx_error(rebx, str);
+    }
+    else{
+        rebx_archive_load(rebx, file.data, file.size, index.entries[snapshot].offset, warnings);
+    }
+    free(index.entries);
+    rebx_close_binary_file(&file);
+}
+
+struct rebx_extras* rebx_create_extras_from_archive(struct reb_simulation* sim, const char* const filename, const int snapshot){
+    if (sim == NULL){
+        fprintf(stderr, "REBOUNDx Error: Simulation pointer passed to rebx_create_extras_from_archive was NULL.\n");
+        return NULL;
+    }
+    enum rebx_input_binary_messages warnings = REBX_INPUT_BINARY_WARNING_NONE;
+    // create manually so that default registered parameters not loaded (as in rebx_create_extras_from_binary)
+    struct rebx_extras* rebx = malloc(sizeof(*rebx));
+    if (rebx == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+        return NULL;
+    }
+    rebx_initialize(sim, rebx);
+    rebx_init_extras_from_archive(rebx, filename, snapshot, &warnings);
+
+    rebx_input_process_warnings(sim, warnings);
+    return rebx;
+}
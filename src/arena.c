@@ -0,0 +1,201 @@
+/**
+ * @file    arena.c
+ * @brief   Slab allocator for REBOUNDx nodes, params, forces, operators and steps.
+ * @author  Dan Tamayo <tamayo.daniel@gmail.com>
+ *
+ * @section LICENSE
+ * Copyright (c) 2015 Dan Tamayo, Hanno Rein
+ *
+ * This file is part of reboundx.
+ *
+ * reboundx is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * reboundx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rebound.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Small objects are carved out of large chunks, rounded up to a multiple of REBX_ARENA_ALIGN bytes.
+ * Each size class keeps a free list threaded through the freed blocks themselves, so blocks freed
+ * when e.g. particles are removed get reused. Objects larger than the biggest size class are
+ * malloc'd individually, kept on a separate list so they never displace the chunk being bumped,
+ * and returned to the system as soon as they are freed. All chunks and remaining large objects are
+ * freed together in rebx_arena_release, so tearing down a REBOUNDx instance is O(number of chunks).
+ * The arena is not thread safe: objects must not be created or freed in parallel regions.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "rebound.h"
+#include "reboundx.h"
+#include "core.h"
+
+#define REBX_ARENA_ALIGN 16
+#define REBX_ARENA_CHUNK_SIZE 65536
+
+struct rebx_arena_chunk{
+    struct rebx_arena_chunk* next;
+    size_t size;                    // usable bytes after the header
+    size_t used;                    // bytes handed out by bumping
+};
+
+struct rebx_arena_large{
+    struct rebx_arena_large* prev;
+    struct rebx_arena_large* next;
+};
+
+// Headers padded so that the data following them is aligned
+#define REBX_ARENA_HEADER_SIZE ((sizeof(struct rebx_arena_chunk) + REBX_ARENA_ALIGN - 1) & ~(size_t)(REBX_ARENA_ALIGN - 1))
+#define REBX_ARENA_LARGE_HEADER_SIZE ((sizeof(struct rebx_arena_large) + REBX_ARENA_ALIGN - 1) & ~(size_t)(REBX_ARENA_ALIGN - 1))
+
+static size_t rebx_arena_round(const size_t size){
+    return (size + REBX_ARENA_ALIGN - 1) & ~(size_t)(REBX_ARENA_ALIGN - 1);
+}
+
+static struct rebx_arena_chunk* rebx_arena_add_chunk(struct rebx_arena* const arena, const size_t size){
+    struct rebx_arena_chunk* chunk = malloc(REBX_ARENA_HEADER_SIZE + size);
+    if (chunk == NULL){
+        return NULL;
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->reserved += REBX_ARENA_HEADER_SIZE + size;
+    return chunk;
+}
+
+static void* rebx_arena_malloc_large(struct rebx_arena* const arena, const size_t size){
+    struct rebx_arena_large* large = malloc(REBX_ARENA_LARGE_HEADER_SIZE + size);
+    if (large == NULL){
+        return NULL;
+    }
+    large->prev = NULL;
+    large->next = arena->large;
+    if (arena->large != NULL){
+        arena->large->prev = large;
+    }
+    arena->large = large;
+    arena->reserved += REBX_ARENA_LARGE_HEADER_SIZE + size;
+    return (char*)large + REBX_ARENA_LARGE_HEADER_SIZE;
+}
+
+static void rebx_arena_free_large(struct rebx_arena* const arena, void* const ptr, const size_t size){
+    struct rebx_arena_large* large = (struct rebx_arena_large*)((char*)ptr - REBX_ARENA_LARGE_HEADER_SIZE);
+    if (large->prev != NULL){
+        large->prev->next = large->next;
+    }
+    else{
+        arena->large = large->next;
+    }
+    if (large->next != NULL){
+        large->next->prev = large->prev;
+    }
+    arena->reserved -= REBX_ARENA_LARGE_HEADER_SIZE + size;
+    free(large);
+}
+
+void rebx_arena_init(struct rebx_arena* const arena){
+    arena->chunks = NULL;
+    arena->large = NULL;
+    for (int i=0; i<REBX_ARENA_N_CLASSES; i++){
+        arena->free_lists[i] = NULL;
+    }
+    arena->used = 0;
+    arena->peak = 0;
+    arena->reserved = 0;
+}
+
+void* rebx_arena_malloc(struct rebx_extras* const rebx, const size_t memsize){
+    struct rebx_arena* const arena = &rebx->arena;
+    const size_t size = rebx_arena_round(memsize ? memsize : 1);
+    void* ptr = NULL;
+    if (size > REBX_ARENA_N_CLASSES*REBX_ARENA_ALIGN){
+        ptr = rebx_arena_malloc_large(arena, size);
+    }
+    else{
+        const int class = size/REBX_ARENA_ALIGN - 1;
+        if (arena->free_lists[class] != NULL){
+            ptr = arena->free_lists[class];
+            arena->free_lists[class] = *(void**)ptr;
+        }
+        else{
+            // Only the most recent chunk is bumped. Leftovers in older chunks are at most one block per chunk.
+            struct rebx_arena_chunk* chunk = arena->chunks;
+            if (chunk == NULL || chunk->size - chunk->used < size){
+                chunk = rebx_arena_add_chunk(arena, REBX_ARENA_CHUNK_SIZE);
+            }
+            if (chunk != NULL){
+                ptr = (char*)chunk + REBX_ARENA_HEADER_SIZE + chunk->used;
+                chunk->used += size;
+            }
+        }
+    }
+    if (ptr == NULL){
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return NULL;
+    }
+    arena->used += size;
+    if (arena->used > arena->peak){
+        arena->peak = arena->used;
+    }
+    return ptr;
+}
+
+void rebx_arena_free(struct rebx_extras* const rebx, void* const ptr, const size_t memsize){
+    if (ptr == NULL){
+        return;
+    }
+    struct rebx_arena* const arena = &rebx->arena;
+    const size_t size = rebx_arena_round(memsize ? memsize : 1);
+    arena->used -= size;
+    if (size <= REBX_ARENA_N_CLASSES*REBX_ARENA_ALIGN){
+        const int class = size/REBX_ARENA_ALIGN - 1;
+        *(void**)ptr = arena->free_lists[class];
+        arena->free_lists[class] = ptr;
+    }
+    else{
+        rebx_arena_free_large(arena, ptr, size);
+    }
+}
+
+char* rebx_arena_strdup(struct rebx_extras* const rebx, const char* const str){
+    char* copy = rebx_arena_malloc(rebx, strlen(str) + 1); // +1 for \0 at end
+    if (copy != NULL){
+        strcpy(copy, str);
+    }
+    return copy;
+}
+
+void rebx_arena_free_string(struct rebx_extras* const rebx, char* const str){
+    if (str != NULL){
+        rebx_arena_free(rebx, str, strlen(str) + 1);
+    }
+}
+
+void rebx_arena_release(struct rebx_arena* const arena){
+    struct rebx_arena_chunk* current = arena->chunks;
+    while (current != NULL){
+        struct rebx_arena_chunk* next = current->next;
+        free(current);
+        current = next;
+    }
+    struct rebx_arena_large* large = arena->large;
+    while (large != NULL){
+        struct rebx_arena_large* next = large->next;
+        free(large);
+        large = next;
+    }
+    const size_t peak = arena->peak;
+    rebx_arena_init(arena);
+    arena->peak = peak; // keep reporting the high-water mark after teardown
+}
@@ -0,0 +1,269 @@
+/**
+ * @file    async_output.c
+ * @brief   Writing REBOUNDx binaries to disk on a background thread.
+ * @author  Dan Tamayo <tamayo.daniel@gmail.com>
+ *
+ * @section LICENSE
+ * Copyright (c) 2015 Dan Tamayo, Hanno Rein
+ *
+ * This file is part of reboundx.
+ *
+ * reboundx is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * reboundx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rebound.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ The integration thread serializes each snapshot into memory (rebx_output_binary_buffer), which only costs a copy of the effects and params,
+ and queues it. A writer thread takes snapshots off the queue and writes and syncs them, so only it ever waits for the disk. It never touches
+ the rebx_extras instance, so the integration can carry on while it writes. The queue is a ring buffer of max_pending snapshots; when it is
+ full rebx_output_binary_async skips the snapshot rather than waiting.
+
+ On Windows there is no writer thread, and snapshots are written before rebx_output_binary_async returns.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "rebound.h"
+#include "reboundx.h"
+#include "core.h"
+
+#define REBX_ASYNC_OUTPUT_DEFAULT_PENDING 4  // Queue length when rebx_output_binary_async is called before rebx_enable_async_output
+
+struct rebx_async_snapshot{
+    char* filename;
+    char* data;                 // binary from rebx_output_binary_buffer
+    size_t size;
+};
+
+struct rebx_async_output{
+    struct rebx_async_snapshot* queue;  // ring buffer of max_pending snapshots
+    int max_pending;
+    int first;                          // index of the oldest snapshot in queue
+    int N_queued;                       // snapshots in queue, including the one being written
+    int N_failed;                       // snapshots that failed since the last rebx_wait_async_output
+    int stopping;                       // set by rebx_disable_async_output. The thread exits once the queue is empty.
+    void (*callback)(const char* filename, int success, void* context);
+    void* context;
+#ifndef _WIN32
+    pthread_t thread;
+    pthread_mutex_t mutex;              // guards first, N_queued, N_failed and stopping
+    pthread_cond_t queued;              // signalled when a snapshot is queued or stopping is set
+    pthread_cond_t written;             // signalled when a snapshot has been written
+#endif
+};
+
+// Writes to a temporary file that replaces filename once it is on disk, so a crash never leaves a partially written snapshot behind
+static int rebx_async_output_write(const struct rebx_async_snapshot* const snapshot){
+    char* tmpname = malloc(strlen(snapshot->filename) + strlen(".tmp") + 1);
+    if (tmpname == NULL){
+        return 0;
+    }
+    sprintf(tmpname, "%s.tmp", snapshot->filename);
+    FILE* of = fopen(tmpname, "wb");
+    if (of == NULL){
+        free(tmpname);
+        return 0;
+    }
+    int success = (fwrite(snapshot->data, 1, snapshot->size, of) == snapshot->size);
+    if (fflush(of) != 0){
+        success = 0;
+    }
+#ifndef _WIN32
+    if (fsync(fileno(of)) != 0){
+        success = 0;
+    }
+#endif
+    if (fclose(of) != 0){
+        success = 0;
+    }
+    if (success){
+#ifdef _WIN32
+        remove(snapshot->filename); // rename doesn't replace existing files on Windows
+#endif
+        success = (rename(tmpname, snapshot->filename) == 0);
+    }
+    if (!success){
+        remove(tmpname);
+    }
+    free(tmpname);
+    return success;
+}
+
+static void rebx_async_output_finish(struct rebx_async_output* const output, struct rebx_async_snapshot* const snapshot, const int success){
+    if (output->callback != NULL){
+        output->callback(snapshot->filename, success, output->context);
+    }
+    free(snapshot->filename);
+    free(snapshot->data);
+}
+
+#ifndef _WIN32
+static void* rebx_async_output_thread(void* arg){
+    struct rebx_async_output* const output = arg;
+    pthread_mutex_lock(&output->mutex);
+    while (1){
+        while (output->N_queued == 0 && !output->stopping){
+            pthread_cond_wait(&output->queued, &output->mutex);
+        }
+        if (output->N_queued == 0){ // stopping, and everything queued has been written
+            break;
+        }
+        // The integration thread only adds snapshots behind this one, so it can be written without holding the lock
+        struct rebx_async_snapshot snapshot = output->queue[output->first];
+        pthread_mutex_unlock(&output->mutex);
+        const int success = rebx_async_output_write(&snapshot);
+        rebx_async_output_finish(output, &snapshot, success);
+        pthread_mutex_lock(&output->mutex);
+        output->first = (output->first + 1) % output->max_pending;
+        output->N_queued--;
+        if (!success){
+            output->N_failed++;
+        }
+        pthread_cond_broadcast(&output->written);
+    }
+    pthread_mutex_unlock(&output->mutex);
+    return NULL;
+}
+#endif
+
+int rebx_enable_async_output(struct rebx_extras* const rebx, const int max_pending, void (*callback)(const char* filename, int success, void* context), void* context){
+    if (max_pending < 1){
+        rebx_error(rebx, "REBOUNDx Error: max_pending passed to rebx_enable_async_output must be at least 1.\n");
+        return 0;
+    }
+    rebx_disable_async_output(rebx); // writes out anything queued with the old settings
+    struct rebx_async_output* const output = malloc(sizeof(*output));
+    struct rebx_async_snapshot* const queue = malloc(max_pending*sizeof(*queue));
+    if (output == NULL || queue == NULL){
+        free(output);
+        free(queue);
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    output->queue = queue;
+    output->max_pending = max_pending;
+    output->first = 0;
+    output->N_queued = 0;
+    output->N_failed = 0;
+    output->stopping = 0;
+    output->callback = callback;
+    output->context = context;
+#ifndef _WIN32
+    if (pthread_mutex_init(&output->mutex, NULL) != 0){
+        free(queue);
+        free(output);
+        rebx_error(rebx, "REBOUNDx Error: Could not start the thread for rebx_output_binary_async.\n");
+        return 0;
+    }
+    pthread_cond_init(&output->queued, NULL);
+    pthread_cond_init(&output->written, NULL);
+    if (pthread_create(&output->thread, NULL, rebx_async_output_thread, output) != 0){
+        pthread_cond_destroy(&output->queued);
+        pthread_cond_destroy(&output->written);
+        pthread_mutex_destroy(&output->mutex);
+        free(queue);
+        free(output);
+        rebx_error(rebx, "REBOUNDx Error: Could not start the thread for rebx_output_binary_async.\n");
+        return 0;
+    }
+#endif
+    rebx->async_output = output;
+    return 1;
+}
+
+void rebx_disable_async_output(struct rebx_extras* const rebx){
+    struct rebx_async_output* const output = rebx->async_output;
+    if (output == NULL){
+        return;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock(&output->mutex);
+    output->stopping = 1;
+    pthread_cond_signal(&output->queued);
+    pthread_mutex_unlock(&output->mutex);
+    pthread_join(output->thread, NULL);
+    pthread_cond_destroy(&output->queued);
+    pthread_cond_destroy(&output->written);
+    pthread_mutex_destroy(&output->mutex);
+#endif
+    free(output->queue);
+    free(output);
+    rebx->async_output = NULL;
+}
+
+int rebx_output_binary_async(struct rebx_extras* const rebx, const char* const filename){
+    if (rebx->async_output == NULL && !rebx_enable_async_output(rebx, REBX_ASYNC_OUTPUT_DEFAULT_PENDING, NULL, NULL)){
+        return 0;
+    }
+    struct rebx_async_output* const output = rebx->async_output;
+#ifndef _WIN32
+    // Check for room before copying, so that skipped snapshots cost nothing. Only this thread adds snapshots, so the room can't go away.
+    pthread_mutex_lock(&output->mutex);
+    const int full = (output->N_queued == output->max_pending);
+    pthread_mutex_unlock(&output->mutex);
+    if (full){
+        return 0;
+    }
+#endif
+    struct rebx_async_snapshot snapshot;
+    snapshot.data = rebx_output_binary_buffer(rebx, &snapshot.size);
+    if (snapshot.data == NULL){
+        return 0;
+    }
+    snapshot.filename = malloc(strlen(filename) + 1);
+    if (snapshot.filename == NULL){
+        free(snapshot.data);
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    strcpy(snapshot.filename, filename);
+#ifdef _WIN32
+    const int success = rebx_async_output_write(&snapshot);
+    rebx_async_output_finish(output, &snapshot, success);
+    if (!success){
+        output->N_failed++;
+    }
+#else
+    pthread_mutex_lock(&output->mutex);
+    output->queue[(output->first + output->N_queued) % output->max_pending] = snapshot;
+    output->N_queued++;
+    pthread_cond_signal(&output->queued);
+    pthread_mutex_unlock(&output->mutex);
+#endif
+    return 1;
+}
+
+int rebx_wait_async_output(struct rebx_extras* const rebx){
+    struct rebx_async_output* const output = rebx->async_output;
+    if (output == NULL){
+        return 0;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock(&output->mutex);
+    while (output->N_queued > 0){
+        pthread_cond_wait(&output->written, &output->mutex);
+    }
+#endif
+    const int N_failed = output->N_failed;
+    output->N_failed = 0;
+#ifndef _WIN32
+    pthread_mutex_unlock(&output->mutex);
+#endif
+    return N_failed;
+}
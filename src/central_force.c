@@ -60,8 +60,9 @@
 #include "rebound.h"
 #include "reboundx.h"
 
-static void rebx_calculate_central_force(struct reb_simulation* const sim, struct reb_particle* const particles, const int N, const double A, const double gamma, const int source_index){
+static void rebx_calculate_central_force(struct reb_simulation* const sim, struct reb_particle* const particles, const int N, const double A, const double gamma, const int source_index, struct reb_vec3d* const back_reactions){
     const struct reb_particle source = particles[source_index];
+#pragma omp parallel for
     for (int i=0; i<N; i++){
         if(i == source_index){
             continue;
@@ -76,19 +77,40 @@ static void rebx_calculate_central_force(struct reb_simulation* const sim, struc
         particles[i].ax += prefac*dx;
         particles[i].ay += prefac*dy;
         particles[i].az += prefac*dz;
-        particles[source_index].ax -= p.m/source.m*prefac*dx;
-        particles[source_index].ay -= p.m/source.m*prefac*dy;
-        particles[source_index].az -= p.m/source.m*prefac*dz;
+        back_reactions[i].x = p.m/source.m*prefac*dx;
+        back_reactions[i].y = p.m/source.m*prefac*dy;
+        back_reactions[i].z = p.m/source.m*prefac*dz;
+    }
+    // Sum back reactions serially in index order so results don't depend on the number of threads
+    for (int i=0; i<N; i++){
+        if(i == source_index){
+            continue;
+        }
+        particles[source_index].ax -= back_reactions[i].x;
+        particles[source_index].ay -= back_reactions[i].y;
+        particles[source_index].az -= back_reactions[i].z;
     }
 }
 
 void rebx_central_force(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
-    for (int i=0; i<N; i++){
-        const double* const Acentral = rebx_get_param(sim->extras, particles[i].ap, "Acentral");
+    struct rebx_extras* const rebx = sim->extras;
+    struct reb_vec3d* const back_reactions = rebx_get_force_workspace(sim, force, N*sizeof(*back_reactions));
+    if (back_reactions == NULL){
+        return;
+    }
+    const int Acentral_id = rebx_get_param_id(rebx, "Acentral");
+    const int gammacentral_id = rebx_get_param_id(rebx, "gammacentral");
+    const struct rebx_role_list* const centrals = rebx_get_role_particles(rebx, Acentral_id, particles, N);
+    if (centrals == NULL){
+        return;
+    }
+    for (int k=0; k<centrals->N_roles; k++){
+        const int i = centrals->indices[k];
+        const double* const Acentral = rebx_get_param_by_id(rebx, particles[i].ap, Acentral_id);
         if (Acentral != NULL){
-            const double* const gammacentral = rebx_get_param(sim->extras, particles[i].ap, "gammacentral");
+            const double* const gammacentral = rebx_get_param_by_id(rebx, particles[i].ap, gammacentral_id);
             if (gammacentral != NULL){
-                rebx_calculate_central_force(sim, particles, N, *Acentral, *gammacentral, i); // only calculates force if a particle has both Acentral and gammacentral parameters set.
+                rebx_calculate_central_force(sim, particles, N, *Acentral, *gammacentral, i, back_reactions); // only calculates force if a particle has both Acentral and gammacentral parameters set.
             }
         }
     }
@@ -127,11 +149,13 @@ double rebx_central_force_potential(struct rebx_extras* const rebx){
     struct reb_simulation* sim = rebx->sim;
     const int N_real = sim->N - sim->N_var;
     struct reb_particle* const particles = sim->particles;
+    const int Acentral_id = rebx_get_param_id(rebx, "Acentral");
+    const int gammacentral_id = rebx_get_param_id(rebx, "gammacentral");
     double Htot = 0.;
     for (int i=0; i<N_real; i++){
-        const double* const Acentral = rebx_get_param(rebx, particles[i].ap, "Acentral");
+        const double* const Acentral = rebx_get_param_by_id(rebx, particles[i].ap, Acentral_id);
         if (Acentral != NULL){
-            const double* const gammacentral = rebx_get_param(rebx, particles[i].ap, "gammacentral");
+            const double* const gammacentral = rebx_get_param_by_id(rebx, particles[i].ap, gammacentral_id);
             if (gammacentral != NULL){
                 Htot += rebx_calculate_central_force_potential(sim, *Acentral, *gammacentral, i);
             }
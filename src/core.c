@@ -24,6 +24,7 @@
  */
 
 /* Main routines called each timestep. */
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -31,6 +32,9 @@
 #include <string.h>
 #include <limits.h>
 #include <float.h>
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
 #include "core.h"
 #include "rebound.h"
 #include "linkedlist.h"
@@ -48,102 +52,170 @@ const char* rebx_githash_str = STRINGIFY(REBXGITHASH);             // This line
  Initialization routines.
  ****************************/
 
-void rebx_register_default_params(struct rebx_extras* rebx){
-    rebx_register_param(rebx, "c", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gr_source", REBX_TYPE_INT);
-    rebx_register_param(rebx, "tau_mass", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "force", REBX_TYPE_FORCE);
-    rebx_register_param(rebx, "particle", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "Acentral", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gammacentral", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "max_iterations", REBX_TYPE_INT);
-    rebx_register_param(rebx, "J2", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "J4", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "R_eq", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "coordinates", REBX_TYPE_INT);
-    rebx_register_param(rebx, "p", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "d_factor", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "cs_coeff", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_coeff", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_a", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_e", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_inc", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_omega", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_Omega", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "em_tau_a", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "em_aini", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "em_afin", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "primary", REBX_TYPE_INT);
-    rebx_register_param(rebx, "radiation_source", REBX_TYPE_INT);
-    rebx_register_param(rebx, "kappa", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "kappa_x", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "kappa_y", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "kappa_z", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_kappa", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_kappa_x", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_kappa_y", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau_kappa_z", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "stochastic_force_r", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "stochastic_force_phi", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "stochastic_force_x", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "stochastic_force_y", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "stochastic_force_z", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "beta", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tides_primary", REBX_TYPE_INT);
-    rebx_register_param(rebx, "R_tides", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tctl_k2", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tctl_tau", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "integrator", REBX_TYPE_INT);
-    rebx_register_param(rebx, "free_arrays", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "im_ps_final", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "im_ps_prev", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "im_ps_avg", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "rk2_k2", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "rk4_k2", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "rk4_k3", REBX_TYPE_POINTER);
-    rebx_register_param(rebx, "min_distance", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "min_distance_from", REBX_TYPE_UINT32);
-    rebx_register_param(rebx, "min_distance_orbit", REBX_TYPE_ORBIT);
-    rebx_register_param(rebx, "luminosity", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ide_position", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ide_width", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tIm_flaring_index", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tIm_scale_height_1", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tIm_surface_density_1", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tIm_surface_density_exponent", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_c", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_body_density", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_lstar", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_flag", REBX_TYPE_INT);
-    rebx_register_param(rebx, "ye_rotation_period", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_thermal_inertia", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_albedo", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_emissivity", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_k", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_stef_boltz", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_spin_axis_x", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_spin_axis_y", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ye_spin_axis_z", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "OmegaMag", REBX_TYPE_VEC3D);
-    rebx_register_param(rebx, "Omega", REBX_TYPE_VEC3D);
-    rebx_register_param(rebx, "k2", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "I", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "tau", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "ode", REBX_TYPE_ODE);
-    rebx_register_param(rebx, "gas_df_rhog", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gas_df_alpha_rhog", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gas_df_cs", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gas_df_alpha_cs", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gas_df_xmin", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gas_df_hr", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "gas_df_Qd", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "lt_R_eq", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "lt_Mom_I_fac", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "lt_rot_rate", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "lt_p_hatx", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "lt_p_haty", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "lt_p_hatz", REBX_TYPE_DOUBLE);
-    rebx_register_param(rebx, "lt_c", REBX_TYPE_DOUBLE);
+/* Parameters REBOUNDx registers for its effects. This table is shared read-only by all rebx_extras instances, and
+ * a parameter's id is its position in it. Parameters registered with rebx_register_param get the ids after these.
+ * To add one, append a line to the table and run scripts/builtin_tables.py, which renumbers the ids and regenerates
+ * the perfect hash used by rebx_get_builtin_param_id. */
+// **BUILTINPARAMS** Everything up to the END line is generated by scripts/builtin_tables.py
+static const struct rebx_param rebx_builtin_params[] = {
+    {"c", REBX_TYPE_DOUBLE, 0, NULL},
+    {"gr_source", REBX_TYPE_INT, 1, NULL},
+    {"tau_mass", REBX_TYPE_DOUBLE, 2, NULL},
+    {"force", REBX_TYPE_FORCE, 3, NULL},
+    {"particle", REBX_TYPE_POINTER, 4, NULL},
+    {"Acentral", REBX_TYPE_DOUBLE, 5, NULL},
+    {"gammacentral", REBX_TYPE_DOUBLE, 6, NULL},
+    {"max_iterations", REBX_TYPE_INT, 7, NULL},
+    {"gr_tolerance", REBX_TYPE_DOUBLE, 8, NULL},
+    {"gr_warm_start", REBX_TYPE_INT, 9, NULL},
+    {"gr_iterations", REBX_TYPE_INT, 10, NULL},
+    {"gr_max_residual", REBX_TYPE_DOUBLE, 11, NULL},
+    {"gr_nonconverged", REBX_TYPE_INT, 12, NULL},
+    {"J2", REBX_TYPE_DOUBLE, 13, NULL},
+    {"J4", REBX_TYPE_DOUBLE, 14, NULL},
+    {"R_eq", REBX_TYPE_DOUBLE, 15, NULL},
+    {"coordinates", REBX_TYPE_INT, 16, NULL},
+    {"p", REBX_TYPE_DOUBLE, 17, NULL},
+    {"d_factor", REBX_TYPE_DOUBLE, 18, NULL},
+    {"cs_coeff", REBX_TYPE_DOUBLE, 19, NULL},
+    {"tau_coeff", REBX_TYPE_DOUBLE, 20, NULL},
+    {"tau_a", REBX_TYPE_DOUBLE, 21, NULL},
+    {"tau_e", REBX_TYPE_DOUBLE, 22, NULL},
+    {"tau_inc", REBX_TYPE_DOUBLE, 23, NULL},
+    {"tau_omega", REBX_TYPE_DOUBLE, 24, NULL},
+    {"tau_Omega", REBX_TYPE_DOUBLE, 25, NULL},
+    {"em_tau_a", REBX_TYPE_DOUBLE, 26, NULL},
+    {"em_aini", REBX_TYPE_DOUBLE, 27, NULL},
+    {"em_afin", REBX_TYPE_DOUBLE, 28, NULL},
+    {"primary", REBX_TYPE_INT, 29, NULL},
+    {"radiation_source", REBX_TYPE_INT, 30, NULL},
+    {"kappa", REBX_TYPE_DOUBLE, 31, NULL},
+    {"kappa_x", REBX_TYPE_DOUBLE, 32, NULL},
+    {"kappa_y", REBX_TYPE_DOUBLE, 33, NULL},
+    {"kappa_z", REBX_TYPE_DOUBLE, 34, NULL},
+    {"tau_kappa", REBX_TYPE_DOUBLE, 35, NULL},
+    {"tau_kappa_x", REBX_TYPE_DOUBLE, 36, NULL},
+    {"tau_kappa_y", REBX_TYPE_DOUBLE, 37, NULL},
+    {"tau_kappa_z", REBX_TYPE_DOUBLE, 38, NULL},
+    {"stochastic_force_r", REBX_TYPE_DOUBLE, 39, NULL},
+    {"stochastic_force_phi", REBX_TYPE_DOUBLE, 40, NULL},
+    {"stochastic_force_x", REBX_TYPE_DOUBLE, 41, NULL},
+    {"stochastic_force_y", REBX_TYPE_DOUBLE, 42, NULL},
+    {"stochastic_force_z", REBX_TYPE_DOUBLE, 43, NULL},
+    {"beta", REBX_TYPE_DOUBLE, 44, NULL},
+    {"tides_primary", REBX_TYPE_INT, 45, NULL},
+    {"R_tides", REBX_TYPE_DOUBLE, 46, NULL},
+    {"tctl_k2", REBX_TYPE_DOUBLE, 47, NULL},
+    {"tctl_tau", REBX_TYPE_DOUBLE, 48, NULL},
+    {"integrator", REBX_TYPE_INT, 49, NULL},
+    {"free_arrays", REBX_TYPE_POINTER, 50, NULL},
+    {"im_ps_final", REBX_TYPE_POINTER, 51, NULL},
+    {"im_ps_prev", REBX_TYPE_POINTER, 52, NULL},
+    {"im_ps_avg", REBX_TYPE_POINTER, 53, NULL},
+    {"rk2_k2", REBX_TYPE_POINTER, 54, NULL},
+    {"rk4_k2", REBX_TYPE_POINTER, 55, NULL},
+    {"rk4_k3", REBX_TYPE_POINTER, 56, NULL},
+    {"min_distance", REBX_TYPE_DOUBLE, 57, NULL},
+    {"min_distance_from", REBX_TYPE_UINT32, 58, NULL},
+    {"min_distance_orbit", REBX_TYPE_ORBIT, 59, NULL},
+    {"luminosity", REBX_TYPE_DOUBLE, 60, NULL},
+    {"ide_position", REBX_TYPE_DOUBLE, 61, NULL},
+    {"ide_width", REBX_TYPE_DOUBLE, 62, NULL},
+    {"tIm_flaring_index", REBX_TYPE_DOUBLE, 63, NULL},
+    {"tIm_scale_height_1", REBX_TYPE_DOUBLE, 64, NULL},
+    {"tIm_surface_density_1", REBX_TYPE_DOUBLE, 65, NULL},
+    {"tIm_surface_density_exponent", REBX_TYPE_DOUBLE, 66, NULL},
+    {"ye_c", REBX_TYPE_DOUBLE, 67, NULL},
+    {"ye_body_density", REBX_TYPE_DOUBLE, 68, NULL},
+    {"ye_lstar", REBX_TYPE_DOUBLE, 69, NULL},
+    {"ye_flag", REBX_TYPE_INT, 70, NULL},
+    {"ye_rotation_period", REBX_TYPE_DOUBLE, 71, NULL},
+    {"ye_thermal_inertia", REBX_TYPE_DOUBLE, 72, NULL},
+    {"ye_albedo", REBX_TYPE_DOUBLE, 73, NULL},
+    {"ye_emissivity", REBX_TYPE_DOUBLE, 74, NULL},
+    {"ye_k", REBX_TYPE_DOUBLE, 75, NULL},
+    {"ye_stef_boltz", REBX_TYPE_DOUBLE, 76, NULL},
+    {"ye_spin_axis_x", REBX_TYPE_DOUBLE, 77, NULL},
+    {"ye_spin_axis_y", REBX_TYPE_DOUBLE, 78, NULL},
+    {"ye_spin_axis_z", REBX_TYPE_DOUBLE, 79, NULL},
+    {"OmegaMag", REBX_TYPE_VEC3D, 80, NULL},
+    {"Omega", REBX_TYPE_VEC3D, 81, NULL},
+    {"k2", REBX_TYPE_DOUBLE, 82, NULL},
+    {"I", REBX_TYPE_DOUBLE, 83, NULL},
+    {"tau", REBX_TYPE_DOUBLE, 84, NULL},
+    {"ode", REBX_TYPE_ODE, 85, NULL},
+    {"gas_df_rhog", REBX_TYPE_DOUBLE, 86, NULL},
+    {"gas_df_alpha_rhog", REBX_TYPE_DOUBLE, 87, NULL},
+    {"gas_df_cs", REBX_TYPE_DOUBLE, 88, NULL},
+    {"gas_df_alpha_cs", REBX_TYPE_DOUBLE, 89, NULL},
+    {"gas_df_xmin", REBX_TYPE_DOUBLE, 90, NULL},
+    {"gas_df_hr", REBX_TYPE_DOUBLE, 91, NULL},
+    {"gas_df_Qd", REBX_TYPE_DOUBLE, 92, NULL},
+    {"lt_R_eq", REBX_TYPE_DOUBLE, 93, NULL},
+    {"lt_Mom_I_fac", REBX_TYPE_DOUBLE, 94, NULL},
+    {"lt_rot_rate", REBX_TYPE_DOUBLE, 95, NULL},
+    {"lt_p_hatx", REBX_TYPE_DOUBLE, 96, NULL},
+    {"lt_p_haty", REBX_TYPE_DOUBLE, 97, NULL},
+    {"lt_p_hatz", REBX_TYPE_DOUBLE, 98, NULL},
+    {"lt_c", REBX_TYPE_DOUBLE, 99, NULL},
+    {"gr_reuse_gravity", REBX_TYPE_INT, 100, NULL},
+};
+#define REBX_N_BUILTIN_PARAMS 101
+#define REBX_BUILTIN_PARAM_N_BUCKETS 32
+#define REBX_BUILTIN_PARAM_N_SLOTS 256
+static const uint16_t rebx_builtin_param_seeds[REBX_BUILTIN_PARAM_N_BUCKETS] = {
+    2, 1, 2, 5, 1, 1, 3, 4, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 6, 3, 2, 3, 1, 1, 1, 2, 1, 1, 2, 1,
+};
+static const int16_t rebx_builtin_param_slots[REBX_BUILTIN_PARAM_N_SLOTS] = {
+    -1, 71, 35, -1, -1, -1, 22, -1, -1, 45, -1, 16, 43, -1, 40, -1,
+    75, -1, 67, -1, -1, 53, 38, -1, -1, -1, 14, -1, 90, -1, 34, -1,
+    -1, -1, 84, 87, -1, -1, 99, -1, -1, 63, -1, 76, 50, -1, 6, 31,
+    19, -1, -1, -1, -1, -1, -1, -1, 2, 86, 37, 72, 68, 95, -1, -1,
+    -1, -1, 29, 80, -1, -1, -1, -1, 97, 51, -1, 28, -1, -1, 25, 55,
+    -1, -1, 21, -1, -1, 15, -1, -1, -1, 30, -1, -1, 17, 82, 10, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 7, -1, -1,
+    -1, -1, -1, -1, -1, 70, 89, -1, -1, -1, 11, -1, -1, 23, 18, -1,
+    -1, 9, 57, -1, -1, 20, -1, -1, 26, -1, -1, 33, -1, -1, 32, -1,
+    -1, 78, 88, -1, 64, -1, -1, 3, -1, -1, -1, -1, 48, -1, 85, -1,
+    -1, 69, -1, -1, 39, -1, -1, -1, 13, 59, -1, 62, 12, -1, 24, -1,
+    -1, -1, -1, 47, -1, -1, -1, 81, -1, -1, -1, 58, 56, 60, 8, -1,
+    -1, -1, -1, -1, 27, 42, -1, -1, 65, -1, 66, -1, -1, 36, 52, -1,
+    -1, 100, -1, -1, 5, 54, 74, 1, 79, -1, 61, 96, 93, -1, -1, -1,
+    98, 94, -1, -1, -1, 0, -1, -1, 46, -1, -1, 91, 92, -1, 41, -1,
+    -1, -1, -1, 44, -1, -1, 4, 83, 73, -1, -1, -1, -1, 49, 77, -1,
+};
+// **BUILTINPARAMS END**
+
+// Fails to compile if the table was edited without rerunning scripts/builtin_tables.py
+typedef char rebx_builtin_params_need_regenerating[(sizeof(rebx_builtin_params)/sizeof(rebx_builtin_params[0]) == REBX_N_BUILTIN_PARAMS) ? 1 : -1];
+
+// 32 bit FNV-1a with the seed mixed into the offset basis. Must match builtin_hash in scripts/builtin_tables.py
+static uint32_t rebx_builtin_hash(const char* str, const uint32_t seed){
+    uint32_t hash = 2166136261u ^ seed;
+    for (; *str != '\0'; str++){
+        hash ^= (unsigned char)*str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns id of built-in param name, or -1 if it is not one
+static int rebx_get_builtin_param_id(const char* const name){
+    const uint32_t bucket = rebx_builtin_hash(name, 0) % REBX_BUILTIN_PARAM_N_BUCKETS;
+    const uint32_t slot = rebx_builtin_hash(name, rebx_builtin_param_seeds[bucket]) % REBX_BUILTIN_PARAM_N_SLOTS;
+    const int id = rebx_builtin_param_slots[slot];
+    if (id >= 0 && strcmp(rebx_builtin_params[id].name, name) == 0){
+        return id;
+    }
+    return -1;
+}
+
+const struct rebx_param* rebx_get_registered_param(struct rebx_extras* const rebx, const int id){
+    if (id < REBX_N_BUILTIN_PARAMS){
+        return &rebx_builtin_params[id];
+    }
+    return rebx->registered_param_table[id - REBX_N_BUILTIN_PARAMS];
 }
 
 void rebx_register_param(struct rebx_extras* const rebx, const char* name, enum rebx_param_type type){
@@ -163,14 +235,106 @@ void rebx_register_param(struct rebx_extras* const rebx, const char* name, enum
     if (param == NULL){
         return;
     }
-    int success = rebx_add_param(rebx, &rebx->registered_params, param);
+    int success = rebx_add_registered_param(rebx, param);
     if(!success){
-        rebx_free_param(param);
+        rebx_free_reg_param(rebx, param);
     }
 
     return;
 }
 
+// Doubles the hash table and reinserts the ids of all user registered params. Keeps load factor <= 1/2.
+static int rebx_grow_registered_param_hash(struct rebx_extras* const rebx){
+    const int size = rebx->registered_param_hash_size ? 2*rebx->registered_param_hash_size : 16;
+    int* hash = rebx_malloc(rebx, size*sizeof(*hash));
+    if (hash == NULL){
+        return 0;
+    }
+    for (int i=0; i<size; i++){
+        hash[i] = -1;
+    }
+    for (int id=REBX_N_BUILTIN_PARAMS; id<rebx->N_registered_params; id++){
+        int slot = reb_hash(rebx_get_registered_param(rebx, id)->name) & (size-1);
+        while (hash[slot] != -1){
+            slot = (slot+1) & (size-1);
+        }
+        hash[slot] = id;
+    }
+    free(rebx->registered_param_hash);
+    rebx->registered_param_hash = hash;
+    rebx->registered_param_hash_size = size;
+    return 1;
+}
+
+// Grows the arrays indexed by id (registered_param_table only holds the user registered params after the built-in ones)
+static int rebx_grow_registered_params(struct rebx_extras* const rebx){
+    const int N_allocated = rebx->N_allocated_registered_params ? 2*rebx->N_allocated_registered_params : REBX_N_BUILTIN_PARAMS + 32;
+    struct rebx_param** table = realloc(rebx->registered_param_table, (N_allocated - REBX_N_BUILTIN_PARAMS)*sizeof(*table));
+    if (table == NULL){
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    rebx->registered_param_table = table;
+    unsigned long* versions = realloc(rebx->param_versions, N_allocated*sizeof(*versions));
+    if (versions == NULL){
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    rebx->param_versions = versions;
+    struct rebx_param_column** columns = realloc(rebx->param_columns, N_allocated*sizeof(*columns));
+    if (columns == NULL){
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    rebx->param_columns = columns;
+    struct rebx_role_list** role_lists = realloc(rebx->role_lists, N_allocated*sizeof(*role_lists));
+    if (role_lists == NULL){
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    rebx->role_lists = role_lists;
+    for (int i=rebx->N_allocated_registered_params; i<N_allocated; i++){
+        rebx->param_versions[i] = 0;
+        rebx->param_columns[i] = NULL;
+        rebx->role_lists[i] = NULL;
+    }
+    rebx->N_allocated_registered_params = N_allocated;
+    return 1;
+}
+
+int rebx_add_registered_param(struct rebx_extras* const rebx, struct rebx_param* param){
+    if (rebx->N_registered_params >= rebx->N_allocated_registered_params){
+        if (!rebx_grow_registered_params(rebx)){
+            return 0;
+        }
+    }
+    if (2*(rebx->N_registered_params+1) > rebx->registered_param_hash_size){
+        if (!rebx_grow_registered_param_hash(rebx)){
+            return 0;
+        }
+    }
+
+    struct rebx_node* node = rebx_create_node(rebx);
+    if (node == NULL){
+        return 0;
+    }
+    node->object = param;
+    rebx_add_node(&rebx->registered_params, node);
+
+    const int id = rebx->N_registered_params;
+    param->id = id;
+    rebx->registered_param_table[id - REBX_N_BUILTIN_PARAMS] = param;
+    rebx->N_registered_params++;
+
+    const int mask = rebx->registered_param_hash_size - 1;
+    int slot = reb_hash(param->name) & mask;
+    while (rebx->registered_param_hash[slot] != -1){
+        slot = (slot+1) & mask;
+    }
+    rebx->registered_param_hash[slot] = id;
+    return 1;
+}
+
 struct rebx_extras* rebx_attach(struct reb_simulation* sim){  // reboundx.h
     if (sim == NULL){
         fprintf(stderr, "REBOUNDx Error: Simulation pointer passed to rebx_attach was NULL.\n");
@@ -178,7 +342,6 @@ struct rebx_extras* rebx_attach(struct reb_simulation* sim){  // reboundx.h
     }
     struct rebx_extras* rebx = malloc(sizeof(*rebx));
     rebx_initialize(sim, rebx);
-    rebx_register_default_params(rebx);
     return rebx;
 }
 
@@ -223,6 +386,28 @@ void rebx_initialize(struct reb_simulation* sim, struct rebx_extras* rebx){
     rebx->allocated_forces=NULL;
     rebx->allocated_operators=NULL;
     rebx->registered_params=NULL;
+    rebx->registered_param_table=NULL;
+    rebx->registered_param_hash=NULL;
+    rebx->N_registered_params=0;
+    rebx->N_allocated_registered_params=0;
+    rebx->registered_param_hash_size=0;
+    rebx->param_versions=NULL;
+    rebx->param_layout_version=0;
+    rebx->param_columns=NULL;
+    rebx->role_lists=NULL;
+    rebx->orbit_cache=NULL;
+    rebx->gravity_snapshot=NULL;
+    rebx->jacobi_frame=NULL;
+    rebx->evaluating_forces=0;
+    rebx->archive_state=NULL;
+    rebx->archive_keyframe_interval=100;
+    rebx->async_output=NULL;
+    rebx->preparing_force=NULL;
+    rebx_arena_init(&rebx->arena);
+
+    // Built-in params are always registered (see rebx_builtin_params). Only their versions and columns are per instance.
+    rebx->N_registered_params = REBX_N_BUILTIN_PARAMS;
+    rebx_grow_registered_params(rebx);
 
     sim->free_particle_ap = rebx_free_particle_ap;
     sim->extras_cleanup = rebx_extras_cleanup;
@@ -246,7 +431,7 @@ struct rebx_force* rebx_create_force(struct rebx_extras* const rebx, const char*
         rebx_error(rebx, ""); // rebx_error gives meaningful err
         return NULL;
     }
-    struct rebx_force* force = rebx_malloc(rebx, sizeof(*force));
+    struct rebx_force* force = rebx_arena_malloc(rebx, sizeof(*force));
     if (force == NULL){
         return NULL;
     }
@@ -254,17 +439,23 @@ struct rebx_force* rebx_create_force(struct rebx_extras* const rebx, const char*
     force->sim = rebx->sim;
     force->force_type = REBX_FORCE_NONE;
     force->update_accelerations = NULL;
+    force->prepare = NULL;
+    force->plan = NULL;
+    force->plan_N = -1;
+    force->plan_version = 0;
+    force->plan_param_ids = NULL;
+    force->N_plan_param_ids = 0;
+    force->N_allocated_plan_param_ids = 0;
+    force->workspace = NULL;
+    force->workspace_size = 0;
     force->name = NULL;
     if(name != NULL)
     {
-        force->name = rebx_malloc(rebx, strlen(name) + 1); // +1 for \0 at end
+        force->name = rebx_arena_strdup(rebx, name);
         if (force->name == NULL){
             rebx_free_force(rebx, force);
             return NULL;
         }
-        else{
-            strcpy(force->name, name);
-        }
     }
 
     // Add force to allocated_forces list for later freeing
@@ -279,82 +470,173 @@ struct rebx_force* rebx_create_force(struct rebx_extras* const rebx, const char*
     return force;
 }
 
-struct rebx_force* rebx_load_force(struct rebx_extras* const rebx, const char* name){
-    struct rebx_force* force = rebx_create_force(rebx, name);
-    if (force == NULL){
-        return NULL;
-    }
-    if(strcmp(name, "gr") == 0){
-        force->update_accelerations = rebx_gr;
-        force->force_type = REBX_FORCE_VEL;
-    }
-    else if (strcmp(name, "central_force") == 0){
-        force->update_accelerations = rebx_central_force;
-        force->force_type = REBX_FORCE_POS;
+/* Forces and operators rebx_load_force and rebx_load_operator can create by name (see rebx_effect_descriptor).
+ * To add one, add a line to the table and run scripts/builtin_tables.py, which regenerates the perfect hash used by
+ * rebx_get_builtin_effect. Effects registered at runtime (see rebx_register_effect) take precedence over these. */
+static const struct rebx_effect_descriptor rebx_builtin_effects[] = {
+    {.name = "gr", .update_accelerations = rebx_gr, .prepare = rebx_gr_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "central_force", .update_accelerations = rebx_central_force, .force_type = REBX_FORCE_POS},
+    {.name = "modify_orbits_forces", .update_accelerations = rebx_modify_orbits_forces, .prepare = rebx_modify_orbits_forces_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "gas_damping_timescale", .update_accelerations = rebx_gas_damping_timescale, .prepare = rebx_gas_damping_timescale_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "exponential_migration", .update_accelerations = rebx_exponential_migration, .prepare = rebx_exponential_migration_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "gr_full", .update_accelerations = rebx_gr_full, .prepare = rebx_gr_full_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "gravitational_harmonics", .update_accelerations = rebx_gravitational_harmonics, .force_type = REBX_FORCE_POS},
+    {.name = "gr_potential", .update_accelerations = rebx_gr_potential, .prepare = rebx_gr_potential_prepare, .force_type = REBX_FORCE_POS},
+    {.name = "radiation_forces", .update_accelerations = rebx_radiation_forces, .prepare = rebx_radiation_forces_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "stochastic_forces", .update_accelerations = rebx_stochastic_forces, .prepare = rebx_stochastic_forces_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "tides_constant_time_lag", .update_accelerations = rebx_tides_constant_time_lag, .force_type = REBX_FORCE_VEL},
+    {.name = "type_I_migration", .update_accelerations = rebx_modify_orbits_with_type_I_migration, .prepare = rebx_type_I_migration_prepare, .force_type = REBX_FORCE_VEL},
+    {.name = "tides_spin", .update_accelerations = rebx_tides_spin, .force_type = REBX_FORCE_VEL},
+    {.name = "yarkovsky_effect", .update_accelerations = rebx_yarkovsky_effect, .force_type = REBX_FORCE_VEL},
+    {.name = "gas_dynamical_friction", .update_accelerations = rebx_gas_dynamical_friction, .force_type = REBX_FORCE_VEL},
+    {.name = "lense_thirring", .update_accelerations = rebx_lense_thirring, .force_type = REBX_FORCE_VEL},
+    {.name = "modify_mass", .step_function = rebx_modify_mass, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "integrate_force", .step_function = rebx_integrate_force, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "drift", .step_function = rebx_drift_step, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "kick", .step_function = rebx_kick_step, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "kepler", .step_function = rebx_kepler_step, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "jump", .step_function = rebx_jump_step, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "interaction", .step_function = rebx_interaction_step, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "ias15", .step_function = rebx_ias15_step, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "modify_orbits_direct", .step_function = rebx_modify_orbits_direct, .operator_type = REBX_OPERATOR_UPDATER},
+    {.name = "track_min_distance", .step_function = rebx_track_min_distance, .operator_type = REBX_OPERATOR_RECORDER},
+};
+// **BUILTINEFFECTS** Everything up to the END line is generated by scripts/builtin_tables.py
+#define REBX_N_BUILTIN_EFFECTS 26
+#define REBX_BUILTIN_EFFECT_N_BUCKETS 8
+#define REBX_BUILTIN_EFFECT_N_SLOTS 64
+static const uint16_t rebx_builtin_effect_seeds[REBX_BUILTIN_EFFECT_N_BUCKETS] = {
+    1, 4, 1, 1, 1, 3, 3, 1,
+};
+static const int16_t rebx_builtin_effect_slots[REBX_BUILTIN_EFFECT_N_SLOTS] = {
+    -1, 15, -1, 5, -1, -1, -1, -1, -1, 10, -1, -1, -1, 7, 21, -1,
+    4, 14, 19, 17, -1, 3, -1, 2, -1, 13, -1, 16, 9, 11, -1, -1,
+    -1, -1, 24, -1, 22, 1, -1, -1, -1, -1, 25, 23, -1, -1, -1, -1,
+    -1, 0, 12, -1, -1, 6, -1, -1, -1, -1, 8, 20, -1, -1, -1, 18,
+};
+// **BUILTINEFFECTS END**
+
+// Fails to compile if the table was edited without rerunning scripts/builtin_tables.py
+typedef char rebx_builtin_effects_need_regenerating[(sizeof(rebx_builtin_effects)/sizeof(rebx_builtin_effects[0]) == REBX_N_BUILTIN_EFFECTS) ? 1 : -1];
+
+static const struct rebx_effect_descriptor* rebx_get_builtin_effect(const char* const name){
+    const uint32_t bucket = rebx_builtin_hash(name, 0) % REBX_BUILTIN_EFFECT_N_BUCKETS;
+    const uint32_t slot = rebx_builtin_hash(name, rebx_builtin_effect_seeds[bucket]) % REBX_BUILTIN_EFFECT_N_SLOTS;
+    const int index = rebx_builtin_effect_slots[slot];
+    if (index >= 0 && strcmp(rebx_builtin_effects[index].name, name) == 0){
+        return &rebx_builtin_effects[index];
     }
-    else if (strcmp(name, "modify_orbits_forces") == 0){
-        force->update_accelerations = rebx_modify_orbits_forces;
-        force->force_type = REBX_FORCE_VEL;
-    }
-    else if (strcmp(name, "gas_damping_timescale") == 0){
-        force->update_accelerations = rebx_gas_damping_timescale;
-        force->force_type = REBX_FORCE_VEL;
-    }
-    else if (strcmp(name, "exponential_migration") == 0){
-        force->update_accelerations = rebx_exponential_migration;
-        force->force_type = REBX_FORCE_VEL;
-    }
-    else if (strcmp(name, "gr_full") == 0){
-        force->update_accelerations = rebx_gr_full;
-        force->force_type = REBX_FORCE_VEL;
-    }
-    else if (strcmp(name, "gravitational_harmonics") == 0){
-        force->update_accelerations = rebx_gravitational_harmonics;
-        force->force_type = REBX_FORCE_POS;
-    }
-    else if (strcmp(name, "gr_potential") == 0){
-        force->update_accelerations = rebx_gr_potential;
-        force->force_type = REBX_FORCE_POS;
+    return NULL;
+}
+
+// Effects registered at runtime, shared by all rebx_extras instances. Searched newest first, so later registrations override.
+// Not locked: registering must not overlap with loading effects on other threads (see rebx_register_effect).
+static const struct rebx_effect_descriptor** rebx_registered_effects = NULL;
+static int rebx_N_registered_effects = 0;
+
+int rebx_register_effect(const struct rebx_effect_descriptor* const descriptor){
+    if (descriptor == NULL || descriptor->name == NULL){
+        fprintf(stderr, "REBOUNDx Error: Passed NULL descriptor or name to rebx_register_effect.\n");
+        return 0;
     }
-    else if (strcmp(name, "radiation_forces") == 0){
-        force->update_accelerations = rebx_radiation_forces;
-        force->force_type = REBX_FORCE_VEL;
+    const int is_force = (descriptor->update_accelerations != NULL);
+    const int is_operator = (descriptor->step_function != NULL);
+    if (is_force == is_operator){
+        fprintf(stderr, "REBOUNDx Error: Effect '%s' passed to rebx_register_effect must set exactly one of update_accelerations and step_function.\n", descriptor->name);
+        return 0;
     }
-    else if (strcmp(name, "stochastic_forces") == 0){
-        force->update_accelerations = rebx_stochastic_forces;
-        force->force_type = REBX_FORCE_VEL;
+    if ((is_force && descriptor->force_type == REBX_FORCE_NONE) || (is_operator && descriptor->operator_type == REBX_OPERATOR_NONE)){
+        fprintf(stderr, "REBOUNDx Error: Effect '%s' passed to rebx_register_effect must set its force_type or operator_type.\n", descriptor->name);
+        return 0;
     }
-    else if (strcmp(name, "tides_constant_time_lag") == 0){
-        force->update_accelerations = rebx_tides_constant_time_lag;
-        force->force_type = REBX_FORCE_VEL;
+    const struct rebx_effect_descriptor** effects = realloc(rebx_registered_effects, (rebx_N_registered_effects+1)*sizeof(*effects));
+    if (effects == NULL){
+        fprintf(stderr, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
     }
-    else if (strcmp(name, "type_I_migration") == 0){
-        force->update_accelerations = rebx_modify_orbits_with_type_I_migration;
-        force->force_type = REBX_FORCE_VEL;
+    effects[rebx_N_registered_effects] = descriptor;
+    rebx_registered_effects = effects;
+    rebx_N_registered_effects++;
+    return 1;
+}
+
+const struct rebx_effect_descriptor* rebx_get_effect_descriptor(const char* const name){
+    for (int i=rebx_N_registered_effects-1; i>=0; i--){
+        if (strcmp(rebx_registered_effects[i]->name, name) == 0){
+            return rebx_registered_effects[i];
+        }
     }
-    else if (strcmp(name, "tides_spin") == 0){
-        force->update_accelerations = rebx_tides_spin;
-        force->force_type = REBX_FORCE_VEL;
+    return rebx_get_builtin_effect(name);
+}
+
+int rebx_load_plugin(const char* const filename){
+#ifdef _WIN32
+    fprintf(stderr, "REBOUNDx Error: Loading plugins is not supported on Windows.\n");
+    return 0;
+#else
+    // Plugins stay loaded, since registered descriptors point into them
+    void* handle = dlopen(filename, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL){
+        fprintf(stderr, "REBOUNDx Error: Could not load plugin '%s': %s\n", filename, dlerror());
+        return 0;
     }
-    else if (strcmp(name, "yarkovsky_effect") == 0){
-        force->update_accelerations = rebx_yarkovsky_effect;
-        force->force_type = REBX_FORCE_VEL;
+    const struct rebx_effect_descriptor* (*plugin_effects)(int* N_effects);
+    *(void**)(&plugin_effects) = dlsym(handle, "rebx_plugin_effects");
+    if (plugin_effects == NULL){
+        fprintf(stderr, "REBOUNDx Error: Plugin '%s' does not define rebx_plugin_effects.\n", filename);
+        dlclose(handle);
+        return 0;
     }
-    else if (strcmp(name, "gas_dynamical_friction") == 0){
-        force->update_accelerations = rebx_gas_dynamical_friction;
-        force->force_type = REBX_FORCE_VEL;
+    int N_effects = 0;
+    const struct rebx_effect_descriptor* effects = plugin_effects(&N_effects);
+    for (int i=0; i<N_effects; i++){
+        if (!rebx_register_effect(&effects[i])){
+            return 0;
+        }
     }
-    else if (strcmp(name, "lense_thirring") == 0){
-        force->update_accelerations = rebx_lense_thirring;
-        force->force_type = REBX_FORCE_VEL;
+    return 1;
+#endif
+}
+
+// Registers the params an effect declares in its descriptor, unless the instance already knows them
+static int rebx_register_effect_params(struct rebx_extras* const rebx, const struct rebx_effect_descriptor* const descriptor){
+    for (int i=0; i<descriptor->N_params; i++){
+        const struct rebx_param_schema* const schema = &descriptor->params[i];
+        const enum rebx_param_type type = rebx_get_type(rebx, schema->name);
+        if (type == REBX_TYPE_NONE){
+            rebx_register_param(rebx, schema->name, schema->type);
+        }
+        else if (type != schema->type){
+            char str[300];
+            sprintf(str, "REBOUNDx Error: Parameter '%s' of effect '%s' is already registered with a different type.\n", schema->name, descriptor->name);
+            rebx_error(rebx, str);
+            return 0;
+        }
     }
-    else{
+    return 1;
+}
+
+struct rebx_force* rebx_load_force(struct rebx_extras* const rebx, const char* name){
+    const struct rebx_effect_descriptor* const descriptor = rebx_get_effect_descriptor(name);
+    if (descriptor == NULL || descriptor->update_accelerations == NULL){
         char str[300];
         sprintf(str, "REBOUNDx error: Force '%s' not found in REBOUNDx library.\n", name);
         rebx_error(rebx, str);
-        rebx_remove_force(rebx, force); // Not free_force. Must remove from allocated_forces
         return NULL;
     }
+    if (!rebx_register_effect_params(rebx, descriptor)){
+        return NULL;
+    }
+    struct rebx_force* force = rebx_create_force(rebx, name);
+    if (force == NULL){
+        return NULL;
+    }
+    force->update_accelerations = descriptor->update_accelerations;
+    force->prepare = descriptor->prepare;
+    force->force_type = descriptor->force_type;
+    if (descriptor->free_arrays != NULL){
+        rebx_set_param_pointer(rebx, &force->ap, "free_arrays", descriptor->free_arrays);
+    }
 
     return force;
 }
@@ -364,7 +646,7 @@ struct rebx_operator* rebx_create_operator(struct rebx_extras* const rebx, const
         rebx_error(rebx, ""); // rebx_error gives meaningful err
         return NULL;
     }
-    struct rebx_operator* operator = rebx_malloc(rebx, sizeof(*operator));
+    struct rebx_operator* operator = rebx_arena_malloc(rebx, sizeof(*operator));
     if (operator == NULL){
         return NULL;
     }
@@ -372,22 +654,21 @@ struct rebx_operator* rebx_create_operator(struct rebx_extras* const rebx, const
     operator->sim = rebx->sim;
     operator->operator_type = REBX_OPERATOR_NONE;
     operator->step_function = NULL;
+    operator->workspace = NULL;
+    operator->workspace_size = 0;
     operator->name = NULL;
     if(name != NULL){
-        operator->name = rebx_malloc(rebx, strlen(name) + 1); // +1 for \0 at end
+        operator->name = rebx_arena_strdup(rebx, name);
         if (operator->name == NULL){
-            rebx_free_operator(operator);
+            rebx_free_operator(rebx, operator);
             return NULL;
         }
-        else{
-            strcpy(operator->name, name);
-        }
     }
 
     // Add operator to allocated_operators list for later freeing
     struct rebx_node* node = rebx_create_node(rebx);
     if (node == NULL){
-        rebx_free_operator(operator);
+        rebx_free_operator(rebx, operator);
         return NULL;
     }
     node->object = operator;
@@ -397,57 +678,22 @@ struct rebx_operator* rebx_create_operator(struct rebx_extras* const rebx, const
 }
 
 struct rebx_operator* rebx_load_operator(struct rebx_extras* const rebx, const char* name){
-    struct rebx_operator* operator = rebx_create_operator(rebx, name);
-    if (operator == NULL){
-        return NULL;
-    }
-    if (strcmp(name, "modify_mass") == 0){
-        operator->step_function = rebx_modify_mass;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "integrate_force") == 0){
-        operator->step_function = rebx_integrate_force;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "drift") == 0){
-        operator->step_function = rebx_drift_step;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "kick") == 0){
-        operator->step_function = rebx_kick_step;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "kepler") == 0){
-        operator->step_function = rebx_kepler_step;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "jump") == 0){
-        operator->step_function = rebx_jump_step;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "interaction") == 0){
-        operator->step_function = rebx_interaction_step;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "ias15") == 0){
-        operator->step_function = rebx_ias15_step;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "modify_orbits_direct") == 0){
-        operator->step_function = rebx_modify_orbits_direct;
-        operator->operator_type = REBX_OPERATOR_UPDATER;
-    }
-    else if (strcmp(name, "track_min_distance") == 0){
-        operator->step_function = rebx_track_min_distance;
-        operator->operator_type = REBX_OPERATOR_RECORDER;
-    }
-    else{
+    const struct rebx_effect_descriptor* const descriptor = rebx_get_effect_descriptor(name);
+    if (descriptor == NULL || descriptor->step_function == NULL){
         char str[300];
         sprintf(str, "REBOUNDx error: Operator '%s' not found in REBOUNDx library.\n", name);
         rebx_error(rebx, str);
-        rebx_remove_operator(rebx, operator); // Not free_op. Must rm from allocated_forces
         return NULL;
     }
+    if (!rebx_register_effect_params(rebx, descriptor)){
+        return NULL;
+    }
+    struct rebx_operator* operator = rebx_create_operator(rebx, name);
+    if (operator == NULL){
+        return NULL;
+    }
+    operator->step_function = descriptor->step_function;
+    operator->operator_type = descriptor->operator_type;
     return operator;
 }
 
@@ -510,7 +756,7 @@ int rebx_add_operator_step(struct rebx_extras* rebx, struct rebx_operator* opera
         return 0;
     }
 
-    struct rebx_step* step = rebx_malloc(rebx, sizeof(*step));
+    struct rebx_step* step = rebx_arena_malloc(rebx, sizeof(*step));
     if(step == NULL){
         return 0;
     }
@@ -594,101 +840,99 @@ int rebx_add_operator(struct rebx_extras* rebx, struct rebx_operator* operator){
  User interface for setting parameter values
  *****************************************************************/
 
-// Gets parameter if it already exists, otherwise creates a new one and adds it to the passed linked list
-struct rebx_param* rebx_get_or_add_param(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name){
+// Marks the plan of the force owning apptr for rebuilding. Plans only see particle params through the param versions they depend on (see rebx_get_force_plan), so nothing to do for those.
+static void rebx_invalidate_plans(struct rebx_extras* const rebx, struct rebx_node** apptr){
+    for (struct rebx_node* current = rebx->allocated_forces; current != NULL; current = current->next){
+        struct rebx_force* force = current->object;
+        if (apptr == &force->ap){
+            force->plan_N = -1;
+            return;
+        }
+    }
+}
+
+// Gets the node holding the parameter if it already exists, otherwise creates a new one and adds it to the passed linked list
+struct rebx_node* rebx_get_or_add_param(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name){
     if (apptr == NULL){
-        rebx_error(rebx, "REBOUNDx Error: Passed NULL apptr to rebx_add_param. See examples.\n");
+        rebx_error(rebx, "REBOUNDx Error: Passed NULL apptr to rebx_set_param. See examples.\n");
+        return NULL;
+    }
+
+    const int id = rebx_get_param_id(rebx, param_name);
+    if (id < 0){
+        char str[300];
+        sprintf(str, "REBOUNDx Error: Need to register parameter name '%s' before using it. See examples.\n", param_name);
+        rebx_error(rebx, str);
         return NULL;
     }
 
     // Check whether it already exists in linked list
-    struct rebx_param* param = rebx_get_param_struct(rebx, *apptr, param_name);
+    struct rebx_node* node = rebx_get_param_node_by_id(*apptr, id);
 
-    if(param == NULL){
-        enum rebx_param_type type = rebx_get_type(rebx, param_name);
-        if (type == REBX_TYPE_NONE){
-            char str[300];
-            sprintf(str, "REBOUNDx Error: Need to register parameter name '%s' before using it. See examples.\n", param_name);
-            rebx_error(rebx, str);
-            return NULL;
-        }
-        param = rebx_create_param(rebx, param_name, type);
-        if (param == NULL){ // adding new param failed
-            return NULL;
-        }
-        int success = rebx_add_param(rebx, apptr, param);
-        if(!success){
-            rebx_free_param(param);
+    if(node == NULL){
+        node = rebx_create_param_node(rebx, id);
+        if (node == NULL){ // adding new param failed
             return NULL;
         }
+        rebx_add_param_node(rebx, apptr, node);
     }
-    return param;
+    rebx->param_versions[id]++; // caller is about to write the value, so invalidate any cached column or plan
+    rebx_invalidate_plans(rebx, apptr);
+    return node;
 }
 
 void rebx_set_param_pointer(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, void* val){
-    struct rebx_param* param = rebx_get_or_add_param(rebx, apptr, param_name);
-    if (param == NULL){
+    struct rebx_node* node = rebx_get_or_add_param(rebx, apptr, param_name);
+    if (node == NULL){
         return;
     }
-    param->value = val;
+    *(void**)rebx_param_node_storage(node) = val;
     return;
 }
 
 void rebx_set_param_double(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, double val){
-    struct rebx_param* param = rebx_get_or_add_param(rebx, apptr, param_name);
-    if (param == NULL){
+    struct rebx_node* node = rebx_get_or_add_param(rebx, apptr, param_name);
+    if (node == NULL){
         return;
     }
-    if (param->value == NULL){ // new parameter, allocate
-        param->value = rebx_malloc(rebx, sizeof(double));
-    }
-    // Update new or existing param value
-    double* valptr = param->value;
+    // Value is stored inline in the param's block (see rebx_create_param_node)
+    double* valptr = rebx_param_node_storage(node);
     *valptr = val;
 
     return;
 }
 
 void rebx_set_param_int(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, int val){
-    struct rebx_param* param = rebx_get_or_add_param(rebx, apptr, param_name);
-    if (param == NULL){
+    struct rebx_node* node = rebx_get_or_add_param(rebx, apptr, param_name);
+    if (node == NULL){
         return;
     }
-    if (param->value == NULL){ // new parameter, allocate
-        param->value = rebx_malloc(rebx, sizeof(int));
-    }
-    // Update new or existing param value
-    int* valptr = param->value;
+    // Value is stored inline in the param's block (see rebx_create_param_node)
+    int* valptr = rebx_param_node_storage(node);
     *valptr = val;
 
     return;
 }
 
 void rebx_set_param_uint32(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, uint32_t val){
-    struct rebx_param* param = rebx_get_or_add_param(rebx, apptr, param_name);
-    if (param == NULL){
+    struct rebx_node* node = rebx_get_or_add_param(rebx, apptr, param_name);
+    if (node == NULL){
         return;
     }
-    if (param->value == NULL){ // new parameter, allocate
-        param->value = rebx_malloc(rebx, sizeof(uint32_t));
-    }
-    // Update new or existing param value
-    uint32_t* valptr = param->value;
+    // Value is stored inline in the param's block (see rebx_create_param_node)
+    uint32_t* valptr = rebx_param_node_storage(node);
     *valptr = val;
 
     return;
 }
 
 void rebx_set_param_vec3d(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, struct reb_vec3d val){
-    struct rebx_param* param = rebx_get_or_add_param(rebx, apptr, param_name);
-    if (param == NULL){
+    struct rebx_node* node = rebx_get_or_add_param(rebx, apptr, param_name);
+    if (node == NULL){
         return;
     }
-    if (param->value == NULL){ // new parameter, allocate
-        param->value = rebx_malloc(rebx, sizeof(struct reb_vec3d));
-    }
-    // Update new or existing param value
-    struct reb_vec3d* valptr = param->value;
+    // Value is stored inline in the param's block (see rebx_create_param_node)
+    struct reb_vec3d* valptr = rebx_param_node_storage(node);
     valptr->x = val.x;
     valptr->y = val.y;
     valptr->z = val.z;
@@ -700,29 +944,299 @@ void rebx_set_param_vec3d(struct rebx_extras* const rebx, struct rebx_node** app
  User interface for getting REBOUNDx objects and parameters
  *******************************************************************/
 
-struct rebx_param* rebx_get_param_struct(struct rebx_extras* const rebx, struct rebx_node* ap, const char* const param_name){
+int rebx_get_param_id(struct rebx_extras* const rebx, const char* const param_name){
+    const int builtin_id = rebx_get_builtin_param_id(param_name);
+    if (builtin_id >= 0){
+        return builtin_id;
+    }
+    if (rebx->registered_param_hash == NULL){
+        return -1;
+    }
+    const int mask = rebx->registered_param_hash_size - 1;
+    int slot = reb_hash(param_name) & mask;
+    while (rebx->registered_param_hash[slot] != -1){
+        const int id = rebx->registered_param_hash[slot];
+        if (strcmp(rebx_get_registered_param(rebx, id)->name, param_name) == 0){
+            return id;
+        }
+        slot = (slot+1) & mask;
+    }
+    return -1;
+}
+
+struct rebx_node* rebx_get_param_node_by_id(struct rebx_node* ap, const int id){
     struct rebx_node* current = ap;
     while(current != NULL){
-        struct rebx_param* param = current->object;
-        if(strcmp(param->name, param_name) == 0){
-            return param;
+        const struct rebx_param* param = current->object;
+        if(param->id >= id){ // lists are sorted by id, so can stop at first id that is not smaller
+            if(param->id == id){
+                return current;
+            }
+            return NULL;
         }
         current = current->next;
     }
 
-    return NULL;   // name not found. Don't want warnings for optional parameters so don't reb_simulation_error
+    return NULL;   // id not found. Don't want warnings for optional parameters so don't reb_simulation_error
 }
 
-void* rebx_get_param(struct rebx_extras* const rebx, struct rebx_node* ap, const char* const param_name){
-    struct rebx_param* param = rebx_get_param_struct(rebx, ap, param_name);
-    if (param == NULL){
+const struct rebx_param* rebx_get_param_struct_by_id(struct rebx_extras* const rebx, struct rebx_node* ap, const int id){
+    struct rebx_node* node = rebx_get_param_node_by_id(ap, id);
+    if (node == NULL){
+        return NULL;
+    }
+    return node->object;
+}
+
+void* rebx_get_param_by_id(struct rebx_extras* const rebx, struct rebx_node* ap, const int id){
+    struct rebx_node* node = rebx_get_param_node_by_id(ap, id);
+    if (node == NULL){
         return NULL;
     }
     else{
-        return param->value;
+        return rebx_param_node_value(node);
     }
 }
 
+// Records that the plan of the force being prepared depends on the particle params with this id
+static void rebx_add_plan_param(struct rebx_extras* const rebx, const int id){
+    struct rebx_force* const force = rebx->preparing_force;
+    if (force == NULL){
+        return;
+    }
+    for (int k=0; k<force->N_plan_param_ids; k++){
+        if (force->plan_param_ids[k] == id){
+            return;
+        }
+    }
+    if (force->N_plan_param_ids == force->N_allocated_plan_param_ids){
+        const int N_allocated = force->N_allocated_plan_param_ids ? 2*force->N_allocated_plan_param_ids : 4;
+        int* ids = realloc(force->plan_param_ids, N_allocated*sizeof(*ids));
+        if (ids == NULL){
+            rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+            return;
+        }
+        force->plan_param_ids = ids;
+        force->N_allocated_plan_param_ids = N_allocated;
+    }
+    force->plan_param_ids[force->N_plan_param_ids++] = id;
+}
+
+// Versions only ever increase, so the sum changes whenever one of the plan's params is added or set, or (if it has any) particle params are freed
+static unsigned long rebx_plan_version(const struct rebx_extras* const rebx, const struct rebx_force* const force){
+    if (force->N_plan_param_ids == 0){
+        return 0;
+    }
+    unsigned long version = rebx->param_layout_version;
+    for (int k=0; k<force->N_plan_param_ids; k++){
+        version += rebx->param_versions[force->plan_param_ids[k]];
+    }
+    return version;
+}
+
+void* rebx_get_force_plan(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_extras* const rebx = sim->extras;
+    if (force->plan_N == N && force->plan_version == rebx_plan_version(rebx, force)){
+        return force->plan;
+    }
+    if (force->prepare == NULL){
+        return NULL;
+    }
+    force->plan_N = -1;
+    force->N_plan_param_ids = 0;
+    struct rebx_force* const preparing_force = rebx->preparing_force;
+    rebx->preparing_force = force;
+    const int prepared = force->prepare(sim, force, particles, N);
+    rebx->preparing_force = preparing_force;
+    if (!prepared){
+        return NULL;
+    }
+    force->plan_N = N;
+    force->plan_version = rebx_plan_version(rebx, force);
+    return force->plan;
+}
+
+void* rebx_get_force_workspace(struct reb_simulation* const sim, struct rebx_force* const force, const size_t size){
+    if (size > force->workspace_size){
+        free(force->workspace); // contents don't need to be preserved, so avoid realloc's copy
+        force->workspace = malloc(size);
+        if (force->workspace == NULL){
+            force->workspace_size = 0;
+            reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+            return NULL;
+        }
+        force->workspace_size = size;
+    }
+    return force->workspace;
+}
+
+void* rebx_get_operator_workspace(struct reb_simulation* const sim, struct rebx_operator* const operator, const size_t size){
+    if (size > operator->workspace_size){
+        free(operator->workspace);
+        operator->workspace = malloc(size);
+        if (operator->workspace == NULL){
+            operator->workspace_size = 0;
+            reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+            return NULL;
+        }
+        operator->workspace_size = size;
+    }
+    return operator->workspace;
+}
+
+// Returns 1 if column still matches the params of the passed particles, 0 if it needs to be rebuilt
+static int rebx_param_column_is_current(struct rebx_extras* const rebx, const struct rebx_param_column* const column, struct reb_particle* const particles, const int N){
+    if (column->N != N || column->version != rebx->param_versions[column->id] || column->layout_version != rebx->param_layout_version){
+        return 0;
+    }
+    for (int i=0; i<N; i++){
+        if (column->aps[i] != particles[i].ap){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+struct rebx_param_column* rebx_get_param_column(struct rebx_extras* const rebx, const int id, struct reb_particle* const particles, const int N){
+    if (id < 0 || id >= rebx->N_registered_params){
+        rebx_error(rebx, "REBOUNDx Error: Invalid parameter id passed to rebx_get_param_column.\n");
+        return NULL;
+    }
+    if (rebx_get_registered_param(rebx, id)->type != REBX_TYPE_DOUBLE){
+        char str[300];
+        sprintf(str, "REBOUNDx Error: rebx_get_param_column only supports parameters of type double. '%s' is not.\n", rebx_get_registered_param(rebx, id)->name);
+        rebx_error(rebx, str);
+        return NULL;
+    }
+    rebx_add_plan_param(rebx, id);
+
+    struct rebx_param_column* column = rebx->param_columns[id];
+    if (column == NULL){
+        column = rebx_malloc(rebx, sizeof(*column));
+        if (column == NULL){
+            return NULL;
+        }
+        column->id = id;
+        column->N = -1;
+        column->N_allocated = 0;
+        column->N_set = 0;
+        column->values = NULL;
+        column->aps = NULL;
+        rebx->param_columns[id] = column;
+    }
+    else if (rebx_param_column_is_current(rebx, column, particles, N)){
+        return column;
+    }
+
+    if (N > column->N_allocated){
+        double** values = realloc(column->values, N*sizeof(*values));
+        void** aps = realloc(column->aps, N*sizeof(*aps));
+        if (values) column->values = values;
+        if (aps) column->aps = aps;
+        if (values == NULL || aps == NULL){
+            column->N = -1;
+            rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+            return NULL;
+        }
+        column->N_allocated = N;
+    }
+
+    column->N_set = 0;
+    for (int i=0; i<N; i++){
+        // Pointers stay valid until the params are freed, which bumps param_layout_version
+        column->values[i] = rebx_get_param_by_id(rebx, particles[i].ap, id);
+        column->aps[i] = particles[i].ap;
+        column->N_set += (column->values[i] != NULL);
+    }
+    column->N = N;
+    column->version = rebx->param_versions[id];
+    column->layout_version = rebx->param_layout_version;
+    return column;
+}
+
+// Only the listed particles need checking: adding the param to another particle bumps its version, and reordering moves a listed particle away from its index
+static int rebx_role_list_is_current(struct rebx_extras* const rebx, const struct rebx_role_list* const list, struct reb_particle* const particles, const int N){
+    if (list->N != N || list->version != rebx->param_versions[list->id] || list->layout_version != rebx->param_layout_version){
+        return 0;
+    }
+    for (int k=0; k<list->N_roles; k++){
+        if (list->aps[k] != particles[list->indices[k]].ap){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+const struct rebx_role_list* rebx_get_role_particles(struct rebx_extras* const rebx, const int id, struct reb_particle* const particles, const int N){
+    if (id < 0 || id >= rebx->N_registered_params){
+        rebx_error(rebx, "REBOUNDx Error: Invalid parameter id passed to rebx_get_role_particles.\n");
+        return NULL;
+    }
+    rebx_add_plan_param(rebx, id);
+
+    struct rebx_role_list* list = rebx->role_lists[id];
+    if (list == NULL){
+        list = rebx_malloc(rebx, sizeof(*list));
+        if (list == NULL){
+            return NULL;
+        }
+        list->id = id;
+        list->N = -1;
+        list->N_allocated = 0;
+        list->N_roles = 0;
+        list->indices = NULL;
+        list->aps = NULL;
+        rebx->role_lists[id] = list;
+    }
+    else if (rebx_role_list_is_current(rebx, list, particles, N)){
+        return list;
+    }
+
+    list->N = -1;
+    list->N_roles = 0;
+    for (int i=0; i<N; i++){
+        if (rebx_get_param_node_by_id(particles[i].ap, id) == NULL){
+            continue;
+        }
+        if (list->N_roles == list->N_allocated){
+            const int N_allocated = list->N_allocated ? 2*list->N_allocated : 4;
+            int* indices = realloc(list->indices, N_allocated*sizeof(*indices));
+            void** aps = realloc(list->aps, N_allocated*sizeof(*aps));
+            if (indices) list->indices = indices;
+            if (aps) list->aps = aps;
+            if (indices == NULL || aps == NULL){
+                list->N_roles = 0;
+                rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+                return NULL;
+            }
+            list->N_allocated = N_allocated;
+        }
+        list->indices[list->N_roles] = i;
+        list->aps[list->N_roles] = particles[i].ap;
+        list->N_roles++;
+    }
+    list->N = N;
+    list->version = rebx->param_versions[id];
+    list->layout_version = rebx->param_layout_version;
+    return list;
+}
+
+const struct rebx_param* rebx_get_param_struct(struct rebx_extras* const rebx, struct rebx_node* ap, const char* const param_name){
+    const int id = rebx_get_param_id(rebx, param_name);
+    if (id < 0){
+        return NULL;
+    }
+    return rebx_get_param_struct_by_id(rebx, ap, id);
+}
+
+void* rebx_get_param(struct rebx_extras* const rebx, struct rebx_node* ap, const char* const param_name){
+    const int id = rebx_get_param_id(rebx, param_name);
+    if (id < 0){
+        return NULL;
+    }
+    return rebx_get_param_by_id(rebx, ap, id);
+}
+
 struct rebx_force* rebx_get_force(struct rebx_extras* const rebx, const char* const name){
     struct rebx_node* current = rebx->allocated_forces;
     while(current != NULL){
@@ -754,19 +1268,19 @@ struct rebx_operator* rebx_get_operator(struct rebx_extras* const rebx, const ch
  *******************************************************************/
 
 int rebx_remove_force(struct rebx_extras* rebx, struct rebx_force* force){
-    int allocated = rebx_remove_node(&rebx->allocated_forces, force);
+    int allocated = rebx_remove_node(rebx, &rebx->allocated_forces, force);
     if(allocated){
         rebx_free_force(rebx, force);
     }
     // success only cares about removal from add_forces that affects sim
-    int success = rebx_remove_node(&rebx->additional_forces, force);
+    int success = rebx_remove_node(rebx, &rebx->additional_forces, force);
     return success;
 }
 
 // Remove all steps in head pointer that have the passed operator in them.
 // Success = 1 if at least one removed. Need separate logic since operator
 // is nested inside step
-static int rebx_remove_step_node(struct rebx_node** head, struct rebx_operator* operator){
+static int rebx_remove_step_node(struct rebx_extras* rebx, struct rebx_node** head, struct rebx_operator* operator){
     if (*head == NULL){
         return 0;
     }
@@ -775,8 +1289,8 @@ static int rebx_remove_step_node(struct rebx_node** head, struct rebx_operator*
     struct rebx_step* step = current->object;
     if(step->operator == operator){ // edge case where step is first in list
         *head = current->next;
-        rebx_free_step(step);
-        free(current);
+        rebx_free_step(rebx, step);
+        rebx_arena_free(rebx, current, sizeof(*current));
         return 1;
     }
 
@@ -786,8 +1300,8 @@ static int rebx_remove_step_node(struct rebx_node** head, struct rebx_operator*
         step = current->object;
         if(step->operator == operator){
             prev->next = current->next;
-            rebx_free_step(step);
-            free(current);
+            rebx_free_step(rebx, step);
+            rebx_arena_free(rebx, current, sizeof(*current));
             return 1;
         }
         prev = current;
@@ -797,9 +1311,9 @@ static int rebx_remove_step_node(struct rebx_node** head, struct rebx_operator*
 }
 
 int rebx_remove_operator(struct rebx_extras* rebx, struct rebx_operator* operator){
-    int allocated = rebx_remove_node(&rebx->allocated_operators, operator);
+    int allocated = rebx_remove_node(rebx, &rebx->allocated_operators, operator);
     if(allocated){
-        rebx_free_operator(operator);
+        rebx_free_operator(rebx, operator);
 
     }
 
@@ -808,7 +1322,7 @@ int rebx_remove_operator(struct rebx_extras* rebx, struct rebx_operator* operato
     int success = 0;
     int keep_searching = 1;
     while(keep_searching){ // keep searching while steps are found
-        keep_searching = rebx_remove_step_node(&rebx->pre_timestep_modifications, operator);
+        keep_searching = rebx_remove_step_node(rebx, &rebx->pre_timestep_modifications, operator);
         if (keep_searching == 1){ // success if at least one step found
             success = 1;
         }
@@ -816,7 +1330,7 @@ int rebx_remove_operator(struct rebx_extras* rebx, struct rebx_operator* operato
 
     keep_searching = 1;
     while(keep_searching){ // keep searching while steps are found
-        keep_searching = rebx_remove_step_node(&rebx->post_timestep_modifications, operator);
+        keep_searching = rebx_remove_step_node(rebx, &rebx->post_timestep_modifications, operator);
         if (keep_searching == 1){ // success if at least one step found
             success = 1;
         }
@@ -839,32 +1353,34 @@ void* rebx_malloc(struct rebx_extras* const rebx, size_t memsize){
     return ptr;
 }
 
+// Frees a standalone param (e.g. one read from a binary) that owns its name and value. Params in ap lists are freed with their node.
 void rebx_free_param(struct rebx_param* param){
-    if(param->name){
-        free(param->name);
-    }
-    // Don't free pointers to structs
-    if(param->type == REBX_TYPE_INT || param->type == REBX_TYPE_DOUBLE){
-        if(param->value){
-            free(param->value);
-        }
-    }
+    free(param->name);
+    free(param->value);
     free(param);
 }
 
-void rebx_free_ap(struct rebx_node** ap){
+static size_t rebx_param_block_size(struct rebx_extras* rebx, enum rebx_param_type type);
+
+void rebx_free_ap(struct rebx_extras* rebx, struct rebx_node** ap){
     struct rebx_node* current = *ap;
     struct rebx_node* next;
     while (current != NULL){
         next = current->next;
-        rebx_free_param(current->object);
-        free(current);
+        const struct rebx_param* param = current->object;
+        rebx_arena_free(rebx, current, rebx_param_block_size(rebx, param->type)); // node and value are one block (see rebx_create_param_node)
         current = next;
     }
+    *ap = NULL;
 }
 
 void rebx_free_particle_ap(struct reb_particle* p){
-    rebx_free_ap((struct rebx_node **)(&p->ap));
+    if (p->ap == NULL || p->sim == NULL || p->sim->extras == NULL){
+        return; // without extras there's no arena to return the params to. Their memory is released with it.
+    }
+    struct rebx_extras* rebx = p->sim->extras;
+    rebx->param_layout_version++; // freed nodes can be reused by other particles, so cached columns can't trust ap pointers
+    rebx_free_ap(rebx, (struct rebx_node **)(&p->ap));
 }
 
 void rebx_free_force(struct rebx_extras* rebx, struct rebx_force* force){
@@ -872,87 +1388,115 @@ void rebx_free_force(struct rebx_extras* rebx, struct rebx_force* force){
     if (free_arrays){
         free_arrays(rebx, force);
     }
-    if(force->name){
-        free(force->name);
-    }
-    rebx_free_ap(&force->ap);
-    free(force);
+    rebx_arena_free_string(rebx, force->name);
+    free(force->plan);
+    free(force->plan_param_ids);
+    free(force->workspace);
+    rebx_free_ap(rebx, &force->ap);
+    rebx_arena_free(rebx, force, sizeof(*force));
 }
 
-void rebx_free_operator(struct rebx_operator* operator){
-    if(operator->name){
-        free(operator->name);
-    }
-    rebx_free_ap(&operator->ap);
-    free(operator);
+void rebx_free_operator(struct rebx_extras* rebx, struct rebx_operator* operator){
+    rebx_arena_free_string(rebx, operator->name);
+    free(operator->workspace);
+    rebx_free_ap(rebx, &operator->ap);
+    rebx_arena_free(rebx, operator, sizeof(*operator));
 }
 
-void rebx_free_step(struct rebx_step* step){
-    free(step);
+void rebx_free_step(struct rebx_extras* rebx, struct rebx_step* step){
+    rebx_arena_free(rebx, step, sizeof(*step));
 }
 
-void rebx_free_reg_param(struct rebx_param* param){
-    if(param->name){
-        free(param->name);
+void rebx_free_param_column(struct rebx_param_column* column){
+    if (column == NULL){
+        return;
     }
-    free(param);
+    free(column->values);
+    free(column->aps);
+    free(column);
 }
 
-void rebx_free_pointers(struct rebx_extras* rebx){
-    if (rebx == NULL){
+void rebx_free_role_list(struct rebx_role_list* list){
+    if (list == NULL){
         return;
     }
-    rebx_detach(rebx->sim, rebx);
-    struct rebx_node* current;
-    struct rebx_node* next;
-
-    current = rebx->allocated_forces;
-    while (current != NULL){
-        next = current->next;
-        rebx_free_force(rebx, current->object);
-        free(current);
-        current = next;
-    }
+    free(list->indices);
+    free(list->aps);
+    free(list);
+}
 
-    current = rebx->allocated_operators;
-    while (current != NULL){
-        next = current->next;
-        rebx_free_operator(current->object);
-        free(current);
-        current = next;
-    }
+void rebx_free_reg_param(struct rebx_extras* rebx, struct rebx_param* param){
+    rebx_arena_free_string(rebx, param->name);
+    rebx_arena_free(rebx, param, sizeof(*param));
+}
 
-    current = rebx->additional_forces;
-    while (current != NULL){
-        next = current->next;
-        free(current);
-        current = next;
+void rebx_free_pointers(struct rebx_extras* rebx){
+    if (rebx == NULL){
+        return;
     }
-
-
-    current = rebx->pre_timestep_modifications;
-    while (current != NULL){
-        next = current->next;
-        rebx_free_step(current->object);
-        free(current);
-        current = next;
+    struct reb_simulation* const sim = rebx->sim;
+    if (sim != NULL && sim->extras == rebx){
+        // Particle params live in the arena released below, so don't leave the particles pointing into it
+        for (int i=0; i<sim->N; i++){
+            sim->particles[i].ap = NULL;
+        }
     }
+    rebx_detach(sim, rebx);
 
-    current = rebx->post_timestep_modifications;
-    while (current != NULL){
-        next = current->next;
-        rebx_free_step(current->object);
-        free(current);
-        current = next;
+    // Nodes, params, operators and steps all live in the arena. Only the plans, plan param ids and workspaces of forces and operators are separate allocations.
+    for (struct rebx_node* current = rebx->allocated_forces; current != NULL; current = current->next){
+        struct rebx_force* force = current->object;
+        void (*free_arrays)(struct rebx_extras* rebx, struct rebx_force* force) = rebx_get_param(rebx, force->ap, "free_arrays");
+        if (free_arrays){
+            free_arrays(rebx, force);
+        }
+        free(force->plan);
+        free(force->plan_param_ids);
+        free(force->workspace);
     }
-
-    current = rebx->registered_params;
-    while (current != NULL){
-        next = current->next;
-        rebx_free_reg_param(current->object);
-        free(current);
-        current = next;
+    for (struct rebx_node* current = rebx->allocated_operators; current != NULL; current = current->next){
+        struct rebx_operator* operator = current->object;
+        free(operator->workspace);
     }
+    rebx->allocated_forces = NULL;
+    rebx->allocated_operators = NULL;
+    rebx->additional_forces = NULL;
+    rebx->pre_timestep_modifications = NULL;
+    rebx->post_timestep_modifications = NULL;
+    rebx->registered_params = NULL;
+
+    for (int id=0; id<rebx->N_registered_params; id++){
+        rebx_free_param_column(rebx->param_columns[id]);
+        rebx_free_role_list(rebx->role_lists[id]);
+    }
+    free(rebx->param_columns);
+    free(rebx->role_lists);
+    rebx_disable_orbit_cache(rebx);
+    if (rebx->gravity_snapshot != NULL){
+        free(rebx->gravity_snapshot->ax);
+        free(rebx->gravity_snapshot->ay);
+        free(rebx->gravity_snapshot->az);
+        free(rebx->gravity_snapshot);
+        rebx->gravity_snapshot = NULL;
+    }
+    rebx_free_jacobi_frame(rebx->jacobi_frame);
+    rebx->jacobi_frame = NULL;
+    rebx_disable_async_output(rebx);
+    rebx_free_archive_state(rebx->archive_state);
+    rebx->archive_state = NULL;
+    free(rebx->param_versions);
+    free(rebx->registered_param_table);
+    free(rebx->registered_param_hash);
+    rebx->param_columns = NULL;
+    rebx->role_lists = NULL;
+    rebx->param_versions = NULL;
+    rebx->registered_param_table = NULL;
+    rebx->registered_param_hash = NULL;
+    rebx->N_registered_params = 0;
+    rebx->N_allocated_registered_params = 0;
+    rebx->registered_param_hash_size = 0;
+
+    rebx_arena_release(&rebx->arena);
 }
 
 /**********************************************
@@ -967,9 +1511,112 @@ void rebx_reset_accelerations(struct reb_particle* const ps, const int N){
     }
 }
 
+// Returns 1 if any force in the simulation has gr_reuse_gravity set
+static int rebx_gravity_snapshot_requested(struct rebx_extras* const rebx){
+    const int id = rebx_get_param_id(rebx, "gr_reuse_gravity");
+    for (struct rebx_node* current = rebx->additional_forces; current != NULL; current = current->next){
+        const struct rebx_force* const force = current->object;
+        const int* const reuse_gravity = rebx_get_param_by_id(rebx, force->ap, id);
+        if (reuse_gravity != NULL && *reuse_gravity){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Adds the interaction between particles i and j that REBOUND's gravity routine skipped because of sim->gravity_ignore_terms
+static void rebx_gravity_snapshot_add_pair(const struct reb_simulation* const sim, struct rebx_gravity_snapshot* const snapshot, const int i, const int j, const int N_active){
+    const struct reb_particle pi = sim->particles[i];
+    const struct reb_particle pj = sim->particles[j];
+    const double dx = pi.x - pj.x;
+    const double dy = pi.y - pj.y;
+    const double dz = pi.z - pj.z;
+    const double r = sqrt(dx*dx + dy*dy + dz*dz + sim->softening*sim->softening);
+    const double prefac = sim->G/(r*r*r);
+    // Like in REBOUND, test particles (beyond N_active) only pull on massive ones with testparticle_type 1
+    if (j < N_active || sim->testparticle_type){
+        snapshot->ax[i] -= prefac*pj.m*dx;
+        snapshot->ay[i] -= prefac*pj.m*dy;
+        snapshot->az[i] -= prefac*pj.m*dz;
+    }
+    if (i < N_active || sim->testparticle_type){
+        snapshot->ax[j] += prefac*pi.m*dx;
+        snapshot->ay[j] += prefac*pi.m*dy;
+        snapshot->az[j] += prefac*pi.m*dz;
+    }
+}
+
+// Copies the accelerations REBOUND's gravity routine left in the particles, before any REBOUNDx force adds to them
+static void rebx_take_gravity_snapshot(struct rebx_extras* const rebx){
+    struct reb_simulation* const sim = rebx->sim;
+    const int newtonian = (sim->gravity == REB_GRAVITY_BASIC || sim->gravity == REB_GRAVITY_COMPENSATED || sim->gravity == REB_GRAVITY_TREE);
+    if (!newtonian || !rebx_gravity_snapshot_requested(rebx)){
+        return;
+    }
+    struct rebx_gravity_snapshot* snapshot = rebx->gravity_snapshot;
+    if (snapshot == NULL){
+        snapshot = rebx_malloc(rebx, sizeof(*snapshot));
+        if (snapshot == NULL){
+            return;
+        }
+        snapshot->N = 0;
+        snapshot->N_allocated = 0;
+        snapshot->valid = 0;
+        snapshot->ax = NULL;
+        snapshot->ay = NULL;
+        snapshot->az = NULL;
+        rebx->gravity_snapshot = snapshot;
+    }
+    const int N = sim->N - sim->N_var;
+    if (N > snapshot->N_allocated){
+        double* ax = realloc(snapshot->ax, N*sizeof(*ax));
+        double* ay = realloc(snapshot->ay, N*sizeof(*ay));
+        double* az = realloc(snapshot->az, N*sizeof(*az));
+        if (ax) snapshot->ax = ax;
+        if (ay) snapshot->ay = ay;
+        if (az) snapshot->az = az;
+        if (ax == NULL || ay == NULL || az == NULL){
+            rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+            return;
+        }
+        snapshot->N_allocated = N;
+    }
+    const struct reb_particle* const particles = sim->particles;
+    for (int i=0; i<N; i++){
+        snapshot->ax[i] = particles[i].ax;
+        snapshot->ay[i] = particles[i].ay;
+        snapshot->az[i] = particles[i].az;
+    }
+    const int N_active = (sim->N_active == -1) ? N : sim->N_active;
+    if (sim->gravity_ignore_terms == 1 && N > 1){
+        rebx_gravity_snapshot_add_pair(sim, snapshot, 0, 1, N_active);
+    }
+    else if (sim->gravity_ignore_terms == 2){
+        for (int j=1; j<N; j++){
+            rebx_gravity_snapshot_add_pair(sim, snapshot, 0, j, N_active);
+        }
+    }
+    snapshot->N = N;
+    snapshot->valid = 1;
+}
+
+const struct rebx_gravity_snapshot* rebx_get_gravity_snapshot(struct rebx_extras* const rebx, const struct reb_particle* const particles, const int N){
+    const struct rebx_gravity_snapshot* const snapshot = rebx->gravity_snapshot;
+    if (snapshot == NULL || !snapshot->valid || rebx->sim == NULL || particles != rebx->sim->particles || N != snapshot->N){
+        return NULL;
+    }
+    return snapshot;
+}
+
 void rebx_additional_forces(struct reb_simulation* sim){
     struct rebx_extras* rebx = sim->extras;
     struct rebx_node* current = rebx->additional_forces;
+    rebx_invalidate_orbit_cache(rebx); // particles have moved since the last evaluation
+    rebx_take_gravity_snapshot(rebx);
+    if (rebx->jacobi_frame != NULL){
+        rebx->jacobi_frame->computed = 0;
+    }
+    rebx->evaluating_forces = 1; // particles don't move until the loop finishes, so shared Jacobi quantities stay valid
     while(current != NULL){
         /*if(sim->force_is_velocity_dependent && sim->integrator==REB_INTEGRATOR_WHFAST){
          reb_simulation_warning(sim, "REBOUNDx: Passing a velocity-dependent force to WHFAST. Need to apply as an operator.");
@@ -979,6 +1626,10 @@ void rebx_additional_forces(struct reb_simulation* sim){
         force->update_accelerations(sim, force, sim->particles, N);
         current = current->next;
     }
+    rebx->evaluating_forces = 0;
+    if (rebx->gravity_snapshot != NULL){
+        rebx->gravity_snapshot->valid = 0; // forces called from elsewhere (e.g. integrate_force) have to calculate gravity themselves
+    }
 }
 
 void rebx_pre_timestep_modifications(struct reb_simulation* sim){
@@ -992,6 +1643,7 @@ void rebx_pre_timestep_modifications(struct reb_simulation* sim){
         if(sim->integrator==REB_INTEGRATOR_IAS15 && sim->ri_ias15.epsilon != 0 && operator->operator_type == REBX_OPERATOR_UPDATER){
             reb_simulation_warning(sim, "REBOUNDx: Operators that affect particle trajectories with adaptive timesteps can give spurious results. Use sim.ri_ias15.epsilon=0 for fixed timestep with IAS, or use a different integrator.");
         }
+        rebx_invalidate_orbit_cache(rebx); // previous operators may have moved the particles
         operator->step_function(sim, operator, dt*step->dt_fraction);
         current = current->next;
     }
@@ -1008,6 +1660,7 @@ void rebx_post_timestep_modifications(struct reb_simulation* sim){
         if(sim->integrator==REB_INTEGRATOR_IAS15 && sim->ri_ias15.epsilon != 0 && operator->operator_type == REBX_OPERATOR_UPDATER){
             reb_simulation_warning(sim, "REBOUNDx: Operators that affect particle trajectories with adaptive timesteps can give spurious results. Use sim.ri_ias15.epsilon=0 for fixed timestep with IAS, or use a different integrator.");
         }
+        rebx_invalidate_orbit_cache(rebx); // previous operators may have moved the particles
         operator->step_function(sim, operator, dt*step->dt_fraction);
         current = current->next;
     }
@@ -1018,7 +1671,7 @@ void rebx_post_timestep_modifications(struct reb_simulation* sim){
  ****************************************************************/
 
 struct rebx_node* rebx_create_node(struct rebx_extras* rebx){
-    struct rebx_node* node = rebx_malloc(rebx, sizeof(*node));
+    struct rebx_node* node = rebx_arena_malloc(rebx, sizeof(*node));
     if (node == NULL){
         return NULL;
     }
@@ -1029,41 +1682,90 @@ struct rebx_node* rebx_create_node(struct rebx_extras* rebx){
 
 struct rebx_param* rebx_create_param(struct rebx_extras* rebx, const char* name, enum rebx_param_type type){
     // Allocate and initialize new param struct
-    struct rebx_param* param = rebx_malloc(rebx, sizeof(*param));
+    struct rebx_param* param = rebx_arena_malloc(rebx, sizeof(*param));
     if (param == NULL){
         return NULL;
     }
     param->type = type;
+    param->id = rebx_get_param_id(rebx, name); // -1 if name is being registered
     param->value = NULL;
-    param->name = rebx_malloc(rebx, strlen(name) + 1); // +1 for \0 at end
+    param->name = rebx_arena_strdup(rebx, name);
     if (param->name == NULL){
+        rebx_arena_free(rebx, param, sizeof(*param));
         return NULL;
     }
-    else{
-        strcpy(param->name, name);
-    }
 
     return param;
 }
 
-int rebx_add_param(struct rebx_extras* const rebx, struct rebx_node** apptr, struct rebx_param* param){
-    struct rebx_node* node = rebx_create_node(rebx);
-    if (node == NULL){
-        return 0;
+/*
+ A param in an ap list is one block: the list node followed by the value. The node's object is the registered param, which holds the name,
+ type and id shared by every particle or effect carrying that param, so a double param costs 24 bytes rather than a node, a rebx_param and a
+ value. Params are not packed further into one block per particle: ap lists are public linked lists of rebx_nodes (struct rebx_node** is
+ part of the rebx_set_param_* API and particles carry a single ap pointer), and adding a param would then have to reallocate the whole block
+ and move every pointer to its values that effects, force plans and param columns hold.
+*/
+struct rebx_param_block{
+    struct rebx_node node;
+    union{
+        void* pointer;          // pointer-like types point to memory owned elsewhere
+        double value[1];        // other types are stored here (double aligned), possibly running past the end of the struct
+    } storage;
+};
+
+// Types whose param value is a pointer the user passed to rebx_set_param_pointer
+static int rebx_param_is_pointer(const enum rebx_param_type type){
+    return type == REBX_TYPE_POINTER || type == REBX_TYPE_FORCE || type == REBX_TYPE_ORBIT || type == REBX_TYPE_ODE;
+}
+
+static size_t rebx_param_block_size(struct rebx_extras* rebx, enum rebx_param_type type){
+    const size_t value_size = rebx_param_is_pointer(type) ? 0 : rebx_sizeof(rebx, type);
+    return value_size > sizeof(((struct rebx_param_block*)0)->storage) ? offsetof(struct rebx_param_block, storage) + value_size : sizeof(struct rebx_param_block);
+}
+
+void* rebx_param_node_storage(const struct rebx_node* node){
+    return &((struct rebx_param_block*)node)->storage;
+}
+
+void* rebx_param_node_value(const struct rebx_node* node){
+    struct rebx_param_block* const block = (struct rebx_param_block*)node;
+    const struct rebx_param* const param = node->object;
+    return rebx_param_is_pointer(param->type) ? block->storage.pointer : block->storage.value;
+}
+
+struct rebx_node* rebx_create_param_node(struct rebx_extras* rebx, const int id){
+    const struct rebx_param* const reg_param = rebx_get_registered_param(rebx, id);
+    const size_t size = rebx_param_block_size(rebx, reg_param->type);
+    struct rebx_param_block* block = rebx_arena_malloc(rebx, size);
+    if (block == NULL){
+        return NULL;
     }
-    node->object = param;
-    rebx_add_node(apptr, node);
-    return 1;
+    memset(&block->storage, 0, size - offsetof(struct rebx_param_block, storage));
+    block->node.object = (void*)reg_param; // only ever read through (see rebx_get_param_struct_by_id)
+    block->node.next = NULL;
+    return &block->node;
+}
+
+void rebx_add_param_node(struct rebx_extras* const rebx, struct rebx_node** apptr, struct rebx_node* node){
+    const struct rebx_param* const param = node->object;
+
+    // Insert so that list stays sorted by id (see rebx_get_param_node_by_id)
+    struct rebx_node** current = apptr;
+    while (*current != NULL && ((struct rebx_param*)(*current)->object)->id < param->id){
+        current = &(*current)->next;
+    }
+    rebx_add_node(current, node);
+    rebx->param_versions[param->id]++;
 }
 
 // needed from Python
 enum rebx_param_type rebx_get_type(struct rebx_extras* rebx, const char* name){
-    struct rebx_param* param = rebx_get_param_struct(rebx, rebx->registered_params, name);
+    const int id = rebx_get_param_id(rebx, name);
 
-    if (param == NULL){ // param not found
+    if (id < 0){ // param not found
         return REBX_TYPE_NONE;
     }
-    return param->type;
+    return rebx_get_registered_param(rebx, id)->type;
 }
 
 size_t rebx_sizeof(struct rebx_extras* rebx, enum rebx_param_type type){
@@ -1076,6 +1778,10 @@ size_t rebx_sizeof(struct rebx_extras* rebx, enum rebx_param_type type){
         {
             return sizeof(int);
         }
+        case REBX_TYPE_UINT32:
+        {
+            return sizeof(uint32_t);
+        }
         case REBX_TYPE_FORCE:
         {
             return sizeof(struct rebx_force);
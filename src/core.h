@@ -28,6 +28,9 @@
 
 struct rebx_extras;
 struct rebx_param;
+struct rebx_param_column;
+struct rebx_role_list;
+struct rebx_jacobi_frame;
 enum rebx_param_type;
 struct rebx_step;
 struct rebx_node;
@@ -43,7 +46,6 @@ struct rebx_node;
  ****************************/
 
 void rebx_initialize(struct reb_simulation* sim, struct rebx_extras* rebx); // Initializes all pointers and values.
-void rebx_register_default_params(struct rebx_extras* rebx); // Registers default params
 void rebx_init_interpolator(struct rebx_extras* const rebx, struct rebx_interpolator* const interp, const int Nvalues, const double* times, const double* values, enum rebx_interpolation_type interpolation);
 
 /**********************************************
@@ -61,6 +63,23 @@ void rebx_post_timestep_modifications(struct reb_simulation* sim);  // Calls all
 size_t rebx_sizeof(struct rebx_extras* rebx, enum rebx_param_type type); // Returns size in bytes of the corresponding rebx_param_type type
 void rebx_reset_accelerations(struct reb_particle* const ps, const int N);
 
+/****************************************
+Binary input/output building blocks (see input.c, output.c and archive.c)
+*****************************************/
+void rebx_init_extras_from_stream(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings);
+void rebx_init_extras_from_snapshot(struct rebx_extras* rebx, const char* const data, const size_t size, const long offset, enum rebx_input_binary_messages* warnings); // loads the snapshot at offset bytes into a binary held in memory
+int rebx_output_snapshot_stream(struct rebx_extras* rebx, FILE* of); // writes a snapshot without the file header
+
+// Binary file held in memory, memory mapped where possible
+struct rebx_binary_file{
+    const char* data;
+    size_t size;
+    int mapped;     // whether data is a mapping or a malloc'd copy
+};
+int rebx_open_binary_file(const char* const filename, struct rebx_binary_file* const file, enum rebx_input_binary_messages* warnings);
+void rebx_close_binary_file(struct rebx_binary_file* const file);
+void rebx_input_process_warnings(struct reb_simulation* const sim, enum rebx_input_binary_messages warnings);
+
 /****************************************
 Force prototypes
 *****************************************/
@@ -80,6 +99,19 @@ void rebx_tides_spin(struct reb_simulation* const sim, struct rebx_force* const
 void rebx_yarkovsky_effect(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
 void rebx_gas_dynamical_friction(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
 void rebx_lense_thirring(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+/****************************************
+Force plan prototypes (see rebx_get_force_plan)
+*****************************************/
+int rebx_gr_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_gr_full_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_gr_potential_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_radiation_forces_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_stochastic_forces_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_modify_orbits_forces_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_gas_damping_timescale_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_exponential_migration_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+int rebx_type_I_migration_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+
 /****************************************
  Operator prototypes
  *****************************************/
@@ -98,19 +130,40 @@ void rebx_integrator_rk4_integrate(struct reb_simulation* const sim, const doubl
 void rebx_integrator_implicit_midpoint_integrate(struct reb_simulation* const sim, const double dt, struct rebx_force* const force);
 
 void* rebx_malloc(struct rebx_extras* const rebx, size_t memsize);
-void rebx_free_ap(struct rebx_node** ap);
+
+// Arena (see arena.c). Sizes passed to the free functions must match the ones allocated.
+void rebx_arena_init(struct rebx_arena* const arena);
+void* rebx_arena_malloc(struct rebx_extras* const rebx, const size_t memsize);
+void rebx_arena_free(struct rebx_extras* const rebx, void* const ptr, const size_t memsize);
+char* rebx_arena_strdup(struct rebx_extras* const rebx, const char* const str);
+void rebx_arena_free_string(struct rebx_extras* const rebx, char* const str);
+void rebx_arena_release(struct rebx_arena* const arena); // Frees all chunks and large objects at once
+
+void rebx_free_ap(struct rebx_extras* rebx, struct rebx_node** ap);
 void rebx_free_particle_ap(struct reb_particle* p);
 void rebx_free_force(struct rebx_extras* rebx, struct rebx_force* force);
-void rebx_free_operator(struct rebx_operator* operator);
-void rebx_free_step(struct rebx_step* step);
+void rebx_free_operator(struct rebx_extras* rebx, struct rebx_operator* operator);
+void rebx_free_step(struct rebx_extras* rebx, struct rebx_step* step);
 void rebx_free_pointers(struct rebx_extras* rebx);
 void rebx_free_param(struct rebx_param* param);
+void rebx_free_reg_param(struct rebx_extras* rebx, struct rebx_param* param);
+void rebx_free_param_column(struct rebx_param_column* column);
+void rebx_free_role_list(struct rebx_role_list* list);
+void rebx_free_jacobi_frame(struct rebx_jacobi_frame* const frame);
+void rebx_free_archive_state(struct rebx_archive_state* const state);
 void rebx_free_interpolator_pointers(struct rebx_interpolator* const interpolator);
 
 enum rebx_param_type rebx_get_type(struct rebx_extras* rebx, const char* name);
 
 struct rebx_param* rebx_create_param(struct rebx_extras* rebx, const char* name, enum rebx_param_type type);
-int rebx_add_param(struct rebx_extras* const rebx, struct rebx_node** apptr, struct rebx_param* param);
+int rebx_add_registered_param(struct rebx_extras* const rebx, struct rebx_param* param); // Assigns param the next id and adds it to the registry
+const struct rebx_param* rebx_get_registered_param(struct rebx_extras* const rebx, const int id); // Built-in (see rebx_builtin_params) or user registered param with passed id
+const struct rebx_effect_descriptor* rebx_get_effect_descriptor(const char* const name); // Registered or built-in effect with passed name, or NULL
+struct rebx_node* rebx_create_param_node(struct rebx_extras* rebx, const int id); // Single allocation holding the node and value for registered param id. node->object is the registered param.
+struct rebx_node* rebx_get_param_node_by_id(struct rebx_node* ap, const int id); // Node of the param with passed id in ap list. NULL if not found.
+void* rebx_param_node_storage(const struct rebx_node* node); // Where the param's value (or for pointer types the pointer) is stored
+void* rebx_param_node_value(const struct rebx_node* node); // Same as rebx_get_param returns: the pointer for pointer types, else rebx_param_node_storage
+void rebx_add_param_node(struct rebx_extras* const rebx, struct rebx_node** apptr, struct rebx_node* node); // Inserts into ap list keeping it sorted by id
 struct rebx_node* rebx_create_node(struct rebx_extras* rebx);
 
 #endif
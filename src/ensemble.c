@@ -0,0 +1,189 @@
+/**
+ * @file    ensemble.c
+ * @brief   Copying REBOUNDx simulations and running ensembles of them in parallel.
+ * @author  Dan Tamayo <tamayo.daniel@gmail.com>
+ *
+ * @section LICENSE
+ * Copyright (c) 2015 Dan Tamayo, Hanno Rein
+ *
+ * This file is part of reboundx.
+ *
+ * reboundx is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * reboundx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rebound.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "rebound.h"
+#include "reboundx.h"
+#include "core.h"
+
+struct reb_simulation* rebx_copy_simulation(struct reb_simulation* const sim){
+    if (sim == NULL){
+        fprintf(stderr, "REBOUNDx Error: Simulation pointer passed to rebx_copy_simulation was NULL.\n");
+        return NULL;
+    }
+    struct rebx_extras* const rebx = sim->extras;
+    if (rebx == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: rebx_copy_simulation requires REBOUNDx to be attached to the simulation.\n");
+        return NULL;
+    }
+
+    // Serialize the extras through the binary format, so the copy goes through the same code path as saving and loading
+    size_t size;
+    char* const binary = rebx_output_binary_buffer(rebx, &size);
+    if (binary == NULL){
+        return NULL;
+    }
+
+    struct reb_simulation* const copy = reb_simulation_copy(sim);
+    if (copy == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: REBOUND could not copy the simulation in rebx_copy_simulation.\n");
+        free(binary);
+        return NULL;
+    }
+    // Nothing in the copy may point back into the original's REBOUNDx structures
+    copy->extras = NULL;
+    copy->additional_forces = NULL;
+    copy->pre_timestep_modifications = NULL;
+    copy->post_timestep_modifications = NULL;
+    copy->free_particle_ap = NULL;
+    copy->extras_cleanup = NULL;
+    for (int i=0; i<copy->N; i++){
+        copy->particles[i].ap = NULL;
+    }
+
+    enum rebx_input_binary_messages warnings = REBX_INPUT_BINARY_WARNING_NONE;
+    // create manually so that default registered parameters not loaded (as in rebx_create_extras_from_binary)
+    struct rebx_extras* const rebx_copy = malloc(sizeof(*rebx_copy));
+    if (rebx_copy == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+        reb_simulation_free(copy);
+        free(binary);
+        return NULL;
+    }
+    rebx_initialize(copy, rebx_copy);
+    rebx_init_extras_from_buffer(rebx_copy, binary, size, &warnings);
+    rebx_input_process_warnings(copy, warnings);
+    free(binary);
+
+    return copy;
+}
+
+static void rebx_free_copy(struct reb_simulation* const sim){
+    struct rebx_extras* const rebx = sim->extras;
+    reb_simulation_free(sim);   // frees particle params through rebx while it is still attached
+    rebx_free(rebx);
+}
+
+struct rebx_ensemble* rebx_create_ensemble(struct reb_simulation* const sim, const int N_members){
+    if (sim == NULL){
+        fprintf(stderr, "REBOUNDx Error: Simulation pointer passed to rebx_create_ensemble was NULL.\n");
+        return NULL;
+    }
+    if (N_members < 1){
+        reb_simulation_error(sim, "REBOUNDx Error: rebx_create_ensemble needs at least one member.\n");
+        return NULL;
+    }
+    struct rebx_ensemble* const ensemble = malloc(sizeof(*ensemble));
+    if (ensemble == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+        return NULL;
+    }
+    ensemble->N_members = 0;
+    ensemble->sims = malloc(N_members*sizeof(*ensemble->sims));
+    ensemble->status = calloc(N_members, sizeof(*ensemble->status));
+    if (ensemble->sims == NULL || ensemble->status == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+        rebx_free_ensemble(ensemble);
+        return NULL;
+    }
+
+    for (int m=0; m<N_members; m++){
+        struct reb_simulation* const copy = rebx_copy_simulation(sim);
+        if (copy == NULL){
+            rebx_free_ensemble(ensemble);
+            return NULL;
+        }
+        copy->rand_seed = sim->rand_seed ^ (2654435761u*(unsigned int)(m+1)); // Knuth's multiplicative hash spreads consecutive members apart
+        ensemble->sims[m] = copy;
+        ensemble->N_members++;
+    }
+    return ensemble;
+}
+
+void rebx_free_ensemble(struct rebx_ensemble* const ensemble){
+    if (ensemble == NULL){
+        return;
+    }
+    for (int m=0; m<ensemble->N_members; m++){
+        rebx_free_copy(ensemble->sims[m]);
+    }
+    free(ensemble->sims);
+    free(ensemble->status);
+    free(ensemble);
+}
+
+int rebx_ensemble_set_particle_param_double(struct rebx_ensemble* const ensemble, const int particle_index, const char* const param_name, const double* const values){
+    for (int m=0; m<ensemble->N_members; m++){
+        struct reb_simulation* const sim = ensemble->sims[m];
+        if (particle_index < 0 || particle_index >= sim->N){
+            char str[300];
+            sprintf(str, "REBOUNDx Error: Particle index %d passed to rebx_ensemble_set_particle_param_double is out of range.\n", particle_index);
+            reb_simulation_error(sim, str);
+            return 0;
+        }
+        struct rebx_node** const apptr = (struct rebx_node**)&sim->particles[particle_index].ap;
+        rebx_set_param_double(sim->extras, apptr, param_name, values[m]);
+        if (rebx_get_param(sim->extras, *apptr, param_name) == NULL){
+            return 0;   // rebx_set_param_double already raised the error
+        }
+    }
+    return 1;
+}
+
+int rebx_ensemble_integrate(struct rebx_ensemble* const ensemble, const double tmax, void (*collect)(struct reb_simulation* const sim, const int member, double* const output, const int N_outputs, void* const data), double* const outputs, const int N_outputs, void* const data){
+    const int N_members = ensemble->N_members;
+    int N_failed = 0;
+    // Members can take very different times (close encounters, ejections), so hand them out one at a time
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:N_failed)
+    for (int m=0; m<N_members; m++){
+        struct reb_simulation* const sim = ensemble->sims[m];
+        ensemble->status[m] = reb_simulation_integrate(sim, tmax);
+        if (ensemble->status[m] != REB_STATUS_SUCCESS){
+            N_failed++;
+        }
+        if (collect != NULL){
+            collect(sim, m, outputs + (size_t)m*N_outputs, N_outputs, data);
+        }
+    }
+    return N_failed;
+}
+
+void rebx_ensemble_collect_particles(struct reb_simulation* const sim, const int member, double* const output, const int N_outputs, void* const data){
+    int n = 0;
+    for (int i=0; i<sim->N && n+6<=N_outputs; i++){
+        const struct reb_particle p = sim->particles[i];
+        output[n++] = p.x;
+        output[n++] = p.y;
+        output[n++] = p.z;
+        output[n++] = p.vx;
+        output[n++] = p.vy;
+        output[n++] = p.vz;
+    }
+    for (; n<N_outputs; n++){ // particles the member lost
+        output[n] = NAN;
+    }
+}
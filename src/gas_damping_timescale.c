@@ -64,78 +64,113 @@
 #include "reboundx.h"
 #include "rebxtools.h"
 
-static struct reb_vec3d rebx_calculate_gas_damping_timescale(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* planet, struct reb_particle* star){
-    struct rebx_extras* const rebx = sim->extras;
-    struct reb_orbit o = reb_orbit_from_particle(sim->G, *planet, *star);
+struct rebx_gas_damping_timescale_plan{
+    enum REBX_COORDINATES coordinates;
+    int d_factor_id;
+    int coeffs_set;             // 1 if both cs_coeff and tau_coeff are set
+    double cs_coeff;
+    double tau_coeff;
+};
 
-    const double* const d_factor = rebx_get_param(rebx, planet->ap, "d_factor");
+int rebx_gas_damping_timescale_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_extras* const rebx = sim->extras;
+    if (force->plan == NULL){
+        force->plan = malloc(sizeof(struct rebx_gas_damping_timescale_plan));
+        if (force->plan == NULL){
+            reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+            return 0;
+        }
+    }
+    struct rebx_gas_damping_timescale_plan* const plan = force->plan;
+    const int* const ptr = rebx_get_param(rebx, force->ap, "coordinates");
+    plan->coordinates = REBX_COORDINATES_JACOBI; // Default
+    if (ptr != NULL){
+        plan->coordinates = *ptr;
+    }
+    plan->d_factor_id = rebx_get_param_id(rebx, "d_factor");
     const double* const cs_coeff = rebx_get_param(rebx, force->ap, "cs_coeff");
     const double* const tau_coeff = rebx_get_param(rebx, force->ap, "tau_coeff");
-    
-    struct reb_vec3d a = {0};
+    plan->coeffs_set = (cs_coeff != NULL && tau_coeff != NULL);
+    plan->cs_coeff = cs_coeff ? *cs_coeff : 0.;
+    plan->tau_coeff = tau_coeff ? *tau_coeff : 0.;
+    return 1;
+}
 
-    if (d_factor == NULL || cs_coeff == NULL || tau_coeff == NULL){
-        rebx_error(rebx, "Need to set d_factor, cs_coeff, tau_coeff parameters.  See examples in documentation.\n");
-        return a;
-    }
+static void rebx_calculate_gas_damping_timescale(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, struct rebx_com_batch* const batch){
+    struct rebx_extras* const rebx = sim->extras;
+    const struct rebx_gas_damping_timescale_plan* const plan = force->plan;
+    rebx_com_batch_orbits(sim, batch, REBX_ORBIT_A | REBX_ORBIT_E | REBX_ORBIT_INC);
+    // Serial, since rebx_error is not thread safe
+    for (int k=0; k<batch->N; k++){
+        struct rebx_node* const ap = particles[batch->indices[k]].ap;
+
+        const double* const d_factor = rebx_get_param_by_id(rebx, ap, plan->d_factor_id);
+        
+        batch->ax[k] = 0.;
+        batch->ay[k] = 0.;
+        batch->az[k] = 0.;
 
-    // initialize positions and velocities
-    const double dvx = planet->vx - star->vx;
-    const double dvy = planet->vy - star->vy;
-    const double dvz = planet->vz - star->vz;
-    const double dx = planet->x-star->x;
-    const double dy = planet->y-star->y;
-    const double dz = planet->z-star->z;
-    const double r2 = dx*dx + dy*dy + dz*dz;
+        if (d_factor == NULL || !plan->coeffs_set){
+            rebx_error(rebx, "Need to set d_factor, cs_coeff, tau_coeff parameters.  See examples in documentation.\n");
+            continue;
+        }
 
-    // initial semimajor axis, eccentricity, and inclination
-    const double a0 = o.a;
-    const double e0 = o.e;
-    const double inc0 = o.inc;
-    const double starMass = star->m;
-    const double planetMass = planet->m;
+        // initialize positions and velocities
+        const double dvx = batch->vx[k] - batch->source_vx[k];
+        const double dvy = batch->vy[k] - batch->source_vy[k];
+        const double dvz = batch->vz[k] - batch->source_vz[k];
+        const double dx = batch->x[k] - batch->source_x[k];
+        const double dy = batch->y[k] - batch->source_y[k];
+        const double dz = batch->z[k] - batch->source_z[k];
+        const double r2 = dx*dx + dy*dy + dz*dz;
 
-    // eccentricity and inclination timescales from Dawson+16 Eqn 16
-    double coeff;
+        // initial semimajor axis, eccentricity, and inclination
+        const double a0 = batch->a[k];
+        const double e0 = batch->e[k];
+        const double inc0 = batch->inc[k];
+        const double starMass = batch->source_m[k];
+        const double planetMass = batch->m[k];
 
-    double vk = sqrt(sim->G*starMass/a0);
-    double v = sqrt(e0*e0+inc0*inc0)*vk;
-    double cs = *cs_coeff/sqrt(sqrt(a0));
-    double v_over_cs = v/cs;
+        // eccentricity and inclination timescales from Dawson+16 Eqn 16
+        double coeff;
 
-    if (v <= cs){
-        coeff = 1.;
-    }
-    else {
-        if (inc0 < cs/vk) {
-            coeff = v_over_cs*v_over_cs*v_over_cs;
+        double vk = sqrt(sim->G*starMass/a0);
+        double v = sqrt(e0*e0+inc0*inc0)*vk;
+        double cs = plan->cs_coeff/sqrt(sqrt(a0));
+        double v_over_cs = v/cs;
+
+        if (v <= cs){
+            coeff = 1.;
         }
         else {
-            coeff = v_over_cs*v_over_cs*v_over_cs*v_over_cs;
+            if (inc0 < cs/vk) {
+                coeff = v_over_cs*v_over_cs*v_over_cs;
+            }
+            else {
+                coeff = v_over_cs*v_over_cs*v_over_cs*v_over_cs;
+            }
         }
-    }
 
-    double tau_e = -*tau_coeff*(*d_factor)*a0*a0*(starMass/planetMass)*coeff;
-    double tau_inc = 2.*tau_e;  // from Kominami & Ida 2002 [Eqs. 2.9 and 2.10]
+        double tau_e = -plan->tau_coeff*(*d_factor)*a0*a0*(starMass/planetMass)*coeff;
+        double tau_inc = 2.*tau_e;  // from Kominami & Ida 2002 [Eqs. 2.9 and 2.10]
 
 
-    if (tau_e < INFINITY || tau_inc < INFINITY){
-        const double vdotr = dx*dvx + dy*dvy + dz*dvz;
-        const double prefac = 2*vdotr/r2/tau_e;
-        a.x += prefac*dx;
-        a.y += prefac*dy;
-        a.z += prefac*dz + 2.*dvz/tau_inc;
+        if (tau_e < INFINITY || tau_inc < INFINITY){
+            const double vdotr = dx*dvx + dy*dvy + dz*dvz;
+            const double prefac = 2*vdotr/r2/tau_e;
+            batch->ax[k] += prefac*dx;
+            batch->ay[k] += prefac*dy;
+            batch->az[k] += prefac*dz + 2.*dvz/tau_inc;
+        }
     }
-    return a;
 }
 
 void rebx_gas_damping_timescale(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
-    int* ptr = rebx_get_param(sim->extras, force->ap, "coordinates");
-    enum REBX_COORDINATES coordinates = REBX_COORDINATES_JACOBI; // Default
-    if (ptr != NULL){
-        coordinates = *ptr;
+    const struct rebx_gas_damping_timescale_plan* const plan = rebx_get_force_plan(sim, force, particles, N);
+    if (plan == NULL){
+        return;
     }
     const int back_reactions_inclusive = 1;
     const char* reference_name = "primary";
-    rebx_com_force(sim, force, coordinates, back_reactions_inclusive, reference_name, rebx_calculate_gas_damping_timescale, particles, N);
+    rebx_com_force(sim, force, plan->coordinates, back_reactions_inclusive, reference_name, rebx_calculate_gas_damping_timescale, particles, N);
 }
@@ -46,6 +46,13 @@
  * Field (C type)               Required    Description
  * ============================ =========== ==================================================================
  * c (double)                   Yes         Speed of light, needs to be specified in the units used for the simulation.
+ * max_iterations (int)         No          Maximum number of iterations for the velocity fixed point (default 10).
+ * gr_tolerance (double)        No          Fractional change in velocity at which the iteration stops (default machine epsilon).
+ * gr_warm_start (int)          No          If nonzero, start each call from the previous call's solution. Usually converges in 1-2 iterations, but results then depend on the call history, so restarts are not bit-wise reproducible.
+ * gr_reuse_gravity (int)       No          If nonzero, take the Newtonian accelerations from REBOUND's gravity routine instead of an extra O(N^2) pass, so they include its softening and tree code (see rebx_get_gravity_snapshot).
+ * gr_iterations (int)          No          Set by the effect: most iterations any particle needed in the last call.
+ * gr_max_residual (double)     No          Set by the effect: largest final fractional change in velocity in the last call.
+ * gr_nonconverged (int)        No          Set by the effect: number of calls in which some particle did not converge.
  * ============================ =========== ==================================================================
  *
  * 
@@ -61,53 +68,97 @@
 #include "reboundx.h"
 #include "rebxtools.h"
 
-static void rebx_calculate_gr(struct reb_simulation* const sim, struct reb_particle* const particles, const int N, const double C2, const double G, const int max_iterations){
+struct rebx_gr_plan{
+    double C2;                  // speed of light squared
+    int max_iterations;
+    double tolerance;           // fractional change in the Jacobi velocities at which the iteration stops
+    int warm_start;             // start from the previous call's velocities rather than the osculating ones
+    int reuse_gravity;          // take the Newtonian accelerations from REBOUND's gravity routine when available
+    int have_previous;          // whether v_previous holds a solution from a call with the current plan
+    int* iterations;            // telemetry params on the force, updated in place
+    double* max_residual;
+    int* nonconverged;
+    double v_previous[];        // 3*N converged Jacobi velocities from the last call (used by warm_start)
+};
+
+static void rebx_calculate_gr(struct reb_simulation* const sim, struct rebx_gr_plan* const plan, struct reb_particle* const particles, const int N, const double G, struct reb_particle* const ps, struct reb_particle* const ps_j){
     
-    struct reb_particle* const ps = malloc(N*sizeof(*ps));
-    struct reb_particle* const ps_j = malloc(N*sizeof(*ps_j));
+    const double C2 = plan->C2;
+    const int max_iterations = plan->max_iterations;
+    const double tol2 = plan->tolerance*plan->tolerance;
+    const int use_previous = plan->warm_start && plan->have_previous;
+    int iterations = 0;
+    double max_residual2 = 0.;
+    int nonconverged = 0;
     memcpy(ps, particles, N*sizeof(*ps));
     
     // Calculate Newtonian accelerations 
-    for(int i=0; i<N; i++){
-        ps[i].ax = 0.;
-        ps[i].ay = 0.;
-        ps[i].az = 0.;
+    const struct rebx_gravity_snapshot* const gravity = plan->reuse_gravity ? rebx_get_gravity_snapshot(sim->extras, particles, N) : NULL;
+    if (gravity != NULL){
+        for(int i=0; i<N; i++){
+            ps[i].ax = gravity->ax[i];
+            ps[i].ay = gravity->ay[i];
+            ps[i].az = gravity->az[i];
+        }
     }
+    else{
+        for(int i=0; i<N; i++){
+            ps[i].ax = 0.;
+            ps[i].ay = 0.;
+            ps[i].az = 0.;
+        }
 
-    for(int i=0; i<N; i++){
-        const struct reb_particle pi = ps[i];
-        for(int j=i+1; j<N; j++){
-            const struct reb_particle pj = ps[j];
-            const double dx = pi.x - pj.x;
-            const double dy = pi.y - pj.y;
-            const double dz = pi.z - pj.z;
-            const double r2 = dx*dx + dy*dy + dz*dz;
-            const double r = sqrt(r2);
-            const double prefac = G/(r2*r);
-            ps[i].ax -= prefac*pj.m*dx;
-            ps[i].ay -= prefac*pj.m*dy;
-            ps[i].az -= prefac*pj.m*dz;
-            ps[j].ax += prefac*pi.m*dx;
-            ps[j].ay += prefac*pi.m*dy;
-            ps[j].az += prefac*pi.m*dz;
+        for(int i=0; i<N; i++){
+            const struct reb_particle pi = ps[i];
+            for(int j=i+1; j<N; j++){
+                const struct reb_particle pj = ps[j];
+                const double dx = pi.x - pj.x;
+                const double dy = pi.y - pj.y;
+                const double dz = pi.z - pj.z;
+                const double r2 = dx*dx + dy*dy + dz*dz;
+                const double r = sqrt(r2);
+                const double prefac = G/(r2*r);
+                ps[i].ax -= prefac*pj.m*dx;
+                ps[i].ay -= prefac*pj.m*dy;
+                ps[i].az -= prefac*pj.m*dz;
+                ps[j].ax += prefac*pi.m*dx;
+                ps[j].ay += prefac*pi.m*dy;
+                ps[j].az += prefac*pi.m*dz;
+            }
         }
     }
    
     // Transform to Jacobi coordinates
     const struct reb_particle source = ps[0];
 	const double mu = G*source.m;
-    reb_particles_transform_inertial_to_jacobi_posvelacc(ps, ps_j, ps, N, N);
+    // ps only differs from particles in its accelerations, so the Jacobi positions and velocities can come from the shared frame
+    const struct rebx_jacobi_frame* const jacobi = rebx_get_jacobi_frame(sim, particles, N, REBX_JACOBI_POSVEL);
+    if (jacobi != NULL){
+        memcpy(ps_j, jacobi->ps_j, N*sizeof(*ps_j));
+        reb_particles_transform_inertial_to_jacobi_acc(ps, ps_j, ps, N, N);
+    }
+    else{
+        reb_particles_transform_inertial_to_jacobi_posvelacc(ps, ps_j, ps, N, N);
+    }
     
     for (int i=1; i<N; i++){
         struct reb_particle p = ps_j[i];
         struct reb_vec3d vi;
-        vi.x = p.vx;
-        vi.y = p.vy;
-        vi.z = p.vz;
+        if (use_previous){
+            vi.x = plan->v_previous[3*i];
+            vi.y = plan->v_previous[3*i+1];
+            vi.z = plan->v_previous[3*i+2];
+        }
+        else{
+            vi.x = p.vx;
+            vi.y = p.vy;
+            vi.z = p.vz;
+        }
         double vi2=vi.x*vi.x + vi.y*vi.y + vi.z*vi.z;
         const double ri = sqrt(p.x*p.x + p.y*p.y + p.z*p.z);
         int q = 0;
         double A = (0.5*vi2 + 3.*mu/ri)/C2;
+        double residual2 = 0.;
         struct reb_vec3d old_v;
         for(q=0; q<max_iterations; q++){
             old_v.x = vi.x;
@@ -121,14 +172,24 @@ static void rebx_calculate_gr(struct reb_simulation* const sim, struct reb_parti
             const double dvx = vi.x - old_v.x;
             const double dvy = vi.y - old_v.y;
             const double dvz = vi.z - old_v.z;
-            if ((dvx*dvx + dvy*dvy + dvz*dvz)/vi2 < DBL_EPSILON*DBL_EPSILON){
+            residual2 = (dvx*dvx + dvy*dvy + dvz*dvz)/vi2;
+            if (residual2 < tol2){
                 break;
             }
         }
-        const int default_max_iterations = 10;
-        if(q==default_max_iterations){
-            reb_simulation_warning(sim, "REBOUNDx Warning: 10 iterations in gr.c failed to converge. This is typically because the perturbation is too strong for the current implementation.");
+        if(q==max_iterations){
+            nonconverged = 1;
+            iterations = max_iterations;
+        }
+        else if (q+1 > iterations){
+            iterations = q+1;
         }
+        if (residual2 > max_residual2){
+            max_residual2 = residual2;
+        }
+        plan->v_previous[3*i] = vi.x;
+        plan->v_previous[3*i+1] = vi.y;
+        plan->v_previous[3*i+2] = vi.z;
   
         const double B = (mu/ri - 1.5*vi2)*mu/(ri*ri*ri)/C2;
         const double rdotrdot = p.x*p.vx + p.y*p.vy + p.z*p.vz;
@@ -145,6 +206,16 @@ static void rebx_calculate_gr(struct reb_simulation* const sim, struct reb_parti
         ps_j[i].ay = B*(1.-A)*p.y - A*p.ay - D*vi.y;
         ps_j[i].az = B*(1.-A)*p.z - A*p.az - D*vi.z;
     }
+    plan->have_previous = 1;
+
+    *plan->iterations = iterations;
+    *plan->max_residual = sqrt(max_residual2);
+    if (nonconverged){
+        *plan->nonconverged += 1;
+        char str[300];
+        sprintf(str, "REBOUNDx Warning: %d iterations in gr.c failed to converge. This is typically because the perturbation is too strong for the current implementation.", max_iterations);
+        reb_simulation_warning(sim, str);
+    }
     
     ps_j[0].ax = 0.;
     ps_j[0].ay = 0.;
@@ -156,34 +227,70 @@ static void rebx_calculate_gr(struct reb_simulation* const sim, struct reb_parti
         particles[i].ay += ps[i].ay;
         particles[i].az += ps[i].az;
     }
-    
-    free(ps);
-    free(ps_j);
 }
 
-void rebx_gr(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
-    double* c = rebx_get_param(sim->extras, force->ap, "c");
+int rebx_gr_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_extras* const rebx = sim->extras;
+    struct rebx_gr_plan* const plan = realloc(force->plan, sizeof(*plan) + 3*N*sizeof(double));
+    if (plan == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    force->plan = plan;
+    const double* const c = rebx_get_param(rebx, force->ap, "c");
     if (c == NULL){
         reb_simulation_error(sim, "REBOUNDx Error: Need to set speed of light in gr effect.  See examples in documentation.\n");
-        return;
+        return 0;
     }
-    const double C2 = (*c)*(*c);
-    int* max_iterations = rebx_get_param(sim->extras, force->ap, "max_iterations");
-    if(max_iterations != NULL){
-        rebx_calculate_gr(sim, particles, N, C2, sim->G, *max_iterations);
+    plan->C2 = (*c)*(*c);
+    const int* const max_iterations = rebx_get_param(rebx, force->ap, "max_iterations");
+    plan->max_iterations = max_iterations ? *max_iterations : 10; // default
+    const double* const tolerance = rebx_get_param(rebx, force->ap, "gr_tolerance");
+    plan->tolerance = tolerance ? *tolerance : DBL_EPSILON; // default
+    const int* const warm_start = rebx_get_param(rebx, force->ap, "gr_warm_start");
+    plan->warm_start = warm_start ? *warm_start : 0; // default
+    const int* const reuse_gravity = rebx_get_param(rebx, force->ap, "gr_reuse_gravity");
+    plan->reuse_gravity = reuse_gravity ? *reuse_gravity : 0; // default
+    plan->have_previous = 0;    // previous solution may belong to different particles or parameters
+    
+    // Telemetry is written through pointers each call, so these sets only happen the first time
+    if (rebx_get_param(rebx, force->ap, "gr_iterations") == NULL){
+        rebx_set_param_int(rebx, &force->ap, "gr_iterations", 0);
     }
-    else{
-        const int default_max_iterations = 10;
-        rebx_calculate_gr(sim, particles, N, C2, sim->G, default_max_iterations);
+    if (rebx_get_param(rebx, force->ap, "gr_max_residual") == NULL){
+        rebx_set_param_double(rebx, &force->ap, "gr_max_residual", 0.);
     }
+    if (rebx_get_param(rebx, force->ap, "gr_nonconverged") == NULL){
+        rebx_set_param_int(rebx, &force->ap, "gr_nonconverged", 0);
+    }
+    plan->iterations = rebx_get_param(rebx, force->ap, "gr_iterations");
+    plan->max_residual = rebx_get_param(rebx, force->ap, "gr_max_residual");
+    plan->nonconverged = rebx_get_param(rebx, force->ap, "gr_nonconverged");
+    return 1;
+}
+
+void rebx_gr(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_gr_plan* const plan = rebx_get_force_plan(sim, force, particles, N);
+    if (plan == NULL){
+        return;
+    }
+    // REBOUND's Jacobi transformations work on reb_particle arrays, so the scratch copies (N each) stay AoS
+    struct reb_particle* const ps = rebx_get_force_workspace(sim, force, 2*N*sizeof(*ps));
+    if (ps == NULL){
+        return;
+    }
+    rebx_calculate_gr(sim, plan, particles, N, sim->G, ps, ps + N);
 }
 
 static double rebx_calculate_gr_hamiltonian(struct rebx_extras* const rebx, struct reb_simulation* const sim, const double C2){
     const int N = sim->N - sim->N_var;
     const double G = sim->G;
 
-    struct reb_particle* const ps_j = malloc(N*sizeof(*ps_j));
     struct reb_particle* const ps = sim->particles; 
+    const struct rebx_jacobi_frame* const jacobi = rebx_get_jacobi_frame(sim, ps, N, REBX_JACOBI_POSVEL | REBX_JACOBI_MASSES);
+    if (jacobi == NULL){
+        return 0.;
+    }
     // Calculate Newtonian potentials
 
     double V_newt = 0.;
@@ -203,9 +310,8 @@ static double rebx_calculate_gr_hamiltonian(struct rebx_extras* const rebx, stru
     // Transform to Jacobi coordinates
     const struct reb_particle source = ps[0];
 	const double mu = G*source.m;
-    double* const m_j = malloc(N*sizeof(*m_j));
-    rebx_calculate_jacobi_masses(ps, m_j, N);
-    reb_particles_transform_inertial_to_jacobi_posvel(ps, ps_j, ps, N, N);
+    const struct reb_particle* const ps_j = jacobi->ps_j;
+    const double* const m_j = jacobi->m_j;
 
     double T = 0.5*m_j[0]*(ps_j[0].vx*ps_j[0].vx + ps_j[0].vy*ps_j[0].vy + ps_j[0].vz*ps_j[0].vz);
     double V_PN = 0.;
@@ -230,9 +336,6 @@ static double rebx_calculate_gr_hamiltonian(struct rebx_extras* const rebx, stru
     }
     V_PN /= C2;
     
-    free(ps_j);
-    free(m_j);
-    
 	return T + V_newt + V_PN;
 }
 
@@ -43,6 +43,13 @@
  * Field (C type)               Required    Description
  * ============================ =========== ==================================================================
  * c (double)                   Yes         Speed of light, needs to be specified in the units used for the simulation.
+ * max_iterations (int)         No          Maximum number of substitution passes for the accelerations (default 10).
+ * gr_tolerance (double)        No          Fractional change in the accelerations at which the substitution stops (default machine epsilon).
+ * gr_warm_start (int)          No          If nonzero, start each call from the previous call's accelerations. Usually converges in 1-2 passes, but results then depend on the call history, so restarts are not bit-wise reproducible.
+ * gr_reuse_gravity (int)       No          If nonzero, take the Newtonian accelerations from REBOUND's gravity routine, so they include its softening and tree code (see rebx_get_gravity_snapshot). The pairwise distances are still needed for the post-Newtonian terms.
+ * gr_iterations (int)          No          Set by the effect: substitution passes used in the last call.
+ * gr_max_residual (double)     No          Set by the effect: largest fractional change in the accelerations on the last pass.
+ * gr_nonconverged (int)        No          Set by the effect: number of calls that did not converge.
  * ============================ =========== ==================================================================
  * 
  * **Particle Parameters**
@@ -58,208 +65,302 @@
 #include "rebound.h"
 #include "reboundx.h"
 
-static void rebx_calculate_gr_full(struct reb_simulation* const sim, struct reb_particle* const particles, const int N, const double C2, const double G, const int max_iterations, const int gravity_ignore_10){
+struct rebx_gr_full_plan{
+    double C2;                  // speed of light squared
+    int max_iterations;
+    double tolerance;           // fractional change in the accelerations at which the substitution stops
+    int warm_start;             // start from the previous call's accelerations rather than the constant term
+    int reuse_gravity;          // take the Newtonian accelerations from REBOUND's gravity routine when available
+    int have_previous;          // whether a_previous holds a solution from a call with the current plan
+    int* iterations;            // telemetry params on the force, updated in place
+    double* max_residual;
+    int* nonconverged;
+    double a_previous[];        // 3*N converged barycentric PN accelerations from the last call (used by warm_start)
+};
+
+// Number of doubles rebx_calculate_gr_full needs in its workspace for N bodies
+static size_t rebx_gr_full_workspace_size(const int N){
+    return 2*(size_t)N*N + 14*(size_t)N;
+}
+
+static void rebx_calculate_gr_full(struct reb_simulation* const sim, struct rebx_gr_full_plan* const plan, struct reb_particle* const particles, const int N, const double G, const int gravity_ignore_10, double* const workspace){
+    
+    const double C2 = plan->C2;
+    const int max_iterations = plan->max_iterations;
+    const double tolerance = plan->tolerance;
     
-    double a_const[N][3]; // array that stores the value of the constant term
-    struct reb_particle* const ps_b = malloc(N*sizeof(*ps_b));
-    memcpy(ps_b, particles, N*sizeof(*ps_b));
+    // Carve the workspace into the pair tables and SoA copies of the fields the kernels use
+    double* const inv_r = workspace;            // N x N, row i contiguous
+    double* const inv_r3 = inv_r + N*N;         // N x N
+    double* const phi = inv_r3 + N*N;
+    double* const Gm = phi + N;
+    double* const x = Gm + N;
+    double* const y = x + N;
+    double* const z = y + N;
+    double* const vx = z + N;
+    double* const vy = vx + N;
+    double* const vz = vy + N;
+    double* const ax = vz + N;
+    double* const ay = ax + N;
+    double* const az = ay + N;
+    double* const ax_const = az + N;            // constant term
+    double* const ay_const = ax_const + N;
+    double* const az_const = ay_const + N;
 
-    // Calculate Newtonian accelerations 
+    const struct rebx_gravity_snapshot* const gravity = plan->reuse_gravity ? rebx_get_gravity_snapshot(sim->extras, particles, N) : NULL;
     for(int i=0; i<N; i++){
-        ps_b[i].ax = 0.;
-        ps_b[i].ay = 0.;
-        ps_b[i].az = 0.;
+        x[i] = particles[i].x;
+        y[i] = particles[i].y;
+        z[i] = particles[i].z;
+        vx[i] = particles[i].vx;
+        vy[i] = particles[i].vy;
+        vz[i] = particles[i].vz;
+        Gm[i] = G*particles[i].m;
+        ax[i] = gravity ? gravity->ax[i] : 0.;
+        ay[i] = gravity ? gravity->ay[i] : 0.;
+        az[i] = gravity ? gravity->az[i] : 0.;
+        phi[i] = 0.;
+        inv_r[i*N+i] = 0.;     // zero diagonal so that the pair kernels below need no j != i branch
+        inv_r3[i*N+i] = 0.;
     }
 
+    // Calculate Newtonian accelerations (unless taken from REBOUND's gravity routine). Cache 1/r and 1/r^3 for each pair 
+    // along with the potentials phi_i = sum_{k != i} G m_k / r_ik, so nothing below has to recompute a sqrt
     for(int i=0; i<N; i++){
-        const struct reb_particle pi = ps_b[i];
         for(int j=i+1; j<N; j++){
-            const struct reb_particle pj = ps_b[j];
-            const double dx = pi.x - pj.x;
-            const double dy = pi.y - pj.y;
-            const double dz = pi.z - pj.z;
+            const double dx = x[i] - x[j];
+            const double dy = y[i] - y[j];
+            const double dz = z[i] - z[j];
             const double r2 = dx*dx + dy*dy + dz*dz;
             const double r = sqrt(r2);
-            const double prefac = G/(r2*r);
-            ps_b[i].ax -= prefac*pj.m*dx;
-            ps_b[i].ay -= prefac*pj.m*dy;
-            ps_b[i].az -= prefac*pj.m*dz;
-            ps_b[j].ax += prefac*pi.m*dx;
-            ps_b[j].ay += prefac*pi.m*dy;
-            ps_b[j].az += prefac*pi.m*dz;
+            const double invr = 1./r;
+            const double invr3 = 1./(r2*r);
+            inv_r[i*N+j] = invr;
+            inv_r[j*N+i] = invr;
+            inv_r3[i*N+j] = invr3;
+            inv_r3[j*N+i] = invr3;
+            phi[i] += Gm[j]*invr;
+            phi[j] += Gm[i]*invr;
+            if (gravity != NULL){
+                continue;
+            }
+
+            const double prefac = G*invr3;
+            ax[i] -= prefac*particles[j].m*dx;
+            ay[i] -= prefac*particles[j].m*dy;
+            az[i] -= prefac*particles[j].m*dz;
+            ax[j] += prefac*particles[i].m*dx;
+            ay[j] += prefac*particles[i].m*dy;
+            az[j] += prefac*particles[i].m*dz;
         }
     }
 
     // Transform to barycentric coordinates
-    struct reb_particle com = reb_simulation_com(sim);
+    const struct reb_particle com = reb_simulation_com(sim);
     for (int i=0; i<N; i++){
-        reb_particle_isub(&ps_b[i], &com);
+        x[i] -= com.x;
+        y[i] -= com.y;
+        z[i] -= com.z;
+        vx[i] -= com.vx;
+        vy[i] -= com.vy;
+        vz[i] -= com.vz;    // like reb_particle_isub, which leaves accelerations alone
     }
     for (int i=0; i<N; i++){
         // then compute the constant terms:
         double a_constx = 0.;
         double a_consty = 0.;
         double a_constz = 0.;
-        // 1st constant part
+        const double* const inv_ri = &inv_r[i*N];
+        const double* const inv_r3i = &inv_r3[i*N];
+        const double a1 = (4./(C2))*phi[i];
+        const double vi2 = vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i];
+        const double a3 = -vi2/(C2);
+        // 1st constant part (j == i contributes exactly zero through the zeroed diagonal)
         for (int j = 0; j< N; j++){
-            if (j != i){
-                const double dxij = ps_b[i].x - ps_b[j].x;
-                const double dyij = ps_b[i].y - ps_b[j].y;
-                const double dzij = ps_b[i].z - ps_b[j].z;
-                const double rij2 = dxij*dxij + dyij*dyij + dzij*dzij;
-                const double rij = sqrt(rij2);
-                const double rij3 = rij2*rij;
-                
-                double a1 = 0.;
-                for (int k = 0; k< N; k++){
-                    if (k != i){
-                        const double dxik = ps_b[i].x - ps_b[k].x;
-                        const double dyik = ps_b[i].y - ps_b[k].y;
-                        const double dzik = ps_b[i].z - ps_b[k].z;
-                        const double rik = sqrt(dxik*dxik + dyik*dyik + dzik*dzik);
-                        a1 += (4./(C2)) * G*particles[k].m/rik;
-                    }
-                }
-
-                double a2 = 0.;
-                for (int l = 0; l< N; l++){
-                    if (l != j){
-                        const double dxlj = ps_b[l].x - ps_b[j].x;
-                        const double dylj = ps_b[l].y - ps_b[j].y;
-                        const double dzlj = ps_b[l].z - ps_b[j].z;
-                        const double rlj = sqrt(dxlj*dxlj + dylj*dylj + dzlj*dzlj);
-                        a2 += (1./(C2)) * G*particles[l].m/rlj;
-                    }
-                }
-
-                double a3;
-                double vi2 = ps_b[i].vx*ps_b[i].vx + ps_b[i].vy*ps_b[i].vy + ps_b[i].vz*ps_b[i].vz;
-                a3 = -vi2/(C2);
+            const double dxij = x[i] - x[j];
+            const double dyij = y[i] - y[j];
+            const double dzij = z[i] - z[j];
+            const double invrij = inv_ri[j];
+            const double invrij3 = inv_r3i[j];
+            
+            const double a2 = (1./(C2))*phi[j];
 
-                double a4;
-                double vj2 = ps_b[j].vx*ps_b[j].vx + ps_b[j].vy*ps_b[j].vy + ps_b[j].vz*ps_b[j].vz;
-                a4 = -2.*vj2/(C2);
+            const double vj2 = vx[j]*vx[j] + vy[j]*vy[j] + vz[j]*vz[j];
+            const double a4 = -2.*vj2/(C2);
 
-                double a5;
-                a5 = (4./(C2)) * (ps_b[i].vx*ps_b[j].vx + ps_b[i].vy*ps_b[j].vy + ps_b[i].vz*ps_b[j].vz); 
-                
-                double a6;
-                double a6_0 = dxij*ps_b[j].vx + dyij*ps_b[j].vy + dzij*ps_b[j].vz;
-                a6 = (3./(2.*C2)) * a6_0*a6_0/rij2;
-               
-                double a7; // Newtonian piece of first ddot(r) piece
-                a7 = (dxij*ps_b[j].ax+dyij*ps_b[j].ay+dzij*ps_b[j].az)/(2.*C2);
-                
-                double factor1 = a1 + a2 + a3 + a4 + a5 + a6 + a7;
-                 
-                a_constx += G*particles[j].m*dxij*factor1/rij3;
-                a_consty += G*particles[j].m*dyij*factor1/rij3;
-                a_constz += G*particles[j].m*dzij*factor1/rij3;
-        
-                // 2nd constant part
+            const double a5 = (4./(C2)) * (vx[i]*vx[j] + vy[i]*vy[j] + vz[i]*vz[j]); 
+            
+            const double a6_0 = dxij*vx[j] + dyij*vy[j] + dzij*vz[j];
+            const double a6 = (3./(2.*C2)) * a6_0*a6_0*invrij*invrij;
+           
+            const double a7 = (dxij*ax[j]+dyij*ay[j]+dzij*az[j])/(2.*C2); // Newtonian piece of first ddot(r) piece
+            
+            const double factor1 = a1 + a2 + a3 + a4 + a5 + a6 + a7;
+             
+            a_constx += Gm[j]*dxij*factor1*invrij3;
+            a_consty += Gm[j]*dyij*factor1*invrij3;
+            a_constz += Gm[j]*dzij*factor1*invrij3;
+    
+            // 2nd constant part
+            
+            const double dvxij = vx[i] - vx[j];
+            const double dvyij = vy[i] - vy[j];
+            const double dvzij = vz[i] - vz[j];
                 
-                const double dvxij = ps_b[i].vx - ps_b[j].vx;
-                const double dvyij = ps_b[i].vy - ps_b[j].vy;
-                const double dvzij = ps_b[i].vz - ps_b[j].vz;
-                    
-                double factor2 = dxij*(4.*ps_b[i].vx-3.*ps_b[j].vx)+dyij*(4.*ps_b[i].vy-3.*ps_b[j].vy)+dzij*(4.*ps_b[i].vz-3.*ps_b[j].vz);
+            const double factor2 = dxij*(4.*vx[i]-3.*vx[j])+dyij*(4.*vy[i]-3.*vy[j])+dzij*(4.*vz[i]-3.*vz[j]);
 
-                a_constx += G*particles[j].m/C2*(factor2*dvxij/rij3 + 7./2.*ps_b[j].ax/rij);
-                a_consty += G*particles[j].m/C2*(factor2*dvyij/rij3 + 7./2.*ps_b[j].ay/rij);
-                a_constz += G*particles[j].m/C2*(factor2*dvzij/rij3 + 7./2.*ps_b[j].az/rij);
-            }
+            a_constx += Gm[j]/C2*(factor2*dvxij*invrij3 + 7./2.*ax[j]*invrij);
+            a_consty += Gm[j]/C2*(factor2*dvyij*invrij3 + 7./2.*ay[j]*invrij);
+            a_constz += Gm[j]/C2*(factor2*dvzij*invrij3 + 7./2.*az[j]*invrij);
         }  
 
-        a_const[i][0] = a_constx;
-        a_const[i][1] = a_consty;
-        a_const[i][2] = a_constz;
+        ax_const[i] = a_constx;
+        ay_const[i] = a_consty;
+        az_const[i] = a_constz;
     }
-    for (int i = 0; i <N; i++){
-        ps_b[i].ax = a_const[i][0];
-        ps_b[i].ay = a_const[i][1];
-        ps_b[i].az = a_const[i][2];
+    if (plan->warm_start && plan->have_previous){
+        for (int i = 0; i <N; i++){
+            ax[i] = plan->a_previous[3*i];
+            ay[i] = plan->a_previous[3*i+1];
+            az[i] = plan->a_previous[3*i+2];
+        }
+    }
+    else{
+        for (int i = 0; i <N; i++){
+            ax[i] = ax_const[i];
+            ay[i] = ay_const[i];
+            az[i] = az_const[i];
+        }
     }
 
-    // Now running the substitution again and again through the loop below
-    for (int k=0; k<10; k++){ // you can set k as how many substitution you want to make
-        double a_old[N][3]; // initialize an arry that stores the information of previousu calculated accleration
-        for (int i =0; i <N; i++){
-            a_old[i][0] = ps_b[i].ax;
-            a_old[i][1] = ps_b[i].ay;
-            a_old[i][2] = ps_b[i].az;
+    // The non-constant pair weights only depend on positions, so fold G m_j into the cached rows once:
+    // inv_r3 -> G m_j/(2 C2 r_ij^3) and inv_r -> 7 G m_j/(2 C2 r_ij)
+    for (int i = 0; i < N; i++){
+        for (int j = 0; j < N; j++){
+            inv_r3[i*N+j] *= Gm[j]/(2.*C2);
+            inv_r[i*N+j] *= (7./(2.*C2))*Gm[j];
         }
-        // now add on the non-constant term
-        for (int i = 0; i < N; i++){ // a_j is used to update a_i and vice versa
+    }
+
+    // Now running the substitution again and again through the loop below
+    int k;
+    double maxdev = 0.;
+    for (k=0; k<max_iterations; k++){
+        // now add on the non-constant term. a_j is used to update a_i and vice versa, so the fractional 
+        // change of each component is measured against its previous value just before it is overwritten
+        maxdev = 0.;
+        for (int i = 0; i < N; i++){
             double non_constx = 0.;
             double non_consty = 0.;
             double non_constz = 0.;
+            const double* const w1 = &inv_r3[i*N];
+            const double* const w2 = &inv_r[i*N];
             for (int j = 0; j < N; j++){
-                if (j != i){
-                    const double dxij = ps_b[i].x - ps_b[j].x;
-                    const double dyij = ps_b[i].y - ps_b[j].y;
-                    const double dzij = ps_b[i].z - ps_b[j].z;
-                    const double rij = sqrt(dxij*dxij + dyij*dyij + dzij*dzij);
-                    const double rij3 = rij*rij*rij;
-                    const double dotproduct = dxij*ps_b[j].ax+dyij*ps_b[j].ay+dzij*ps_b[j].az;
+                const double dxij = x[i] - x[j];
+                const double dyij = y[i] - y[j];
+                const double dzij = z[i] - z[j];
+                const double dotproduct = w1[j]*(dxij*ax[j]+dyij*ay[j]+dzij*az[j]);
 
-                    non_constx += (G*particles[j].m*dxij/rij3)*dotproduct/(2.*C2) + (7./(2.*C2))*G*particles[j].m*ps_b[j].ax/rij;
-                    non_consty += (G*particles[j].m*dyij/rij3)*dotproduct/(2.*C2) + (7./(2.*C2))*G*particles[j].m*ps_b[j].ay/rij;
-                    non_constz += (G*particles[j].m*dzij/rij3)*dotproduct/(2.*C2) + (7./(2.*C2))*G*particles[j].m*ps_b[j].az/rij;
-                }
+                non_constx += dxij*dotproduct + w2[j]*ax[j];
+                non_consty += dyij*dotproduct + w2[j]*ay[j];
+                non_constz += dzij*dotproduct + w2[j]*az[j];
             }
-            ps_b[i].ax = a_const[i][0] + non_constx;
-            ps_b[i].ay = a_const[i][1] + non_consty;
-            ps_b[i].az = a_const[i][2] + non_constz;
-        }
-        
-        // break out loop if ps_b is converging
-        double maxdev = 0.;
-        double dx, dy, dz;
-        for (int i = 0; i < N; i++){
-            dx = (fabs(ps_b[i].ax) < DBL_EPSILON) ? 0. : fabs((ps_b[i].ax - a_old[i][0])/ps_b[i].ax);
-            dy = (fabs(ps_b[i].ay) < DBL_EPSILON) ? 0. : fabs((ps_b[i].ay - a_old[i][1])/ps_b[i].ay);
-            dz = (fabs(ps_b[i].az) < DBL_EPSILON) ? 0. : fabs((ps_b[i].az - a_old[i][2])/ps_b[i].az);
+            const double axi = ax_const[i] + non_constx;
+            const double ayi = ay_const[i] + non_consty;
+            const double azi = az_const[i] + non_constz;
             
+            // break out loop if accelerations are converging
+            const double dx = (fabs(axi) < DBL_EPSILON) ? 0. : fabs((axi - ax[i])/axi);
+            const double dy = (fabs(ayi) < DBL_EPSILON) ? 0. : fabs((ayi - ay[i])/ayi);
+            const double dz = (fabs(azi) < DBL_EPSILON) ? 0. : fabs((azi - az[i])/azi);
             if (dx > maxdev) { maxdev = dx; }
             if (dy > maxdev) { maxdev = dy; }
             if (dz > maxdev) { maxdev = dz; }
+
+            ax[i] = axi;
+            ay[i] = ayi;
+            az[i] = azi;
         }
         
-        if (maxdev < DBL_EPSILON){
+        if (maxdev < tolerance){
             break;
         }
-        if (k==9){
-            reb_simulation_warning(sim, "10 loops in rebx_gr_full did not converge.\n");
-            fprintf(stderr, "Fractional Error: %e\n", maxdev);
-        }
+    }
+    
+    *plan->iterations = (k < max_iterations) ? k+1 : max_iterations;
+    *plan->max_residual = maxdev;
+    if (k == max_iterations){
+        *plan->nonconverged += 1;
+        char str[300];
+        sprintf(str, "%d loops in rebx_gr_full did not converge. Fractional Error: %e\n", max_iterations, maxdev);
+        reb_simulation_warning(sim, str);
     }
    
     for (int i=0; i<N; i++){
-        particles[i].ax += ps_b[i].ax;
-        particles[i].ay += ps_b[i].ay;
-        particles[i].az += ps_b[i].az;
+        plan->a_previous[3*i] = ax[i];
+        plan->a_previous[3*i+1] = ay[i];
+        plan->a_previous[3*i+2] = az[i];
     }
-    
-    free(ps_b);
+    plan->have_previous = 1;
 
+    for (int i=0; i<N; i++){
+        particles[i].ax += ax[i];
+        particles[i].ay += ay[i];
+        particles[i].az += az[i];
+    }
 }
 
-void rebx_gr_full(struct reb_simulation* const sim, struct rebx_force* const gr_full, struct reb_particle* const particles, const int N){
-    double* c = rebx_get_param(sim->extras, gr_full->ap, "c");
+int rebx_gr_full_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_extras* const rebx = sim->extras;
+    struct rebx_gr_full_plan* const plan = realloc(force->plan, sizeof(*plan) + 3*N*sizeof(double));
+    if (plan == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    force->plan = plan;
+    const double* const c = rebx_get_param(rebx, force->ap, "c");
     if (c == NULL){
         reb_simulation_error(sim, "REBOUNDx Error: Need to set speed of light in gr effect.  See examples in documentation.\n");
-        return;
+        return 0;
     }
-    const double C2 = (*c)*(*c);
-    const unsigned int gravity_ignore_10 = sim->gravity_ignore_terms==1;
-    int* max_iterations = rebx_get_param(sim->extras, gr_full->ap, "max_iterations");
-    if(max_iterations != NULL){
-        rebx_calculate_gr_full(sim, particles, N, C2, sim->G, *max_iterations, gravity_ignore_10);
+    plan->C2 = (*c)*(*c);
+    const int* const max_iterations = rebx_get_param(rebx, force->ap, "max_iterations");
+    plan->max_iterations = max_iterations ? *max_iterations : 10; // default
+    const double* const tolerance = rebx_get_param(rebx, force->ap, "gr_tolerance");
+    plan->tolerance = tolerance ? *tolerance : DBL_EPSILON; // default
+    const int* const warm_start = rebx_get_param(rebx, force->ap, "gr_warm_start");
+    plan->warm_start = warm_start ? *warm_start : 0; // default
+    const int* const reuse_gravity = rebx_get_param(rebx, force->ap, "gr_reuse_gravity");
+    plan->reuse_gravity = reuse_gravity ? *reuse_gravity : 0; // default
+    plan->have_previous = 0;    // previous solution may belong to different particles or parameters
+    
+    // Telemetry is written through pointers each call, so these sets only happen the first time
+    if (rebx_get_param(rebx, force->ap, "gr_iterations") == NULL){
+        rebx_set_param_int(rebx, &force->ap, "gr_iterations", 0);
     }
-    else{
-        const int default_max_iterations = 10;
-        rebx_calculate_gr_full(sim, particles, N, C2, sim->G, default_max_iterations, gravity_ignore_10);
+    if (rebx_get_param(rebx, force->ap, "gr_max_residual") == NULL){
+        rebx_set_param_double(rebx, &force->ap, "gr_max_residual", 0.);
+    }
+    if (rebx_get_param(rebx, force->ap, "gr_nonconverged") == NULL){
+        rebx_set_param_int(rebx, &force->ap, "gr_nonconverged", 0);
     }
+    plan->iterations = rebx_get_param(rebx, force->ap, "gr_iterations");
+    plan->max_residual = rebx_get_param(rebx, force->ap, "gr_max_residual");
+    plan->nonconverged = rebx_get_param(rebx, force->ap, "gr_nonconverged");
+    return 1;
+}
+
+void rebx_gr_full(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_gr_full_plan* const plan = rebx_get_force_plan(sim, force, particles, N);
+    if (plan == NULL){
+        return;
+    }
+    double* const workspace = rebx_get_force_workspace(sim, force, rebx_gr_full_workspace_size(N)*sizeof(*workspace));
+    if (workspace == NULL){
+        return;
+    }
+    const unsigned int gravity_ignore_10 = sim->gravity_ignore_terms==1;
+    rebx_calculate_gr_full(sim, plan, particles, N, sim->G, gravity_ignore_10, workspace);
 }
 
 double rebx_gr_full_hamiltonian(struct rebx_extras* const rebx, const struct rebx_force* const force){
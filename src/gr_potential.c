@@ -77,15 +77,34 @@ static void rebx_calculate_gr_potential(struct reb_particle* const particles, co
     }
 }
 
-void rebx_gr_potential(struct reb_simulation* const sim, struct rebx_force* const gr_potential, struct reb_particle* const particles, const int N){
-    double* c = rebx_get_param(sim->extras, gr_potential->ap, "c");
+struct rebx_gr_potential_plan{
+    double C2;                  // speed of light squared
+};
+
+int rebx_gr_potential_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    if (force->plan == NULL){
+        force->plan = malloc(sizeof(struct rebx_gr_potential_plan));
+        if (force->plan == NULL){
+            reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+            return 0;
+        }
+    }
+    struct rebx_gr_potential_plan* const plan = force->plan;
+    const double* const c = rebx_get_param(sim->extras, force->ap, "c");
     if (c == NULL){
         reb_simulation_error(sim, "REBOUNDx Error: Need to set speed of light in gr effect.  See examples in documentation.\n");
+        return 0;
     }
-    else{
-        const double C2 = (*c)*(*c);
-        rebx_calculate_gr_potential(particles, N, C2, sim->G);
+    plan->C2 = (*c)*(*c);
+    return 1;
+}
+
+void rebx_gr_potential(struct reb_simulation* const sim, struct rebx_force* const gr_potential, struct reb_particle* const particles, const int N){
+    const struct rebx_gr_potential_plan* const plan = rebx_get_force_plan(sim, gr_potential, particles, N);
+    if (plan == NULL){
+        return;
     }
+    rebx_calculate_gr_potential(particles, N, plan->C2, sim->G);
 }
 
 static double rebx_calculate_gr_potential_potential(struct reb_simulation* const sim, const double C2){
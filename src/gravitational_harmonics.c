@@ -137,21 +137,33 @@ void rebx_gravitational_harmonics(struct reb_simulation* const sim, struct rebx_
     const double G = sim->G;
     struct rebx_extras* const rebx = sim->extras;
 
-    for (int i=0; i<N; i++){
-        const double* const J2 = rebx_get_param(rebx, particles[i].ap, "J2");
-        if (J2 == NULL){
-            continue;
-        }
+    const int J2_id = rebx_get_param_id(rebx, "J2");
+    const int J4_id = rebx_get_param_id(rebx, "J4");
+    const int R_eq_id = rebx_get_param_id(rebx, "R_eq");
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
+    struct reb_vec3d* const back_reactions = rebx_get_force_workspace(sim, gh, N*sizeof(*back_reactions));
+    if (back_reactions == NULL){
+        return;
+    }
+
+    // Only the few bodies with J2 set source the harmonics, so don't look up params on every particle
+    const struct rebx_role_list* const bodies = rebx_get_role_particles(rebx, J2_id, particles, N);
+    if (bodies == NULL){
+        return;
+    }
+    for (int k=0; k<bodies->N_roles; k++){
+        const int i = bodies->indices[k];
+        const double* const J2 = rebx_get_param_by_id(rebx, particles[i].ap, J2_id);
         if (*J2 == 0.0){
             continue;
         }
-        const double* const J4 = rebx_get_param(rebx, particles[i].ap, "J4");
-        const double* const R_eq = rebx_get_param(rebx, particles[i].ap, "R_eq");
+        const double* const J4 = rebx_get_param_by_id(rebx, particles[i].ap, J4_id);
+        const double* const R_eq = rebx_get_param_by_id(rebx, particles[i].ap, R_eq_id);
         if (R_eq == NULL){
             continue;
         }
         struct reb_vec3d Omega = DEFAULTOMEGA;
-        const struct reb_vec3d* Omegaptr = rebx_get_param(rebx, particles[i].ap, "Omega");
+        const struct reb_vec3d* Omegaptr = rebx_get_param_by_id(rebx, particles[i].ap, Omega_id);
         if (Omegaptr != NULL){
             Omega.x = Omegaptr->x;
             Omega.y = Omegaptr->y;
@@ -181,6 +193,7 @@ void rebx_gravitational_harmonics(struct reb_simulation* const sim, struct rebx_
         hatz_.y = hatv.z;
         hatz_.z = hatw.z;
 
+#pragma omp parallel for
         for (int j=0; j<N; j++){
             if (j == i){
                 continue;
@@ -218,9 +231,18 @@ void rebx_gravitational_harmonics(struct reb_simulation* const sim, struct rebx_
 
             const double fac = pj.m/pi.m;
 
-            particles[i].ax -= fac*ax;
-            particles[i].ay -= fac*ay;
-            particles[i].az -= fac*az;
+            back_reactions[j].x = fac*ax;
+            back_reactions[j].y = fac*ay;
+            back_reactions[j].z = fac*az;
+        }
+        // Sum back reactions serially in index order so results don't depend on the number of threads
+        for (int j=0; j<N; j++){
+            if (j == i){
+                continue;
+            }
+            particles[i].ax -= back_reactions[j].x;
+            particles[i].ay -= back_reactions[j].y;
+            particles[i].az -= back_reactions[j].z;
         }
     }
 }
@@ -262,21 +284,26 @@ double rebx_gravitational_harmonics_potential(struct rebx_extras* const rebx){
     const int N = sim->N - sim->N_var;
     double H = 0.0;
 
+    const int J2_id = rebx_get_param_id(rebx, "J2");
+    const int J4_id = rebx_get_param_id(rebx, "J4");
+    const int R_eq_id = rebx_get_param_id(rebx, "R_eq");
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
+
     for (int i=0; i<N; i++){
-        const double* const J2 = rebx_get_param(rebx, particles[i].ap, "J2");
+        const double* const J2 = rebx_get_param_by_id(rebx, particles[i].ap, J2_id);
         if (J2 == NULL){
             continue;
         }
         if (*J2 == 0.0){
             continue;
         }
-        const double* const J4 = rebx_get_param(rebx, particles[i].ap, "J4");
-        const double* const R_eq = rebx_get_param(rebx, particles[i].ap, "R_eq");
+        const double* const J4 = rebx_get_param_by_id(rebx, particles[i].ap, J4_id);
+        const double* const R_eq = rebx_get_param_by_id(rebx, particles[i].ap, R_eq_id);
         if (R_eq == NULL){
             continue;
         }
         struct reb_vec3d Omega = DEFAULTOMEGA;
-        const struct reb_vec3d* Omegaptr = rebx_get_param(rebx, particles[i].ap, "Omega");
+        const struct reb_vec3d* Omegaptr = rebx_get_param_by_id(rebx, particles[i].ap, Omega_id);
         if (Omegaptr != NULL){
             Omega.x = Omegaptr->x;
             Omega.y = Omegaptr->y;
@@ -27,30 +27,80 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "rebound.h"
 #include "reboundx.h"
 #include "core.h"
 
-// Macro to read a single field from a binary file.
+/* Binaries are loaded from a single block of memory: the file is memory mapped where possible, and otherwise read in one go.
+ The field tree is validated once up front (every field fits inside its parent and every object ends with an END field at exactly its size), so a corrupt binary is rejected before any effects are loaded. Names and values are then read in place from the block and copied straight into the parameter store, rather than going through a read and a malloc per field.*/
+
+struct rebx_reader{
+    const char* data;
+    long size;
+    long position;
+};
+
+// Returns a pointer to the next size bytes and moves past them, or NULL if there aren't that many left
+static const void* rebx_read_in_place(struct rebx_reader* const inf, const long size){
+    if (size < 0 || size > inf->size - inf->position){
+        return NULL;
+    }
+    const void* data = inf->data + inf->position;
+    inf->position += size;
+    return data;
+}
+
+static int rebx_read(struct rebx_reader* const inf, void* const value, const long size){
+    const void* data = rebx_read_in_place(inf, size);
+    if (data == NULL){
+        return 0;
+    }
+    memcpy(value, data, size);
+    return 1;
+}
+
+static int rebx_read_field(struct rebx_reader* const inf, struct rebx_binary_field* const field){
+    return rebx_read(inf, field, sizeof(*field));
+}
+
+static void rebx_skip_field(struct rebx_reader* const inf, const long field_size){
+    if (field_size < 0 || field_size > inf->size - inf->position){
+        inf->position = inf->size;
+        return;
+    }
+    inf->position += field_size;
+}
+
+// Skips a field whose contents begin at start, wherever a failed load of them stopped
+static void rebx_skip_field_from(struct rebx_reader* const inf, const long start, const long field_size){
+    inf->position = start;
+    rebx_skip_field(inf, field_size);
+}
+
+// Macro to read a single field of known size from a binary.
 #define CASE(typename, valueref) case REBX_BINARY_FIELD_TYPE_##typename: \
 {\
-if(!fread(valueref, field.size, 1, inf)){\
+if(field.size != sizeof(*(valueref)) || !rebx_read(inf, valueref, field.size)){\
 *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;\
+rebx_skip_field(inf, field.size);\
 }\
 break;\
 }\
 
-#define CASE_MALLOC(typename, valueref) case REBX_BINARY_FIELD_TYPE_##typename: \
+// Macro to point valueref at a variable size field in the binary, with its size in sizeref
+#define CASE_IN_PLACE(typename, valueref, sizeref) case REBX_BINARY_FIELD_TYPE_##typename: \
 {\
-valueref = malloc(field.size);\
+valueref = rebx_read_in_place(inf, field.size);\
+sizeref = field.size;\
 if(valueref == NULL){\
-*warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;\
-}\
-else{\
-if(!fread(valueref, field.size, 1, inf)){\
 *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;\
-free(valueref);\
-}\
+rebx_skip_field(inf, field.size);\
 }\
 break;\
 }\
@@ -59,96 +109,190 @@ void rebx_input_skip_binary_field(FILE* inf, long field_size){
     fseek(inf, field_size, SEEK_CUR);
 }
 
-static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type expected_type, struct rebx_node** ap, FILE* inf, enum rebx_input_binary_messages* warnings);
+static int rebx_is_object_field(const enum rebx_binary_field_type type){
+    switch (type){
+        case REBX_BINARY_FIELD_TYPE_OPERATOR:
+        case REBX_BINARY_FIELD_TYPE_PARTICLE:
+        case REBX_BINARY_FIELD_TYPE_REBX_STRUCTURE:
+        case REBX_BINARY_FIELD_TYPE_PARAM:
+        case REBX_BINARY_FIELD_TYPE_STEP:
+        case REBX_BINARY_FIELD_TYPE_REGISTERED_PARAM:
+        case REBX_BINARY_FIELD_TYPE_ADDITIONAL_FORCE:
+        case REBX_BINARY_FIELD_TYPE_PARAM_LIST:
+        case REBX_BINARY_FIELD_TYPE_REGISTERED_PARAMETERS:
+        case REBX_BINARY_FIELD_TYPE_ALLOCATED_FORCES:
+        case REBX_BINARY_FIELD_TYPE_ALLOCATED_OPERATORS:
+        case REBX_BINARY_FIELD_TYPE_ADDITIONAL_FORCES:
+        case REBX_BINARY_FIELD_TYPE_PRE_TIMESTEP_MODIFICATIONS:
+        case REBX_BINARY_FIELD_TYPE_POST_TIMESTEP_MODIFICATIONS:
+        case REBX_BINARY_FIELD_TYPE_PARTICLES:
+        case REBX_BINARY_FIELD_TYPE_FORCE:
+        case REBX_BINARY_FIELD_TYPE_SNAPSHOT:
+            return 1;
+        default: // data fields, and unknown fields from newer versions, which are skipped whole
+            return 0;
+    }
+}
 
-static struct rebx_param* rebx_read_param(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
-    
-    struct rebx_param* param = malloc(sizeof(*param));
-    if (param == NULL){
-        *warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;
-        return NULL;
+#define REBX_INPUT_MAX_DEPTH 32
+
+// Checks that the fields in data tile it exactly. Inside objects, the last field has to be an END field.
+static int rebx_validate_fields(const char* const data, const long size, const int object, const int depth){
+    if (depth > REBX_INPUT_MAX_DEPTH){
+        return 0;
     }
-    param->value = NULL;
-    param->name = NULL;
+    struct rebx_reader inf = {.data = data, .size = size, .position = 0};
+    while (inf.position < size){
+        struct rebx_binary_field field;
+        if (!rebx_read_field(&inf, &field)){
+            return 0;
+        }
+        const char* const contents = rebx_read_in_place(&inf, field.size);
+        if (contents == NULL){
+            return 0;
+        }
+        if (field.type == REBX_BINARY_FIELD_TYPE_END){
+            return object && field.size == 0 && inf.position == size;
+        }
+        if (rebx_is_object_field(field.type) && !rebx_validate_fields(contents, field.size, 1, depth+1)){
+            return 0;
+        }
+    }
+    return !object; // objects have to end with an END field
+}
+
+static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type expected_type, struct rebx_node** ap, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings);
+
+// Name and value point into the binary
+struct rebx_binary_param{
+    enum rebx_param_type type;
+    const char* name;
+    long name_size;
+    const void* value;
+    long value_size;
+};
+
+static int rebx_is_string(const char* const str, const long size){
+    return str != NULL && size > 0 && str[size-1] == '\0';
+}
+
+static int rebx_read_param(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings, struct rebx_binary_param* const param){
     param->type = REBX_TYPE_NONE;
+    param->name = NULL;
+    param->name_size = 0;
+    param->value = NULL;
+    param->value_size = 0;
     
     struct rebx_binary_field field;
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){ // means we didn't reach an END field. Corrupt
+        if (!rebx_read_field(inf, &field)){ // means we didn't reach an END field. Corrupt
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             break;
         }
         switch (field.type){
             CASE(PARAM_TYPE,                  &param->type);
-            CASE_MALLOC(NAME,                 param->name);
-            CASE_MALLOC(PARAM_VALUE,          param->value);
+            CASE_IN_PLACE(NAME,               param->name,      param->name_size);
+            CASE_IN_PLACE(PARAM_VALUE,        param->value,     param->value_size);
             case REBX_BINARY_FIELD_TYPE_END:
                 reading_fields=0;
                 break;
             default: // Might have added new fields, saved with new version and loaded with old version
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_FIELD_UNKNOWN;
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
     }
     // Check type and name after param has been loaded. Check value later (registered params should have value=NULL)
-    if (param->type == REBX_TYPE_NONE || param->name == NULL){
+    if (param->type == REBX_TYPE_NONE || !rebx_is_string(param->name, param->name_size)){
         *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-        rebx_free_param(param);
-        return NULL;
+        return 0;
     }
-    return param;
+    return 1;
 }
 
-static int rebx_load_param(struct rebx_extras* rebx, struct rebx_node** ap, FILE* inf, enum rebx_input_binary_messages* warnings){
-    struct rebx_param* param = rebx_read_param(rebx, inf, warnings);
-    
-    if(param == NULL){
+static int rebx_load_param(struct rebx_extras* rebx, struct rebx_node** ap, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
+    struct rebx_binary_param param;
+    if(!rebx_read_param(rebx, inf, warnings, &param)){
         return 0;
     }
     
-    if(param->value == NULL){
+    if(param.value == NULL){
         *warnings |= REBX_INPUT_BINARY_WARNING_PARAM_VALUE_NULL;
-        rebx_free_param(param);
         return 0;
     }
     
-    if(param->type == REBX_TYPE_FORCE){
-        struct rebx_force* force = rebx_get_force(rebx, param->value);
+    // Registered params are loaded first, so name should always be found
+    const int id = rebx_get_param_id(rebx, param.name);
+    if(id < 0){
+        return 0;
+    }
+    if(param.type != rebx_get_registered_param(rebx, id)->type){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        return 0;
+    }
+    
+    struct rebx_force* force = NULL;
+    if(param.type == REBX_TYPE_FORCE){
+        // For force params the value is the force name (see output.c)
+        force = rebx_is_string(param.value, param.value_size) ? rebx_get_force(rebx, param.value) : NULL;
         if (force == NULL){
             *warnings |= REBX_INPUT_BINARY_WARNING_FORCE_PARAM_NOT_LOADED;
-            rebx_free_param(param);
             return 0;
         }
-        param->value = force;
     }
-    int success = rebx_add_param(rebx, ap, param);
-    if(!success){
+    else if(param.value_size != (long)rebx_sizeof(rebx, param.type)){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
         return 0;
     }
+    
+    // Copy straight from the binary into the compact block used for params in ap lists (see rebx_create_param_node)
+    struct rebx_node* node = rebx_create_param_node(rebx, id);
+    if(node == NULL){
+        *warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;
+        return 0;
+    }
+    if(param.type == REBX_TYPE_FORCE){
+        *(void**)rebx_param_node_storage(node) = force;
+    }
+    else{
+        memcpy(rebx_param_node_storage(node), param.value, param.value_size);
+    }
+    rebx_add_param_node(rebx, ap, node);
     return 1;
     
 }
 
-static int rebx_load_registered_param(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
-    struct rebx_param* param = rebx_read_param(rebx, inf, warnings);
-    
-    if(param == NULL){
+static int rebx_load_registered_param(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
+    struct rebx_binary_param param;
+    if(!rebx_read_param(rebx, inf, warnings, &param)){
         return 0;
     }
     
-    int success = rebx_add_param(rebx, &rebx->registered_params, param);
+    if(rebx_get_type(rebx, param.name) != REBX_TYPE_NONE){ // already registered
+        return 1;
+    }
+    
+    // Registered params live in the arena (see rebx_register_param)
+    struct rebx_param* reg_param = rebx_create_param(rebx, param.name, param.type);
+    if(reg_param == NULL){
+        *warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;
+        return 0;
+    }
+    int success = rebx_add_registered_param(rebx, reg_param);
     if(!success){
+        rebx_free_reg_param(rebx, reg_param);
         return 0;
     }
     return 1;
 }
 
-static char* rebx_load_name(FILE* inf, enum rebx_input_binary_messages* warnings){
+// Returns a pointer to the name in the binary
+static const char* rebx_load_name(struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     struct rebx_binary_field field;
-    if (!fread(&field, sizeof(field), 1, inf)){
+    if (!rebx_read_field(inf, &field)){
         *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
         return NULL;
     }
@@ -156,28 +300,22 @@ static char* rebx_load_name(FILE* inf, enum rebx_input_binary_messages* warnings
         *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
         return NULL;
     }
-    char* name = malloc(field.size);
-    if (name == NULL){
-        *warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;
-        return NULL;
-    }
-    if (!fread(name, field.size, 1, inf)){
+    const char* name = rebx_read_in_place(inf, field.size);
+    if (!rebx_is_string(name, field.size)){
         *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-        free(name);
         return NULL;
     }
     return name;
 }
 
-static int rebx_load_force_field(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
+static int rebx_load_force_field(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     
     // Name of force always comes first so that we can load it
-    char* name = rebx_load_name(inf, warnings);
+    const char* name = rebx_load_name(inf, warnings);
     if(name == NULL){
         return 0;
     }
     struct rebx_force* force = rebx_load_force(rebx, name);
-    free(name);
     if(force == NULL){
         *warnings |= REBX_INPUT_BINARY_WARNING_FORCE_NOT_LOADED;
         return 0;
@@ -186,7 +324,7 @@ static int rebx_load_force_field(struct rebx_extras* rebx, FILE* inf, enum rebx_
     struct rebx_binary_field field;
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             return 0;
         }
@@ -206,7 +344,7 @@ static int rebx_load_force_field(struct rebx_extras* rebx, FILE* inf, enum rebx_
             default:
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_FIELD_UNKNOWN;
-                rebx_input_skip_binary_field(inf, field.size);
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
@@ -216,14 +354,13 @@ static int rebx_load_force_field(struct rebx_extras* rebx, FILE* inf, enum rebx_
 }
 
 // Force is already loaded in allocated_forces. Need to get from that list and add to sim
-static int rebx_load_additional_force_field(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
+static int rebx_load_additional_force_field(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     
-    char* name = rebx_load_name(inf, warnings);
+    const char* name = rebx_load_name(inf, warnings);
     if(name == NULL){
         return 0;
     }
     struct rebx_force* force = rebx_get_force(rebx, name);
-    free(name);
     if(force == NULL){
         return 0;
     }
@@ -232,7 +369,7 @@ static int rebx_load_additional_force_field(struct rebx_extras* rebx, FILE* inf,
     struct rebx_binary_field field;
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             return 0;
         }
@@ -245,7 +382,7 @@ static int rebx_load_additional_force_field(struct rebx_extras* rebx, FILE* inf,
             default:
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_FIELD_UNKNOWN;
-                rebx_input_skip_binary_field(inf, field.size);
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
@@ -255,14 +392,13 @@ static int rebx_load_additional_force_field(struct rebx_extras* rebx, FILE* inf,
     return success;
 }
 
-static int rebx_load_operator_field(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
+static int rebx_load_operator_field(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     // Name of force always comes first so that we can load it
-    char* name = rebx_load_name(inf, warnings);
+    const char* name = rebx_load_name(inf, warnings);
     if(name == NULL){
         return 0;
     }
     struct rebx_operator* operator = rebx_load_operator(rebx, name);
-    free(name);
     if(operator == NULL){
         *warnings |= REBX_INPUT_BINARY_WARNING_OPERATOR_NOT_LOADED;
         return 0;
@@ -271,7 +407,7 @@ static int rebx_load_operator_field(struct rebx_extras* rebx, FILE* inf, enum re
     struct rebx_binary_field field;
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             break;
         }
@@ -291,7 +427,7 @@ static int rebx_load_operator_field(struct rebx_extras* rebx, FILE* inf, enum re
             default:
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_FIELD_UNKNOWN;
-                rebx_input_skip_binary_field(inf, field.size);
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
@@ -300,13 +436,12 @@ static int rebx_load_operator_field(struct rebx_extras* rebx, FILE* inf, enum re
     return 1;
 }
 
-static int rebx_load_step_field(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings, struct rebx_node** ap){
-    char* name = rebx_load_name(inf, warnings);
+static int rebx_load_step_field(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings, struct rebx_node** ap){
+    const char* name = rebx_load_name(inf, warnings);
     if(name == NULL){
         return 0;
     }
     struct rebx_operator* operator = rebx_get_operator(rebx, name);
-    free(name);
     if(operator == NULL){
         *warnings |= REBX_INPUT_BINARY_WARNING_OPERATOR_NOT_LOADED;
         return 0;
@@ -316,7 +451,7 @@ static int rebx_load_step_field(struct rebx_extras* rebx, FILE* inf, enum rebx_i
     struct rebx_binary_field field;
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             break;
         }
@@ -328,6 +463,7 @@ static int rebx_load_step_field(struct rebx_extras* rebx, FILE* inf, enum rebx_i
             default:
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_FIELD_UNKNOWN;
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
@@ -347,10 +483,10 @@ static int rebx_load_step_field(struct rebx_extras* rebx, FILE* inf, enum rebx_i
     return success;
 }
 
-static int rebx_load_particle(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
+static int rebx_load_particle(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     struct reb_particle* p = NULL;
     struct rebx_binary_field field;
-    if (!fread(&field, sizeof(field), 1, inf)){
+    if (!rebx_read_field(inf, &field)){
         *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
         return 0;
     }
@@ -360,16 +496,19 @@ static int rebx_load_particle(struct rebx_extras* rebx, FILE* inf, enum rebx_inp
         return 0;
     }
     int index;
-    if(!fread(&index, field.size, 1, inf)){
+    if(field.size != sizeof(index) || !rebx_read(inf, &index, field.size)){
         *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
         return 0;
     }
+    if(index < 0 || index >= rebx->sim->N){ // checked sim is valid in init_from_binary
+        return 0;
+    }
     
-    p = &rebx->sim->particles[index]; // checked sim is valid in init_from_binary
+    p = &rebx->sim->particles[index];
     
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             return 0;
         }
@@ -389,7 +528,7 @@ static int rebx_load_particle(struct rebx_extras* rebx, FILE* inf, enum rebx_inp
             default:
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_FIELD_UNKNOWN;
-                rebx_input_skip_binary_field(inf, field.size);
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
@@ -397,14 +536,15 @@ static int rebx_load_particle(struct rebx_extras* rebx, FILE* inf, enum rebx_inp
     return 1;
 }
 
-static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
+static int rebx_load_rebx(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     struct rebx_binary_field field;
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             break;
         }
+        const long start = inf->position;
         switch (field.type){
             case REBX_BINARY_FIELD_TYPE_END:
             {
@@ -415,7 +555,7 @@ static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_b
             {
                 if (!rebx_load_list(rebx, REBX_BINARY_FIELD_TYPE_REGISTERED_PARAM, &rebx->registered_params, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -423,7 +563,7 @@ static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_b
             {
                 if (!rebx_load_list(rebx, REBX_BINARY_FIELD_TYPE_FORCE, NULL, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -431,7 +571,7 @@ static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_b
             {
                 if (!rebx_load_list(rebx, REBX_BINARY_FIELD_TYPE_OPERATOR, NULL, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -439,7 +579,7 @@ static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_b
             {
                 if (!rebx_load_list(rebx, REBX_BINARY_FIELD_TYPE_ADDITIONAL_FORCE, NULL, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -447,7 +587,7 @@ static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_b
             {
                 if (!rebx_load_list(rebx, REBX_BINARY_FIELD_TYPE_STEP, &rebx->pre_timestep_modifications, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -455,14 +595,14 @@ static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_b
             {
                 if (!rebx_load_list(rebx, REBX_BINARY_FIELD_TYPE_STEP, &rebx->post_timestep_modifications, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
             default:
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_FIELD_UNKNOWN;
-                rebx_input_skip_binary_field(inf, field.size);
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
@@ -470,9 +610,9 @@ static int rebx_load_rebx(struct rebx_extras* rebx, FILE* inf, enum rebx_input_b
     return 1;
 }
 
-static int rebx_load_snapshot(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
+static int rebx_load_snapshot(struct rebx_extras* rebx, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     struct rebx_binary_field field;
-    if (!fread(&field, sizeof(field), 1, inf)){
+    if (!rebx_read_field(inf, &field)){
         *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
         return 0;
     }
@@ -483,16 +623,17 @@ static int rebx_load_snapshot(struct rebx_extras* rebx, FILE* inf, enum rebx_inp
 
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
             break;
         }
+        const long start = inf->position;
         switch (field.type){
             case REBX_BINARY_FIELD_TYPE_REBX_STRUCTURE:
             {
                 if (!rebx_load_rebx(rebx, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_REBX_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -500,10 +641,16 @@ static int rebx_load_snapshot(struct rebx_extras* rebx, FILE* inf, enum rebx_inp
             {
                 if (!rebx_load_list(rebx, REBX_BINARY_FIELD_TYPE_PARTICLE, NULL, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
+            case REBX_BINARY_FIELD_TYPE_SNAPSHOT_T:
+            case REBX_BINARY_FIELD_TYPE_SNAPSHOT_STEPS_DONE:
+            {
+                rebx_skip_field(inf, field.size); // only used to find snapshots in archives
+                break;
+            }
             case REBX_BINARY_FIELD_TYPE_END:
             {
                 reading_fields=0;
@@ -512,7 +659,7 @@ static int rebx_load_snapshot(struct rebx_extras* rebx, FILE* inf, enum rebx_inp
             default:
             {
                 *warnings |= REBX_INPUT_BINARY_WARNING_LIST_UNKNOWN;
-                rebx_input_skip_binary_field(inf, field.size);
+                rebx_skip_field(inf, field.size);
                 break;
             }
         }
@@ -522,11 +669,11 @@ static int rebx_load_snapshot(struct rebx_extras* rebx, FILE* inf, enum rebx_inp
 }
 
 // Only fails (returns 0) if binary is in wrong format
-static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type expected_type, struct rebx_node** ap, FILE* inf, enum rebx_input_binary_messages* warnings){
+static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type expected_type, struct rebx_node** ap, struct rebx_reader* inf, enum rebx_input_binary_messages* warnings){
     struct rebx_binary_field field;
     int reading_fields = 1;
     while (reading_fields){
-        if (!fread(&field, sizeof(field), 1, inf)){
+        if (!rebx_read_field(inf, &field)){
             return 0;
         }
         
@@ -538,6 +685,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
         if (field.type != expected_type){
             return 0;
         }
+        const long start = inf->position;
         
         // Only will have fields of expected_type, check function to call
         switch (field.type){
@@ -545,7 +693,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
             {
                 if(!rebx_load_param(rebx, ap, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_WARNING_PARAM_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -553,7 +701,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
             {
                 if(!rebx_load_registered_param(rebx, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_ERROR_REGISTERED_PARAM_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -561,7 +709,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
             {
                 if (!rebx_load_force_field(rebx, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_WARNING_FORCE_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -569,7 +717,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
             {
                 if (!rebx_load_additional_force_field(rebx, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_WARNING_ADDITIONAL_FORCE_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -577,7 +725,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
             {
                 if (!rebx_load_operator_field(rebx, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_WARNING_OPERATOR_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -585,7 +733,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
             {
                 if (!rebx_load_step_field(rebx, inf, warnings, ap)){
                     *warnings |= REBX_INPUT_BINARY_WARNING_STEP_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -593,7 +741,7 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
             {
                 if (!rebx_load_particle(rebx, inf, warnings)){
                     *warnings |= REBX_INPUT_BINARY_WARNING_PARTICLE_PARAMS_NOT_LOADED;
-                    rebx_input_skip_binary_field(inf, field.size);
+                    rebx_skip_field_from(inf, start, field.size);
                 }
                 break;
             }
@@ -607,9 +755,8 @@ static int rebx_load_list(struct rebx_extras* rebx, enum rebx_binary_field_type
     return 1;
 }
 
-static void rebx_input_read_header(FILE* inf, enum rebx_input_binary_messages* warnings){
-    long objects = 0;
-    // Input header.
+// Compares version, but ignores githash.
+static void rebx_input_check_header(const char* const header, enum rebx_input_binary_messages* warnings){
     const char str[] = "REBOUNDx Binary File. Version: ";
     const char zero = '\0';
     char readbuf[65], curvbuf[65];
@@ -617,42 +764,144 @@ static void rebx_input_read_header(FILE* inf, enum rebx_input_binary_messages* w
     memcpy(curvbuf+strlen(curvbuf)+1,rebx_githash_str,sizeof(char)*(62-strlen(curvbuf)));
     curvbuf[63] = zero;
     
-    objects += fread(readbuf,sizeof(*str),64,inf);
-    // Note: following compares version, but ignores githash.
+    memcpy(readbuf, header, 64);
+    readbuf[64] = zero;
     if(strcmp(readbuf,curvbuf)!=0){
         *warnings |= REBX_INPUT_BINARY_WARNING_VERSION;
     }
 }
 
-void rebx_init_extras_from_binary(struct rebx_extras* rebx, const char* const filename, enum rebx_input_binary_messages* warnings){
+static void rebx_input_read_header(FILE* inf, enum rebx_input_binary_messages* warnings){
+    char readbuf[64] = {0};
+    if (!fread(readbuf,sizeof(*readbuf),64,inf)){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        return;
+    }
+    rebx_input_check_header(readbuf, warnings);
+}
+
+void rebx_init_extras_from_snapshot(struct rebx_extras* rebx, const char* const data, const size_t size, const long offset, enum rebx_input_binary_messages* warnings){
     if (rebx->sim == NULL){
         rebx_error(rebx, ""); // rebx_error gives meaningful err
         return;
     }
+    struct rebx_reader inf = {.data = data, .size = size, .position = 0};
+    const char* header = rebx_read_in_place(&inf, 64);
+    if (header == NULL || offset < inf.position){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        return;
+    }
+    // Only the snapshot being loaded is validated, so loading from a long archive doesn't depend on its length
+    inf.position = offset;
+    struct rebx_binary_field field;
+    if (!rebx_read_field(&inf, &field) || field.type != REBX_BINARY_FIELD_TYPE_SNAPSHOT || rebx_read_in_place(&inf, field.size) == NULL || !rebx_validate_fields(data + offset + sizeof(field), field.size, 1, 1)){
+        *warnings |= REBX_INPUT_BINARY_ERROR_CORRUPT;
+        return;
+    }
+    rebx_input_check_header(header, warnings);
+    inf.position = offset;
+    rebx_load_snapshot(rebx, &inf, warnings);
+}
+
+void rebx_init_extras_from_buffer(struct rebx_extras* rebx, const void* const buffer, const size_t size, enum rebx_input_binary_messages* warnings){
+    rebx_init_extras_from_snapshot(rebx, buffer, size, 64, warnings); // first snapshot comes right after the header
+}
+
+// Reads the rest of the stream into memory in large blocks, so it also works for pipes
+static char* rebx_read_stream(FILE* inf, size_t* const size){
+    *size = 0;
+    size_t allocated = 1<<16;
+    char* buffer = malloc(allocated);
+    while (buffer != NULL){
+        *size += fread(buffer + *size, 1, allocated - *size, inf);
+        if (*size < allocated){
+            break;
+        }
+        allocated *= 2;
+        char* larger = realloc(buffer, allocated);
+        if (larger == NULL){
+            free(buffer);
+        }
+        buffer = larger;
+    }
+    return buffer;
+}
+
+void rebx_init_extras_from_stream(struct rebx_extras* rebx, FILE* inf, enum rebx_input_binary_messages* warnings){
+    size_t size;
+    char* buffer = rebx_read_stream(inf, &size);
+    if (buffer == NULL){
+        *warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;
+        return;
+    }
+    rebx_init_extras_from_buffer(rebx, buffer, size, warnings);
+    free(buffer);
+}
+
+int rebx_open_binary_file(const char* const filename, struct rebx_binary_file* const file, enum rebx_input_binary_messages* warnings){
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+#ifndef _WIN32
+    // Map the file read-only rather than copying it, so restart time is set by how fast the pages come in from disk
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0){
+        *warnings |= REBX_INPUT_BINARY_ERROR_NOFILE;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0){
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED){
+            close(fd);
+            file->data = data;
+            file->size = st.st_size;
+            file->mapped = 1;
+            return 1;
+        }
+    }
+    close(fd); // can't map (e.g. a pipe or special file), fall back to reading it
+#endif
     FILE* inf = fopen(filename,"rb");
     if (!inf){
         *warnings |= REBX_INPUT_BINARY_ERROR_NOFILE;
-        return;
+        return 0;
     }
-    
-    rebx_input_read_header(inf, warnings);
-    rebx_load_snapshot(rebx, inf, warnings);
-    
+    file->data = rebx_read_stream(inf, &file->size);
     fclose(inf);
-    return;
+    if (file->data == NULL){
+        *warnings |= REBX_INPUT_BINARY_ERROR_NO_MEMORY;
+        return 0;
+    }
+    return 1;
 }
 
-struct rebx_extras* rebx_create_extras_from_binary(struct reb_simulation* sim, const char* const filename){
-    if (sim == NULL){
-        fprintf(stderr, "REBOUNDx Error: Simulation pointer passed to rebx_create_extras_from_binary was NULL.\n");
-        return NULL;
+void rebx_close_binary_file(struct rebx_binary_file* const file){
+#ifndef _WIN32
+    if (file->mapped){
+        munmap((void*)file->data, file->size);
+        file->data = NULL;
+        return;
     }
-    enum rebx_input_binary_messages warnings = REBX_INPUT_BINARY_WARNING_NONE;
-    // create manually so that default registered parameters not loaded
-    struct rebx_extras* rebx = malloc(sizeof(*rebx));
-    rebx_initialize(sim, rebx);
-    rebx_init_extras_from_binary(rebx, filename, &warnings);
-    
+#endif
+    free((void*)file->data);
+    file->data = NULL;
+}
+
+void rebx_init_extras_from_binary(struct rebx_extras* rebx, const char* const filename, enum rebx_input_binary_messages* warnings){
+    if (rebx->sim == NULL){
+        rebx_error(rebx, ""); // rebx_error gives meaningful err
+        return;
+    }
+    struct rebx_binary_file file;
+    if (!rebx_open_binary_file(filename, &file, warnings)){
+        return;
+    }
+    rebx_init_extras_from_buffer(rebx, file.data, file.size, warnings);
+    rebx_close_binary_file(&file);
+}
+
+void rebx_input_process_warnings(struct reb_simulation* const sim, enum rebx_input_binary_messages warnings){
     if (warnings & REBX_INPUT_BINARY_ERROR_NOFILE){
         reb_simulation_error(sim,"REBOUNDx: Cannot open binary file. Check filename.");
     }
@@ -701,6 +950,20 @@ struct rebx_extras* rebx_create_extras_from_binary(struct reb_simulation* sim, c
     if (warnings & REBX_INPUT_BINARY_WARNING_FORCE_PARAM_NOT_LOADED){
         reb_simulation_warning(sim,"REBOUNDx: A force parameter failed to load from the list of REBOUNDx implemented forces. Custom forces can't be saved to a REBOUNDx binary, and function points must be reset when a simulation is reloaded.");
     }
+}
+
+struct rebx_extras* rebx_create_extras_from_binary(struct reb_simulation* sim, const char* const filename){
+    if (sim == NULL){
+        fprintf(stderr, "REBOUNDx Error: Simulation pointer passed to rebx_create_extras_from_binary was NULL.\n");
+        return NULL;
+    }
+    enum rebx_input_binary_messages warnings = REBX_INPUT_BINARY_WARNING_NONE;
+    // create manually so that default registered parameters not loaded
+    struct rebx_extras* rebx = malloc(sizeof(*rebx));
+    rebx_initialize(sim, rebx);
+    rebx_init_extras_from_binary(rebx, filename, &warnings);
+    
+    rebx_input_process_warnings(sim, warnings);
     return rebx;
 }
 
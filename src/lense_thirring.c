@@ -62,10 +62,11 @@
 #include "rebound.h"
 #include "reboundx.h"
 
-static void rebx_calculate_LT_force(struct reb_simulation* const sim, struct reb_particle* const particles, const int N, const struct reb_vec3d Omega, const double I, const double C2){
+static void rebx_calculate_LT_force(struct reb_simulation* const sim, struct reb_particle* const particles, const int N, const struct reb_vec3d Omega, const double I, const double C2, struct reb_vec3d* const back_reactions){
     const double G = sim->G;
     const double gamma = 1.000021;   //hard-coded Eddington-Robertson-Shiff parameter for now
     const struct reb_particle source = particles[0]; // hard-code particles[0] as source particle
+#pragma omp parallel for
     for (int i=1; i<N; i++){
         const struct reb_particle p = particles[i];
         const double dx = p.x - source.x;
@@ -93,9 +94,15 @@ static void rebx_calculate_LT_force(struct reb_simulation* const sim, struct reb
         particles[i].ax += 2.*(Omega_y*dvz - Omega_z*dvy);
         particles[i].ay += 2.*(Omega_z*dvx - Omega_x*dvz);
         particles[i].az += 2.*(Omega_x*dvy - Omega_y*dvx);
-        particles[0].ax -= mratio * 2. * (Omega_y*dvz - Omega_z*dvy); 
-        particles[0].ay -= mratio * 2. * (Omega_z*dvx - Omega_x*dvz);
-        particles[0].az -= mratio * 2. * (Omega_x*dvy - Omega_y*dvx);
+        back_reactions[i].x = mratio * 2. * (Omega_y*dvz - Omega_z*dvy);
+        back_reactions[i].y = mratio * 2. * (Omega_z*dvx - Omega_x*dvz);
+        back_reactions[i].z = mratio * 2. * (Omega_x*dvy - Omega_y*dvx);
+    }
+    // Sum back reactions serially in index order so results don't depend on the number of threads
+    for (int i=1; i<N; i++){
+        particles[0].ax -= back_reactions[i].x;
+        particles[0].ay -= back_reactions[i].y;
+        particles[0].az -= back_reactions[i].z;
     }
 }
 
@@ -111,7 +118,11 @@ void rebx_lense_thirring(struct reb_simulation* const sim, struct rebx_force* co
     if (I != NULL){
         const struct reb_vec3d* Omega  = rebx_get_param(rebx, particles[0].ap, "Omega");
         if(Omega != NULL){
-            rebx_calculate_LT_force(sim, particles, N, *Omega, *I, C2);
+            struct reb_vec3d* const back_reactions = rebx_get_force_workspace(sim, force, N*sizeof(*back_reactions));
+            if (back_reactions == NULL){
+                return;
+            }
+            rebx_calculate_LT_force(sim, particles, N, *Omega, *I, C2, back_reactions);
         }
     }
 }
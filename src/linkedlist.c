@@ -68,7 +68,7 @@ int rebx_remove_node(struct rebx_node** head, const char* name){
 */
 
 // Pass head of linked list and a pointer to the node->object to remove (e.g. force)
-int rebx_remove_node(struct rebx_node** head, void* object){
+int rebx_remove_node(struct rebx_extras* rebx, struct rebx_node** head, void* object){
     if (*head == NULL){
         return 0;
     }
@@ -76,7 +76,7 @@ int rebx_remove_node(struct rebx_node** head, void* object){
     struct rebx_node* current = *head;
     if(current->object == object){ // edge case where force is first in list
         *head = current->next;
-        free(current);
+        rebx_arena_free(rebx, current, sizeof(*current));
         return 1;
     }
     
@@ -85,7 +85,7 @@ int rebx_remove_node(struct rebx_node** head, void* object){
     while (current != NULL){
         if(current->object == object){
             prev->next = current->next;
-            free(current);
+            rebx_arena_free(rebx, current, sizeof(*current));
             return 1;
         }
         prev = current;
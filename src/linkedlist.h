@@ -42,12 +42,13 @@ void rebx_add_node(struct rebx_node** head, struct rebx_node* node);
 struct rebx_node* rebx_get_node(struct rebx_node* head, const char* name);
 
 /**
- * @brief Removes node from linked list by name
- * @param head Pointer to the head of the linked list to be modified, e.g. &ps[1]->ap
- * @param name Name of the node to remove
+ * @brief Removes node holding object from linked list and returns it to the arena
+ * @param rebx Pointer to the rebx_extras instance the list belongs to
+ * @param head Pointer to the head of the linked list to be modified, e.g. &rebx->allocated_forces
+ * @param object Pointer to the object (e.g. force) whose node should be removed
  * @return 1 if node found and removed, 0 if not found
  */
-int rebx_remove_node(struct rebx_node** head, void* object);
+int rebx_remove_node(struct rebx_extras* rebx, struct rebx_node** head, void* object);
 
 /**
  * @brief Get length of linked list
@@ -62,11 +62,13 @@
 
 void rebx_modify_mass(struct reb_simulation* const sim, struct rebx_operator* const operator, const double dt){
     const int _N_real = sim->N - sim->N_var;
+    const struct rebx_param_column* const tau_mass = rebx_get_param_column(sim->extras, rebx_get_param_id(sim->extras, "tau_mass"), sim->particles, _N_real);
+    if (tau_mass == NULL){
+        return;
+    }
 	for(int i=0; i<_N_real; i++){
-		struct reb_particle* const p = &sim->particles[i];
-        const double* const tau_mass = rebx_get_param(sim->extras, p->ap, "tau_mass");
-        if (tau_mass != NULL){
-		    p->m += p->m*dt/(*tau_mass);
+        if (tau_mass->values[i] != NULL){
+		    sim->particles[i].m += sim->particles[i].m*dt/(*tau_mass->values[i]);
         }
 	}
     reb_simulation_move_to_com(sim);
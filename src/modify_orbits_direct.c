@@ -80,56 +80,85 @@
 #include "rebxtools.h"
 
 
-static struct reb_particle rebx_calculate_modify_orbits_direct(struct reb_simulation* const sim, struct rebx_operator* const operator, struct reb_particle* p, struct reb_particle* primary, const double dt){
+// Params resolved once per step by rebx_modify_orbits_direct and passed to each batch
+struct rebx_modify_orbits_direct_step{
+    const double* dedge;    // planet trap
+    const double* hedge;
+    const double* p_param;
+    int tau_a_id;
+    int tau_e_id;
+    int tau_inc_id;
+    int tau_omega_id;
+    int tau_Omega_id;
+};
+
+static void rebx_calculate_modify_orbits_direct(struct reb_simulation* const sim, struct rebx_operator* const operator, struct reb_particle* const particles, struct rebx_com_batch* const batch, const void* const context, const double dt){
     struct rebx_extras* const rebx = sim->extras;
-    int err=0;
-    struct reb_orbit o = reb_orbit_from_particle_err(sim->G, *p, *primary, &err);
-    if(err){        // mass of primary was 0 or p = primary.  Return same particle without doing anything.
-        return *p;
-    } 
+    const struct rebx_modify_orbits_direct_step* const step = context;
+    const double* const dedge = step->dedge;
+    const double* const hedge = step->hedge;
+    const double* const p_param = step->p_param;
+    const int tau_a_id = step->tau_a_id;
+    const int tau_e_id = step->tau_e_id;
+    const int tau_inc_id = step->tau_inc_id;
+    const int tau_omega_id = step->tau_omega_id;
+    const int tau_Omega_id = step->tau_Omega_id;
+
+#pragma omp parallel for if(batch->N > 1)
+    for (int k=0; k<batch->N; k++){
+        const struct reb_particle p = rebx_com_batch_particle(batch, k);
+        const struct reb_particle primary = rebx_com_batch_source(batch, k);
+        int err=0;
+        struct reb_orbit o = reb_orbit_from_particle_err(sim->G, p, primary, &err);
+        if(err){        // mass of primary was 0 or p = primary.  Leave particle unchanged.
+            continue;
+        } 
 
-    const double* const tau_a_ptr = rebx_get_param(rebx, p->ap, "tau_a");
-    const double* const tau_e = rebx_get_param(rebx, p->ap, "tau_e");
-    const double* const tau_inc = rebx_get_param(rebx, p->ap, "tau_inc");
-    const double* const tau_omega = rebx_get_param(rebx, p->ap, "tau_omega");
-    const double* const tau_Omega = rebx_get_param(rebx, p->ap, "tau_Omega");
+        struct rebx_node* const ap = particles[batch->indices[k]].ap;
+        const double* const tau_a_ptr = rebx_get_param_by_id(rebx, ap, tau_a_id);
+        const double* const tau_e = rebx_get_param_by_id(rebx, ap, tau_e_id);
+        const double* const tau_inc = rebx_get_param_by_id(rebx, ap, tau_inc_id);
+        const double* const tau_omega = rebx_get_param_by_id(rebx, ap, tau_omega_id);
+        const double* const tau_Omega = rebx_get_param_by_id(rebx, ap, tau_Omega_id);
 
-    //Implement the planet trap
-    double invtau_a = 0.0;   
-    const double* const dedge = rebx_get_param(sim->extras, operator->ap, "ide_position");
-    const double* const hedge = rebx_get_param(sim->extras, operator->ap, "ide_width");
-    
-    const double a0 = o.a;
-    const double e0 = o.e;
-    const double inc0 = o.inc;
+        double invtau_a = 0.0;   
+        const double a0 = o.a;
+        const double e0 = o.e;
+        const double inc0 = o.inc;
 
-	if(tau_a_ptr != NULL){
-        invtau_a = 1.0/(*tau_a_ptr);
-        if ((dedge!=NULL)&(hedge!=NULL)){
-            invtau_a *= rebx_calculate_planet_trap(a0, *dedge, *hedge);
+        if(tau_a_ptr != NULL){
+            invtau_a = 1.0/(*tau_a_ptr);
+            if ((dedge!=NULL)&(hedge!=NULL)){
+                invtau_a *= rebx_calculate_planet_trap(a0, *dedge, *hedge);
+            }
+            o.a += a0*dt*invtau_a;
         }
-    	o.a += a0*dt*invtau_a;
-	}
-	if(tau_e != NULL){
-    	o.e += e0*dt/(*tau_e);
-	}
-	if(tau_inc != NULL){
-    	o.inc += inc0*dt/(*tau_inc);
-	}
-	if(tau_omega != NULL){
-    	o.omega += 2.*M_PI*dt/(*tau_omega);
-	}
-    if(tau_Omega != NULL){
-		o.Omega += 2.*M_PI*dt/(*tau_Omega);
-	}
-   
-    if(tau_e != NULL){
-        const double* const p_param = rebx_get_param(sim->extras, operator->ap, "p");
-        if(p_param != NULL){
-			o.a += 2.*a0*e0*e0*(*p_param)*dt/(*tau_e); // Coupling term between e and a
-		}
+        if(tau_e != NULL){
+            o.e += e0*dt/(*tau_e);
+        }
+        if(tau_inc != NULL){
+            o.inc += inc0*dt/(*tau_inc);
+        }
+        if(tau_omega != NULL){
+            o.omega += 2.*M_PI*dt/(*tau_omega);
+        }
+        if(tau_Omega != NULL){
+            o.Omega += 2.*M_PI*dt/(*tau_Omega);
+        }
+       
+        if(tau_e != NULL){
+            if(p_param != NULL){
+                o.a += 2.*a0*e0*e0*(*p_param)*dt/(*tau_e); // Coupling term between e and a
+            }
+        }
+        const struct reb_particle modified = reb_particle_from_orbit(sim->G, primary, p.m, o.a, o.e, o.inc, o.Omega, o.omega, o.f);
+        batch->x[k] = modified.x;
+        batch->y[k] = modified.y;
+        batch->z[k] = modified.z;
+        batch->vx[k] = modified.vx;
+        batch->vy[k] = modified.vy;
+        batch->vz[k] = modified.vz;
     }
-    return reb_particle_from_orbit(sim->G, *primary, p->m, o.a, o.e, o.inc, o.Omega, o.omega, o.f);
 }
 
 void rebx_modify_orbits_direct(struct reb_simulation* const sim, struct rebx_operator* const operator, const double dt){
@@ -138,7 +167,17 @@ void rebx_modify_orbits_direct(struct reb_simulation* const sim, struct rebx_ope
 	if (ptr != NULL){
 		coordinates = *ptr;
 	}
+    struct rebx_extras* const rebx = sim->extras;
+    struct rebx_modify_orbits_direct_step step;
+    step.dedge = rebx_get_param(rebx, operator->ap, "ide_position");
+    step.hedge = rebx_get_param(rebx, operator->ap, "ide_width");
+    step.p_param = rebx_get_param(rebx, operator->ap, "p");
+    step.tau_a_id = rebx_get_param_id(rebx, "tau_a");
+    step.tau_e_id = rebx_get_param_id(rebx, "tau_e");
+    step.tau_inc_id = rebx_get_param_id(rebx, "tau_inc");
+    step.tau_omega_id = rebx_get_param_id(rebx, "tau_omega");
+    step.tau_Omega_id = rebx_get_param_id(rebx, "tau_Omega");
     const int back_reactions_inclusive = 1;
     const char* reference_name = "primary";
-    rebx_tools_com_ptm(sim, operator, coordinates, back_reactions_inclusive, reference_name, rebx_calculate_modify_orbits_direct, dt);
+    rebx_tools_com_ptm(sim, operator, coordinates, back_reactions_inclusive, reference_name, rebx_calculate_modify_orbits_direct, &step, dt);
 }
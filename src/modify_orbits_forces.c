@@ -74,66 +74,105 @@
 #include "reboundx.h"
 #include "rebxtools.h"
 
-static struct reb_vec3d rebx_calculate_modify_orbits_forces(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* p, struct reb_particle* source){
-    double invtau_a = 0.0;
-    double tau_e = INFINITY;
-    double tau_inc = INFINITY;
-    
-    const double* const tau_a_ptr = rebx_get_param(sim->extras, p->ap, "tau_a");
-    const double* const tau_e_ptr = rebx_get_param(sim->extras, p->ap, "tau_e");
-    const double* const tau_inc_ptr = rebx_get_param(sim->extras, p->ap, "tau_inc");
+struct rebx_modify_orbits_forces_plan{
+    enum REBX_COORDINATES coordinates;
+    int tau_a_id;
+    int tau_e_id;
+    int tau_inc_id;
+    int planet_trap;            // 1 if both ide_position and ide_width are set
+    double dedge;
+    double hedge;
+};
 
-    //Implement the planet trap
-    const double* const dedge = rebx_get_param(sim->extras, force->ap, "ide_position");
-    const double* const hedge = rebx_get_param(sim->extras, force->ap, "ide_width");
-
-    const double dvx = p->vx - source->vx;
-    const double dvy = p->vy - source->vy;
-    const double dvz = p->vz - source->vz;
-    const double dx = p->x-source->x;
-    const double dy = p->y-source->y;
-    const double dz = p->z-source->z;
-    const double r2 = dx*dx + dy*dy + dz*dz;
-    
-    if(tau_a_ptr != NULL){
-        invtau_a = 1.0/(*tau_a_ptr);
-        if ((dedge!=NULL)&(hedge!=NULL)){
-            int err=0;
-            struct reb_orbit o = reb_orbit_from_particle_err(sim->G, *p, *source, &err);
-            const double a0 = o.a;
-            invtau_a *= rebx_calculate_planet_trap(a0, *dedge, *hedge);
+int rebx_modify_orbits_forces_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_extras* const rebx = sim->extras;
+    if (force->plan == NULL){
+        force->plan = malloc(sizeof(struct rebx_modify_orbits_forces_plan));
+        if (force->plan == NULL){
+            reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+            return 0;
         }
     }
-    if(tau_e_ptr != NULL){
-        tau_e = *tau_e_ptr;
+    struct rebx_modify_orbits_forces_plan* const plan = force->plan;
+    const int* const ptr = rebx_get_param(rebx, force->ap, "coordinates");
+    plan->coordinates = REBX_COORDINATES_JACOBI; // Default
+    if (ptr != NULL){
+        plan->coordinates = *ptr;
     }
-    if(tau_inc_ptr != NULL){
-        tau_inc = *tau_inc_ptr;
+    plan->tau_a_id = rebx_get_param_id(rebx, "tau_a");
+    plan->tau_e_id = rebx_get_param_id(rebx, "tau_e");
+    plan->tau_inc_id = rebx_get_param_id(rebx, "tau_inc");
+
+    //Implement the planet trap
+    const double* const dedge = rebx_get_param(rebx, force->ap, "ide_position");
+    const double* const hedge = rebx_get_param(rebx, force->ap, "ide_width");
+    plan->planet_trap = (dedge != NULL && hedge != NULL);
+    plan->dedge = dedge ? *dedge : 0.;
+    plan->hedge = hedge ? *hedge : 0.;
+    return 1;
+}
+
+static void rebx_calculate_modify_orbits_forces(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, struct rebx_com_batch* const batch){
+    struct rebx_extras* const rebx = sim->extras;
+    const struct rebx_modify_orbits_forces_plan* const plan = force->plan;
+    if (plan->planet_trap){
+        rebx_com_batch_orbits(sim, batch, REBX_ORBIT_A);
     }
-    
-    struct reb_vec3d a = {0};
+#pragma omp parallel for
+    for (int k=0; k<batch->N; k++){
+        struct rebx_node* const ap = particles[batch->indices[k]].ap;
+        double invtau_a = 0.0;
+        double tau_e = INFINITY;
+        double tau_inc = INFINITY;
+        
+        const double* const tau_a_ptr = rebx_get_param_by_id(rebx, ap, plan->tau_a_id);
+        const double* const tau_e_ptr = rebx_get_param_by_id(rebx, ap, plan->tau_e_id);
+        const double* const tau_inc_ptr = rebx_get_param_by_id(rebx, ap, plan->tau_inc_id);
 
-    a.x =  dvx*invtau_a/(2.);
-    a.y =  dvy*invtau_a/(2.);
-    a.z =  dvz*invtau_a/(2.);
+        const double dvx = batch->vx[k] - batch->source_vx[k];
+        const double dvy = batch->vy[k] - batch->source_vy[k];
+        const double dvz = batch->vz[k] - batch->source_vz[k];
+        const double dx = batch->x[k] - batch->source_x[k];
+        const double dy = batch->y[k] - batch->source_y[k];
+        const double dz = batch->z[k] - batch->source_z[k];
+        const double r2 = dx*dx + dy*dy + dz*dz;
+        
+        if(tau_a_ptr != NULL){
+            invtau_a = 1.0/(*tau_a_ptr);
+            if (plan->planet_trap){
+                invtau_a *= rebx_calculate_planet_trap(batch->a[k], plan->dedge, plan->hedge);
+            }
+        }
+        if(tau_e_ptr != NULL){
+            tau_e = *tau_e_ptr;
+        }
+        if(tau_inc_ptr != NULL){
+            tau_inc = *tau_inc_ptr;
+        }
+        
+        double ax = dvx*invtau_a/(2.);
+        double ay = dvy*invtau_a/(2.);
+        double az = dvz*invtau_a/(2.);
 
-    if (tau_e < INFINITY || tau_inc < INFINITY){
-        const double vdotr = dx*dvx + dy*dvy + dz*dvz;
-        const double prefac = 2*vdotr/r2/tau_e;
-        a.x += prefac*dx;
-        a.y += prefac*dy;
-        a.z += prefac*dz + 2.*dvz/tau_inc;
+        if (tau_e < INFINITY || tau_inc < INFINITY){
+            const double vdotr = dx*dvx + dy*dvy + dz*dvz;
+            const double prefac = 2*vdotr/r2/tau_e;
+            ax += prefac*dx;
+            ay += prefac*dy;
+            az += prefac*dz + 2.*dvz/tau_inc;
+        }
+        batch->ax[k] = ax;
+        batch->ay[k] = ay;
+        batch->az[k] = az;
     }
-    return a;
 }
 
 void rebx_modify_orbits_forces(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
-    int* ptr = rebx_get_param(sim->extras, force->ap, "coordinates");
-    enum REBX_COORDINATES coordinates = REBX_COORDINATES_JACOBI; // Default
-    if (ptr != NULL){
-        coordinates = *ptr;
+    const struct rebx_modify_orbits_forces_plan* const plan = rebx_get_force_plan(sim, force, particles, N);
+    if (plan == NULL){
+        return;
     }
     const int back_reactions_inclusive = 1;
     const char* reference_name = "primary";
-    rebx_com_force(sim, force, coordinates, back_reactions_inclusive, reference_name, rebx_calculate_modify_orbits_forces, particles, N);
+    rebx_com_force(sim, force, plan->coordinates, back_reactions_inclusive, reference_name, rebx_calculate_modify_orbits_forces, particles, N);
 }
@@ -0,0 +1,293 @@
+/**
+ * @file    orbit_cache.c
+ * @brief   Orbital elements shared between effects within one evaluation of the forces.
+ * @author  Dan Tamayo <tamayo.daniel@gmail.com>
+ *
+ * @section LICENSE
+ * Copyright (c) 2015 Dan Tamayo, Hanno Rein
+ *
+ * This file is part of reboundx.
+ *
+ * reboundx is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * reboundx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rebound.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Elements are keyed by particle index, coordinate system (and reference particle) of the sources, and evaluation.
+ * Within one evaluation of the forces the particles don't move, and rebx_com_force builds the same sources for
+ * every force using the same coordinate system, so the elements one force calculates are valid for all the others.
+ * Rather than clearing the cache, each particle's elements are stamped with the evaluation they were calculated in,
+ * so bumping the evaluation counter makes them all stale in O(1).
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "rebound.h"
+#include "reboundx.h"
+#include "core.h"
+
+#define REBX_ORBIT_TINY 1.e-308     // Same cutoff as REBOUND uses for reb_orbit_from_particle
+
+int rebx_enable_orbit_cache(struct rebx_extras* const rebx){
+    if (rebx->orbit_cache != NULL){
+        return 1;
+    }
+    struct rebx_orbit_cache* const cache = rebx_malloc(rebx, sizeof(*cache));
+    if (cache == NULL){
+        return 0;
+    }
+    cache->evaluation = 1;      // frames start with all stamps 0, i.e. stale
+    cache->uses = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    for (int j=0; j<REBX_ORBIT_CACHE_N_FRAMES; j++){
+        struct rebx_orbit_frame* const frame = &cache->frames[j];
+        frame->coordinates = REBX_COORDINATES_JACOBI;
+        frame->refindex = -1;
+        frame->last_used = 0;
+        frame->N_allocated = 0;
+        frame->evaluations = NULL;
+        frame->computed = NULL;
+        frame->a = NULL;
+        frame->e = NULL;
+        frame->inc = NULL;
+        frame->P = NULL;
+    }
+    rebx->orbit_cache = cache;
+    return 1;
+}
+
+void rebx_disable_orbit_cache(struct rebx_extras* const rebx){
+    struct rebx_orbit_cache* const cache = rebx->orbit_cache;
+    if (cache == NULL){
+        return;
+    }
+    for (int j=0; j<REBX_ORBIT_CACHE_N_FRAMES; j++){
+        struct rebx_orbit_frame* const frame = &cache->frames[j];
+        free(frame->evaluations);
+        free(frame->computed);
+        free(frame->a);
+        free(frame->e);
+        free(frame->inc);
+        free(frame->P);
+    }
+    free(cache);
+    rebx->orbit_cache = NULL;
+}
+
+void rebx_invalidate_orbit_cache(struct rebx_extras* const rebx){
+    if (rebx->orbit_cache != NULL){
+        rebx->orbit_cache->evaluation++;
+    }
+}
+
+// Returns the frame for the passed sources with room for N particles, replacing the least recently used one if there is none yet. NULL if out of memory.
+static struct rebx_orbit_frame* rebx_get_orbit_frame(struct rebx_extras* const rebx, struct rebx_orbit_cache* const cache, const int coordinates, const int refindex, const int N){
+    struct rebx_orbit_frame* frame = NULL;
+    for (int j=0; j<REBX_ORBIT_CACHE_N_FRAMES; j++){
+        struct rebx_orbit_frame* const candidate = &cache->frames[j];
+        if (candidate->last_used != 0 && candidate->coordinates == coordinates && candidate->refindex == refindex){
+            frame = candidate;
+            break;
+        }
+    }
+    if (frame == NULL){
+        frame = &cache->frames[0];
+        for (int j=1; j<REBX_ORBIT_CACHE_N_FRAMES; j++){
+            if (cache->frames[j].last_used < frame->last_used){
+                frame = &cache->frames[j];
+            }
+        }
+        frame->coordinates = coordinates;
+        frame->refindex = refindex;
+        for (int i=0; i<frame->N_allocated; i++){
+            frame->evaluations[i] = 0;
+        }
+    }
+
+    if (N > frame->N_allocated){
+        unsigned long* evaluations = realloc(frame->evaluations, N*sizeof(*evaluations));
+        unsigned int* computed = realloc(frame->computed, N*sizeof(*computed));
+        double* a = realloc(frame->a, N*sizeof(*a));
+        double* e = realloc(frame->e, N*sizeof(*e));
+        double* inc = realloc(frame->inc, N*sizeof(*inc));
+        double* P = realloc(frame->P, N*sizeof(*P));
+        if (evaluations) frame->evaluations = evaluations;
+        if (computed) frame->computed = computed;
+        if (a) frame->a = a;
+        if (e) frame->e = e;
+        if (inc) frame->inc = inc;
+        if (P) frame->P = P;
+        if (evaluations == NULL || computed == NULL || a == NULL || e == NULL || inc == NULL || P == NULL){
+            frame->last_used = 0;
+            rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+            return NULL;
+        }
+        for (int i=frame->N_allocated; i<N; i++){
+            frame->evaluations[i] = 0;
+        }
+        frame->N_allocated = N;
+    }
+    frame->last_used = ++cache->uses;
+    return frame;
+}
+
+/*
+ * Same formulas as reb_orbit_from_particle, but over the arrays of a batch, with one loop per group of elements
+ * so that only the requested ones are calculated and the compiler can vectorize each loop. The loops are branch
+ * free so that they vectorize when sqrt doesn't have to set errno (-fno-math-errno), and the inclination one
+ * also needs a vector acos (e.g. glibc's libmvec with -ffast-math). Particles REBOUND can't calculate an orbit
+ * for (source without mass, or at the source's position) get NaN elements like there, by adding NaN.
+ */
+static void rebx_com_batch_elements(const double G, struct rebx_com_batch* const batch, const unsigned int elements){
+    const int N = batch->N;
+    const double* const m = batch->m;
+    const double* const x = batch->x;
+    const double* const y = batch->y;
+    const double* const z = batch->z;
+    const double* const vx = batch->vx;
+    const double* const vy = batch->vy;
+    const double* const vz = batch->vz;
+    const double* const source_m = batch->source_m;
+    const double* const source_x = batch->source_x;
+    const double* const source_y = batch->source_y;
+    const double* const source_z = batch->source_z;
+    const double* const source_vx = batch->source_vx;
+    const double* const source_vy = batch->source_vy;
+    const double* const source_vz = batch->source_vz;
+    double* const a = batch->a;
+    double* const e = batch->e;
+    double* const inc = batch->inc;
+    double* const P = batch->P;
+
+    if (elements & (REBX_ORBIT_A | REBX_ORBIT_P)){
+#pragma omp simd
+        for (int k=0; k<N; k++){
+            const double mu = G*(m[k] + source_m[k]);
+            const double dx = x[k] - source_x[k];
+            const double dy = y[k] - source_y[k];
+            const double dz = z[k] - source_z[k];
+            const double dvx = vx[k] - source_vx[k];
+            const double dvy = vy[k] - source_vy[k];
+            const double dvz = vz[k] - source_vz[k];
+            const double d = sqrt(dx*dx + dy*dy + dz*dz);
+            const double vsquared = dvx*dvx + dvy*dvy + dvz*dvz;
+            const double vcircsquared = mu/d;
+            const double ak = -mu/(vsquared - 2.*vcircsquared);
+            const double n = ak/fabs(ak)*sqrt(fabs(mu/(ak*ak*ak)));
+            const double invalid = ((source_m[k] > REBX_ORBIT_TINY) & (d > REBX_ORBIT_TINY)) ? 0. : NAN;
+            a[k] = ak + invalid;
+            P[k] = 2*M_PI/n + invalid;
+        }
+    }
+    if (elements & REBX_ORBIT_E){
+#pragma omp simd
+        for (int k=0; k<N; k++){
+            const double mu = G*(m[k] + source_m[k]);
+            const double dx = x[k] - source_x[k];
+            const double dy = y[k] - source_y[k];
+            const double dz = z[k] - source_z[k];
+            const double dvx = vx[k] - source_vx[k];
+            const double dvy = vy[k] - source_vy[k];
+            const double dvz = vz[k] - source_vz[k];
+            const double d = sqrt(dx*dx + dy*dy + dz*dz);
+            const double vsquared = dvx*dvx + dvy*dvy + dvz*dvz;
+            const double vcircsquared = mu/d;
+            const double vdiffsquared = vsquared - vcircsquared;
+            const double vr = (dx*dvx + dy*dvy + dz*dvz)/d;
+            const double rvr = d*vr;
+            const double muinv = 1./mu;
+            const double ex = muinv*(vdiffsquared*dx - rvr*dvx);
+            const double ey = muinv*(vdiffsquared*dy - rvr*dvy);
+            const double ez = muinv*(vdiffsquared*dz - rvr*dvz);
+            const double invalid = ((source_m[k] > REBX_ORBIT_TINY) & (d > REBX_ORBIT_TINY)) ? 0. : NAN;
+            e[k] = sqrt(ex*ex + ey*ey + ez*ez) + invalid;
+        }
+    }
+    if (elements & REBX_ORBIT_INC){
+#pragma omp simd
+        for (int k=0; k<N; k++){
+            const double dx = x[k] - source_x[k];
+            const double dy = y[k] - source_y[k];
+            const double dz = z[k] - source_z[k];
+            const double dvx = vx[k] - source_vx[k];
+            const double dvy = vy[k] - source_vy[k];
+            const double dvz = vz[k] - source_vz[k];
+            const double d = sqrt(dx*dx + dy*dy + dz*dz);
+            const double hx = dy*dvz - dz*dvy;
+            const double hy = dz*dvx - dx*dvz;
+            const double hz = dx*dvy - dy*dvx;
+            const double h = sqrt(hx*hx + hy*hy + hz*hz);
+            const double cosine = hz/h;
+            const double invalid = ((source_m[k] > REBX_ORBIT_TINY) & (d > REBX_ORBIT_TINY)) ? 0. : NAN;
+            inc[k] = acos(fmax(-1., fmin(1., cosine))) + invalid;  // clamped like acos2 in REBOUND (0 if h=0)
+        }
+    }
+}
+
+void rebx_com_batch_orbits(struct reb_simulation* const sim, struct rebx_com_batch* const batch, const unsigned int elements){
+    struct rebx_extras* const rebx = sim->extras;
+    struct rebx_orbit_cache* const cache = rebx->orbit_cache;
+    struct rebx_orbit_frame* const frame = (cache != NULL && batch->cacheable) ? rebx_get_orbit_frame(rebx, cache, batch->coordinates, batch->refindex, sim->N) : NULL;
+    if (frame == NULL){
+        // Without the cache, each particle's orbit comes from REBOUND as before
+#pragma omp parallel for
+        for (int k=0; k<batch->N; k++){
+            int err=0;
+            const struct reb_orbit o = reb_orbit_from_particle_err(sim->G, rebx_com_batch_particle(batch, k), rebx_com_batch_source(batch, k), &err);
+            batch->a[k] = o.a;
+            batch->e[k] = o.e;
+            batch->inc[k] = o.inc;
+            batch->P[k] = o.P;
+        }
+        return;
+    }
+
+    // Effects in the same coordinate system act on mostly the same particles, so if any particle misses an element, calculate it for the whole batch
+    unsigned int missing = 0;
+    for (int k=0; k<batch->N; k++){
+        const int i = batch->indices[k];
+        const unsigned int found = (frame->evaluations[i] == cache->evaluation) ? (frame->computed[i] & elements) : 0;
+        if (found == elements){
+            cache->hits++;
+        }
+        else{
+            cache->misses++;
+            missing |= elements & ~found;
+        }
+    }
+    if (missing){
+        rebx_com_batch_elements(sim->G, batch, missing);
+        if (missing & (REBX_ORBIT_A | REBX_ORBIT_P)){
+            missing |= REBX_ORBIT_A | REBX_ORBIT_P; // calculated together
+        }
+    }
+
+    for (int k=0; k<batch->N; k++){
+        const int i = batch->indices[k];
+        if (frame->evaluations[i] != cache->evaluation){
+            frame->evaluations[i] = cache->evaluation;
+            frame->computed[i] = 0;
+        }
+        if (missing & REBX_ORBIT_A) frame->a[i] = batch->a[k];
+        if (missing & REBX_ORBIT_E) frame->e[i] = batch->e[k];
+        if (missing & REBX_ORBIT_INC) frame->inc[i] = batch->inc[k];
+        if (missing & REBX_ORBIT_P) frame->P[i] = batch->P[k];
+        frame->computed[i] |= missing;
+        if (elements & REBX_ORBIT_A) batch->a[k] = frame->a[i];
+        if (elements & REBX_ORBIT_E) batch->e[k] = frame->e[i];
+        if (elements & REBX_ORBIT_INC) batch->inc[k] = frame->inc[i];
+        if (elements & REBX_ORBIT_P) batch->P[k] = frame->P[i];
+    }
+}
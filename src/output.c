@@ -24,6 +24,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "reboundx.h"
 #include "core.h"
@@ -80,8 +81,59 @@
  SNAPSHOT {type=SNAPSHOT, size=skip_to_next_snapshot}
  ...
  END (SNAPSHOT)
+ 
+ Each object's size is measured with a dry run of its writer before its header goes out, so the binary is emitted in a single forward pass and can be sent to any sink (a file, a pipe, a user callback or a memory buffer) without seeking back to patch sizes. The dry run of an object doesn't measure the objects nested inside it separately (their header size is fixed), so the total cost is linear in the output size times the nesting depth.
 */
 
+/************************************************************
+Writers and sinks
+*************************************************************/
+
+struct rebx_writer{
+    size_t (*write)(const void* data, size_t size, void* context);  // NULL for dry runs that only measure sizes
+    void* context;
+    long position;                                                  // Bytes written (or measured) so far
+    int error;                                                      // Set if the sink failed or memory ran out
+};
+
+static void rebx_writer_put(struct rebx_writer* const w, const void* data, const size_t size){
+    if (w->write != NULL && size > 0 && !w->error){
+        if (w->write(data, size, w->context) != size){
+            w->error = 1;
+        }
+    }
+    w->position += size;
+}
+
+// Padding in the field struct is zeroed so that identical states give identical binaries
+static void rebx_writer_put_field(struct rebx_writer* const w, const enum rebx_binary_field_type type, const long size){
+    struct rebx_binary_field field;
+    memset(&field, 0, sizeof(field));
+    field.type = type;
+    field.size = size;
+    rebx_writer_put(w, &field, sizeof(field));
+}
+
+static size_t rebx_write_to_file(const void* data, size_t size, void* context){
+    return fwrite(data, 1, size, context);
+}
+
+struct rebx_memory_sink{
+    char* buffer;
+    size_t size;
+    size_t position;
+};
+
+static size_t rebx_write_to_memory(const void* data, size_t size, void* context){
+    struct rebx_memory_sink* const sink = context;
+    if (sink->position + size > sink->size){
+        return 0;
+    }
+    memcpy(sink->buffer + sink->position, data, size);
+    sink->position += size;
+    return size;
+}
+
 /************************************************************
 Macros to remove repetition in writing fields.
 *************************************************************/
@@ -89,204 +141,286 @@ Macros to remove repetition in writing fields.
 // Write a data field of binary_field_type typename with size typesize
 // valueptr is a pointer to the memory to write
 #define REBX_WRITE_DATA_FIELD(typename, valueptr, typesize) {\
-struct rebx_binary_field field = {.type = REBX_BINARY_FIELD_TYPE_##typename, .size=typesize};\
-fwrite(&field, sizeof(field), 1, of);\
-fwrite(valueptr,typesize,1,of);\
-}
-
-/*  For the arbitrary objects, we write a preliminary field struct without a size (since we don't know it yet), and cache the file position to measure how large the object is later.*/
-#define REBX_START_OBJECT_FIELD(name, typename)\
-long pos_start_header_##name = ftell(of);\
-struct rebx_binary_field header_##name = {.type = REBX_BINARY_FIELD_TYPE_##typename, .size=0};\
-fwrite(&header_##name, sizeof(header_##name), 1, of);\
-long pos_start_##name = ftell(of);\
-
-/*  After we write all the data we need for the particular object, we calculate how long this segment is, and update the field struct with this size so we have option of skipping the whole object when reading.*/
-
-#define REBX_END_OBJECT_FIELD(name) {\
-REBX_WRITE_DATA_FIELD(END,        NULL,             0);\
-long pos_end_##name = ftell(of);\
-header_##name.size = pos_end_##name - pos_start_##name;\
-fseek(of, pos_start_header_##name, SEEK_SET);\
-fwrite(&header_##name, sizeof(header_##name), 1, of);\
-fseek(of, 0, SEEK_END);\
+rebx_writer_put_field(w, REBX_BINARY_FIELD_TYPE_##typename, typesize);\
+rebx_writer_put(w, valueptr, typesize);\
 }
 
 /*  Write a list of listtype (e.g., ALLOCATED_FORCES) with nodes of type nodetype (e.g. ALLOCATED_FORCE), to the passed linkedlist (e.g. rebx->allocated_forces)*/
 
 #define REBX_WRITE_LIST_FIELD(listtype, nodetype, linkedlist) {\
-REBX_START_OBJECT_FIELD(list, listtype);\
-rebx_write_list(rebx, REBX_BINARY_FIELD_TYPE_##nodetype, linkedlist, of);\
-REBX_END_OBJECT_FIELD(list);\
+const struct rebx_list_object list = {.node_type = REBX_BINARY_FIELD_TYPE_##nodetype, .list = linkedlist};\
+rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_##listtype, rebx_write_list_contents, &list, w);\
 }
 
-static void rebx_write_list(struct rebx_extras* rebx, enum rebx_binary_field_type list_type, struct rebx_node* list, FILE* of);
+/*  Arbitrary objects are written as a header with their size, their contents, and an END field. The contents are written by a function of this type.*/
+typedef void (*rebx_write_contents)(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w);
+
+static void rebx_write_object(struct rebx_extras* rebx, enum rebx_binary_field_type type, rebx_write_contents contents, const void* object, struct rebx_writer* const w){
+    long size = 0;
+    if (w->write != NULL){
+        // The size covers the contents and the END field, so readers can skip the whole object
+        struct rebx_writer measure = {.write = NULL};
+        contents(rebx, object, &measure);
+        if (measure.error){
+            w->error = 1;
+            return;
+        }
+        size = measure.position + sizeof(struct rebx_binary_field);
+    }
+    rebx_writer_put_field(w, type, size);
+    contents(rebx, object, w);
+    REBX_WRITE_DATA_FIELD(END,        NULL,             0);
+}
+
+struct rebx_list_object{
+    enum rebx_binary_field_type node_type;
+    struct rebx_node* list;
+};
+
+static void rebx_write_list(struct rebx_extras* rebx, enum rebx_binary_field_type list_type, struct rebx_node* list, struct rebx_writer* const w);
+
+static void rebx_write_list_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_list_object* const list = object;
+    rebx_write_list(rebx, list->node_type, list->list, w);
+}
 
-static void rebx_write_force_param(struct rebx_extras* rebx, struct rebx_param* param, FILE* of){
-    REBX_START_OBJECT_FIELD(force_param, PARAM);
+// Params are written from their node (see rebx_create_param_node), whose object is the registered param
+static void rebx_write_force_param_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_param* const param = ((const struct rebx_node*)object)->object;
     REBX_WRITE_DATA_FIELD(PARAM_TYPE, &param->type,     sizeof(param->type));
     REBX_WRITE_DATA_FIELD(NAME,       param->name,      strlen(param->name) + 1);
-    struct rebx_force* force = param->value;
+    const struct rebx_force* force = rebx_param_node_value(object);
     REBX_WRITE_DATA_FIELD(PARAM_VALUE,      force->name,      strlen(force->name) + 1);
-    REBX_END_OBJECT_FIELD(force_param);
 }
 
-static void rebx_write_param(struct rebx_extras* rebx, struct rebx_param* param, FILE* of){
+static void rebx_write_param_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_param* const param = ((const struct rebx_node*)object)->object;
+    REBX_WRITE_DATA_FIELD(PARAM_TYPE, &param->type,     sizeof(param->type));
+    REBX_WRITE_DATA_FIELD(NAME,       param->name,      strlen(param->name) + 1);
+    REBX_WRITE_DATA_FIELD(PARAM_VALUE,      rebx_param_node_value(object),     rebx_sizeof(rebx, param->type));
+}
+
+static void rebx_write_param(struct rebx_extras* rebx, struct rebx_node* node, struct rebx_writer* const w){
+    const struct rebx_param* const param = node->object;
     if (param->type == REBX_TYPE_POINTER){ // Don't write pointers because we won't know how to load them when we read binary. Need to add type to store in binaries.
         return;
     }
     
     if (param->type == REBX_TYPE_FORCE){ // Force already written to allocated_force list. For parce PARAMETERS we agree to store force name in param->value so that the reallocated force can be linked up when we read binary
-        rebx_write_force_param(rebx, param, of);
+        rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_PARAM, rebx_write_force_param_contents, node, w);
         return;
     }
-    REBX_START_OBJECT_FIELD(param, PARAM);
-    REBX_WRITE_DATA_FIELD(PARAM_TYPE, &param->type,     sizeof(param->type));
-    REBX_WRITE_DATA_FIELD(NAME,       param->name,      strlen(param->name) + 1);
-    REBX_WRITE_DATA_FIELD(PARAM_VALUE,      param->value,     rebx_sizeof(rebx, param->type));
-    REBX_END_OBJECT_FIELD(param);
+    rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_PARAM, rebx_write_param_contents, node, w);
 }
 
-static void rebx_write_registered_param(struct rebx_extras* rebx, struct rebx_param* param, FILE* of){
-    REBX_START_OBJECT_FIELD(registered_param, REGISTERED_PARAM);
+static void rebx_write_registered_param_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_param* const param = object;
     REBX_WRITE_DATA_FIELD(PARAM_TYPE, &param->type,     sizeof(param->type));
     REBX_WRITE_DATA_FIELD(NAME,       param->name,      strlen(param->name) + 1);
-    REBX_END_OBJECT_FIELD(registered_param);
 }
 
-static void rebx_write_force(struct rebx_extras* rebx, struct rebx_force* force, FILE* of){
-    REBX_START_OBJECT_FIELD(force, FORCE);
+static void rebx_write_force_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_force* const force = object;
     // must write name first so that force can be loaded on read
     REBX_WRITE_DATA_FIELD(NAME, force->name, strlen(force->name) + 1);
     REBX_WRITE_LIST_FIELD(PARAM_LIST, PARAM, force->ap);
-    REBX_END_OBJECT_FIELD(force);
 }
 
 // Same as force, but only holds the name for later loading, rather than the whole parameter list
-static void rebx_write_additional_force(struct rebx_extras* rebx, struct rebx_force* force, FILE* of){
-    REBX_START_OBJECT_FIELD(additional_force, ADDITIONAL_FORCE);
+static void rebx_write_additional_force_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_force* const force = object;
     REBX_WRITE_DATA_FIELD(NAME, force->name, strlen(force->name) + 1);
-    REBX_END_OBJECT_FIELD(additional_force);
 }
 
-static void rebx_write_operator(struct rebx_extras* rebx, struct rebx_operator* operator, FILE* of){
-    REBX_START_OBJECT_FIELD(operator, OPERATOR);
+static void rebx_write_operator_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_operator* const operator = object;
     REBX_WRITE_DATA_FIELD(NAME, operator->name, strlen(operator->name) + 1);
     REBX_WRITE_LIST_FIELD(PARAM_LIST, PARAM, operator->ap);
-    REBX_END_OBJECT_FIELD(operator);
 }
 
-static void rebx_write_step(struct rebx_extras* rebx, struct rebx_step* step, FILE* of){
-    REBX_START_OBJECT_FIELD(step, STEP);
+static void rebx_write_step_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct rebx_step* const step = object;
     // Need operator name to load it from source when reading it back in
     REBX_WRITE_DATA_FIELD(NAME, step->operator->name,   strlen(step->operator->name) + 1);
     REBX_WRITE_DATA_FIELD(STEP_DT_FRACTION,   &step->dt_fraction,     sizeof(step->dt_fraction));
-    REBX_END_OBJECT_FIELD(step);
 }
 
-static void rebx_write_particle(struct rebx_extras* rebx, struct reb_particle* particle, int index, FILE* of){
-    REBX_START_OBJECT_FIELD(particle, PARTICLE);
+static void rebx_write_particle_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    const struct reb_particle* const particle = object;
+    const int index = (int)(particle - rebx->sim->particles);
     REBX_WRITE_DATA_FIELD(PARTICLE_INDEX,    &index, sizeof(index));
     REBX_WRITE_LIST_FIELD(PARAM_LIST, PARAM, particle->ap);
-    REBX_END_OBJECT_FIELD(particle);
 }
 
-static void rebx_write_rebx(struct rebx_extras* rebx, FILE* of){
-    REBX_START_OBJECT_FIELD(rebx_structure, REBX_STRUCTURE);
-    REBX_WRITE_LIST_FIELD(REGISTERED_PARAMETERS, REGISTERED_PARAM, rebx->registered_params);
+static void rebx_write_registered_params_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    for (int id=0; id<rebx->N_registered_params; id++){ // includes built-in params, so that readers don't need to know them
+        rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_REGISTERED_PARAM, rebx_write_registered_param_contents, rebx_get_registered_param(rebx, id), w);
+    }
+}
+
+static void rebx_write_rebx_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_REGISTERED_PARAMETERS, rebx_write_registered_params_contents, NULL, w);
     REBX_WRITE_LIST_FIELD(ALLOCATED_FORCES, FORCE, rebx->allocated_forces);
     REBX_WRITE_LIST_FIELD(ALLOCATED_OPERATORS, OPERATOR, rebx->allocated_operators);
     REBX_WRITE_LIST_FIELD(ADDITIONAL_FORCES, ADDITIONAL_FORCE, rebx->additional_forces);
     REBX_WRITE_LIST_FIELD(PRE_TIMESTEP_MODIFICATIONS, STEP, rebx->pre_timestep_modifications);
     REBX_WRITE_LIST_FIELD(POST_TIMESTEP_MODIFICATIONS, STEP, rebx->post_timestep_modifications);
-    REBX_END_OBJECT_FIELD(rebx_structure);
 }
 
 // Write a particle field for each particle with a list of its parameters
-static void rebx_write_particles(struct rebx_extras* rebx, FILE* of){
-    struct reb_simulation* sim = rebx->sim; // checked sim valid in output_binray
-    
-    REBX_START_OBJECT_FIELD(particle_list, PARTICLES);
+static void rebx_write_particles_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    struct reb_simulation* sim = rebx->sim; // checked sim valid in rebx_write_binary
     for (int i=0; i<sim->N; i++){
-        rebx_write_particle(rebx, &sim->particles[i], i, of);
+        rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_PARTICLE, rebx_write_particle_contents, &sim->particles[i], w);
     }
-    REBX_END_OBJECT_FIELD(particle_list);
 }
 
-static void rebx_write_list(struct rebx_extras* rebx, enum rebx_binary_field_type list_type, struct rebx_node* list, FILE* of){
-    
-    int N = rebx_len(list);
-    while (N > 0){
-        struct rebx_node* current = list;
-        for(int i=0;i<N-1;i++){
-            current=current->next;
+#define REBX_WRITE_LIST_N_STACK 64  // Lists up to this length are reversed without allocating
+
+static void rebx_write_list(struct rebx_extras* rebx, enum rebx_binary_field_type list_type, struct rebx_node* list, struct rebx_writer* const w){
+    // Nodes are added at the head, so write them from the tail to restore the order in which they were added on read.
+    // Collect them in one pass rather than walking to the Nth node for each one.
+    struct rebx_node* stack_nodes[REBX_WRITE_LIST_N_STACK];
+    struct rebx_node** nodes = stack_nodes;
+    const int N = rebx_len(list);
+    if (N > REBX_WRITE_LIST_N_STACK){
+        nodes = malloc(N*sizeof(*nodes));
+        if (nodes == NULL){
+            w->error = 1;
+            return;
         }
+    }
+    int n = 0;
+    for (struct rebx_node* current = list; current != NULL; current = current->next){
+        nodes[n++] = current;
+    }
+    for (int i=N-1; i>=0; i--){
+        struct rebx_node* current = nodes[i];
         switch(list_type){
             case REBX_BINARY_FIELD_TYPE_REGISTERED_PARAM:
             {
-                rebx_write_registered_param(rebx, current->object, of);
+                rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_REGISTERED_PARAM, rebx_write_registered_param_contents, current->object, w);
                 break;
             }
             case REBX_BINARY_FIELD_TYPE_FORCE:
             {
-                rebx_write_force(rebx, current->object, of);
+                rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_FORCE, rebx_write_force_contents, current->object, w);
                 break;
             }
             case REBX_BINARY_FIELD_TYPE_ADDITIONAL_FORCE:
             {
-                rebx_write_additional_force(rebx, current->object, of);
+                rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_ADDITIONAL_FORCE, rebx_write_additional_force_contents, current->object, w);
                 break;
             }
             case REBX_BINARY_FIELD_TYPE_OPERATOR:
             {
-                rebx_write_operator(rebx, current->object, of);
+                rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_OPERATOR, rebx_write_operator_contents, current->object, w);
                 break;
             }
             case REBX_BINARY_FIELD_TYPE_PARAM:
             {
-                rebx_write_param(rebx, current->object, of);
+                rebx_write_param(rebx, current, w);
                 break;
             }
             case REBX_BINARY_FIELD_TYPE_STEP:
             {
-                rebx_write_step(rebx, current->object, of);
+                rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_STEP, rebx_write_step_contents, current->object, w);
                 break;
             }
             default:
                 // Should implement a check for other types here
                 break;
         }
-        N--;
+    }
+    if (nodes != stack_nodes){
+        free(nodes);
     }
 }
 
-// Could be extended to include time or steps_done to make an archive
-static void rebx_write_snapshot(struct rebx_extras* rebx, FILE* of){
-    REBX_START_OBJECT_FIELD(snapshot, SNAPSHOT);
-    rebx_write_rebx(rebx, of);
-    rebx_write_particles(rebx, of);
-    REBX_END_OBJECT_FIELD(snapshot);
+// Time and steps_done identify the snapshot in archives (see archive.c)
+static void rebx_write_snapshot_contents(struct rebx_extras* rebx, const void* object, struct rebx_writer* const w){
+    REBX_WRITE_DATA_FIELD(SNAPSHOT_T,           &rebx->sim->t,              sizeof(rebx->sim->t));
+    REBX_WRITE_DATA_FIELD(SNAPSHOT_STEPS_DONE,  &rebx->sim->steps_done,     sizeof(rebx->sim->steps_done));
+    rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_REBX_STRUCTURE, rebx_write_rebx_contents, NULL, w);
+    rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_PARTICLES, rebx_write_particles_contents, NULL, w);
 }
 
-void rebx_output_binary(struct rebx_extras* rebx, char* filename){
-    FILE* of = fopen(filename,"wb");
-    if (of==NULL){
-        rebx_error(rebx, "REBOUNDx error: Can not open file passed to rebx_output_binary.");
+static int rebx_write_snapshot(struct rebx_extras* rebx, struct rebx_writer* const w){
+    if (rebx->sim == NULL){
+        rebx_error(rebx, ""); // rebx_error gives meaningful err
+        return 0;
     }
+    rebx_write_object(rebx, REBX_BINARY_FIELD_TYPE_SNAPSHOT, rebx_write_snapshot_contents, NULL, w);
+    if (w->error){
+        rebx_error(rebx, "REBOUNDx Error: Could not write binary output.\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int rebx_write_binary(struct rebx_extras* rebx, struct rebx_writer* const w){
     if (rebx->sim == NULL){
         rebx_error(rebx, ""); // rebx_error gives meaningful err
-        return;
+        return 0;
     }
     // Write header.
     const char str[] = "REBOUNDx Binary File. Version: ";
     char zero = '\0';
     size_t lenheader = strlen(str)+strlen(rebx_version_str);
-    fwrite(str,sizeof(char),strlen(str),of);
-    fwrite(rebx_version_str,sizeof(char), strlen(rebx_version_str),of);
-    fwrite(&zero,sizeof(char),1,of);
-    fwrite(rebx_githash_str,sizeof(char),62-lenheader,of);
-    fwrite(&zero,sizeof(char),1,of);
+    rebx_writer_put(w, str, strlen(str));
+    rebx_writer_put(w, rebx_version_str, strlen(rebx_version_str));
+    rebx_writer_put(w, &zero, 1);
+    rebx_writer_put(w, rebx_githash_str, 62-lenheader);
+    rebx_writer_put(w, &zero, 1);
+
+    return rebx_write_snapshot(rebx, w);
+}
 
-    rebx_write_snapshot(rebx, of);
+int rebx_output_snapshot_stream(struct rebx_extras* rebx, FILE* of){
+    struct rebx_writer w = {.write = rebx_write_to_file, .context = of};
+    return rebx_write_snapshot(rebx, &w);
+}
+
+int rebx_output_binary_callback(struct rebx_extras* rebx, size_t (*write)(const void* data, size_t size, void* context), void* context){
+    if (write == NULL){
+        rebx_error(rebx, "REBOUNDx Error: write function passed to rebx_output_binary_callback was NULL.\n");
+        return 0;
+    }
+    struct rebx_writer w = {.write = write, .context = context};
+    return rebx_write_binary(rebx, &w);
+}
+
+int rebx_output_binary_stream(struct rebx_extras* rebx, FILE* of){
+    struct rebx_writer w = {.write = rebx_write_to_file, .context = of};
+    return rebx_write_binary(rebx, &w);
+}
+
+char* rebx_output_binary_buffer(struct rebx_extras* rebx, size_t* size){
+    *size = 0;
+    struct rebx_writer measure = {.write = NULL};
+    if (!rebx_write_binary(rebx, &measure)){
+        return NULL;
+    }
+    struct rebx_memory_sink sink = {.buffer = malloc(measure.position), .size = measure.position};
+    if (sink.buffer == NULL){
+        rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+        return NULL;
+    }
+    struct rebx_writer w = {.write = rebx_write_to_memory, .context = &sink};
+    if (!rebx_write_binary(rebx, &w)){
+        free(sink.buffer);
+        return NULL;
+    }
+    *size = sink.position;
+    return sink.buffer;
+}
+
+void rebx_output_binary(struct rebx_extras* rebx, char* filename){
+    FILE* of = fopen(filename,"wb");
+    if (of==NULL){
+        rebx_error(rebx, "REBOUNDx error: Can not open file passed to rebx_output_binary.");
+        return;
+    }
+    rebx_output_binary_stream(rebx, of);
     fclose(of);
 }
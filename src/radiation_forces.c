@@ -66,17 +66,16 @@
 #include <stdlib.h>
 #include "reboundx.h"
 
-static void rebx_calculate_radiation_forces(struct rebx_extras* const rebx, struct reb_simulation* const sim, const double c, const int source_index, struct reb_particle* const particles, const int N){
+static void rebx_calculate_radiation_forces(struct reb_simulation* const sim, const double c, const struct rebx_param_column* const beta, const struct rebx_role_list* const targets, const int source_index, struct reb_particle* const particles){
     const struct reb_particle source = particles[source_index];
     const double mu = sim->G*source.m;
 
-    for (int i=0;i<N;i++){
+#pragma omp parallel for
+    for (int k=0;k<targets->N_roles;k++){
+        const int i = targets->indices[k]; // only particles with beta set feel radiation forces
         
         if(i == source_index) continue;
         
-        const double* beta = rebx_get_param(rebx, particles[i].ap, "beta");
-        if(beta == NULL) continue; // only particles with beta set feel radiation forces
-        
         const struct reb_particle p = particles[i];
         const double dx = p.x - source.x; 
         const double dy = p.y - source.y;
@@ -87,7 +86,7 @@ static void rebx_calculate_radiation_forces(struct rebx_extras* const rebx, stru
         const double dvy = p.vy - source.vy;
         const double dvz = p.vz - source.vz;
         const double rdot = (dx*dvx + dy*dvy + dz*dvz)/dr; // radial velocity
-        const double a_rad = *beta*mu/(dr*dr);
+        const double a_rad = (*beta->values[i])*mu/(dr*dr);
 
         // Equation (5) of Burns, Lamy & Soter (1979)
 
@@ -97,23 +96,53 @@ static void rebx_calculate_radiation_forces(struct rebx_extras* const rebx, stru
 	}
 }
 
-void rebx_radiation_forces(struct reb_simulation* const sim, struct rebx_force* const radiation_forces, struct reb_particle* const particles, const int N){
+struct rebx_radiation_forces_plan{
+    double c;                   // speed of light
+    int beta_id;
+    int radiation_source_id;
+};
+
+int rebx_radiation_forces_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
     struct rebx_extras* const rebx = sim->extras;
-    double* c = rebx_get_param(rebx, radiation_forces->ap, "c");
+    const double* const c = rebx_get_param(rebx, force->ap, "c");
     if (c == NULL){
         reb_simulation_error(sim, "Need to set speed of light in radiation_forces effect.  See examples in documentation.\n");
+        return 0;
+    }
+    struct rebx_radiation_forces_plan* plan = realloc(force->plan, sizeof(*plan));
+    if (plan == NULL){
+        reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+        return 0;
+    }
+    force->plan = plan;
+    plan->c = *c;
+    plan->beta_id = rebx_get_param_id(rebx, "beta");
+    plan->radiation_source_id = rebx_get_param_id(rebx, "radiation_source");
+    return 1;
+}
+
+void rebx_radiation_forces(struct reb_simulation* const sim, struct rebx_force* const radiation_forces, struct reb_particle* const particles, const int N){
+    struct rebx_extras* const rebx = sim->extras;
+    const struct rebx_radiation_forces_plan* const plan = rebx_get_force_plan(sim, radiation_forces, particles, N);
+    if (plan == NULL){
         return;
     }
     
-    int source_found=0;
-    for (int i=0; i<N; i++){
-        if (rebx_get_param(rebx, particles[i].ap, "radiation_source") != NULL){
-            source_found = 1;
-            rebx_calculate_radiation_forces(rebx, sim, *c, i, particles, N);
-        }
+    const struct rebx_param_column* const beta = rebx_get_param_column(rebx, plan->beta_id, particles, N);
+    if (beta == NULL || beta->N_set == 0){
+        return;
+    }
+
+    const struct rebx_role_list* const targets = rebx_get_role_particles(rebx, plan->beta_id, particles, N);
+    const struct rebx_role_list* const sources = rebx_get_role_particles(rebx, plan->radiation_source_id, particles, N);
+    if (targets == NULL || sources == NULL){
+        return;
+    }
+    for (int k=0; k<sources->N_roles; k++){
+        rebx_calculate_radiation_forces(sim, plan->c, beta, targets, sources->indices[k], particles);
     }
-    if (!source_found){
-        rebx_calculate_radiation_forces(rebx, sim, *c, 0, particles, N);    // default source to index 0 if "radiation_source" not found on any particle
+    if (sources->N_roles == 0){
+        rebx_calculate_radiation_forces(sim, plan->c, beta, targets, 0, particles);    // default source to index 0 if "radiation_source" not found on any particle
     }
 }
 
@@ -126,6 +126,22 @@ enum rebx_binary_field_type{
     REBX_BINARY_FIELD_TYPE_PARTICLES=24,
     REBX_BINARY_FIELD_TYPE_FORCE=25,
     REBX_BINARY_FIELD_TYPE_SNAPSHOT=26,
+    REBX_BINARY_FIELD_TYPE_SNAPSHOT_T=27,
+    REBX_BINARY_FIELD_TYPE_SNAPSHOT_STEPS_DONE=28,
+    REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX=29,
+    REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX_OFFSET=30,
+    REBX_BINARY_FIELD_TYPE_SNAPSHOT_KEYFRAME=31,
+    REBX_BINARY_FIELD_TYPE_SNAPSHOT_DELTA=32,
+    REBX_BINARY_FIELD_TYPE_ARCHIVE_INDEX_BLOCK=33,
+};
+
+/**
+ * @brief Entry in the index of a REBOUNDx archive (see rebx_output_binary_archive).
+ */
+struct rebx_archive_entry{
+    double t;                       ///< Simulation time of the snapshot
+    unsigned long long steps_done;  ///< Simulation steps_done of the snapshot
+    long offset;                    ///< Position of the snapshot in the file in bytes
 };
 
 /**
@@ -186,13 +202,94 @@ struct rebx_node{
 };
 
 /**
- * @brief Main structure used for all parameters added to objects.
+ * @brief Structure-of-arrays view of a double parameter over a particle array (see rebx_get_param_column).
+ */
+struct rebx_param_column{
+    int id;                         ///< Id of the parameter
+    int N;                          ///< Number of particles the column was built for
+    int N_allocated;                ///< Allocated length of the arrays below
+    int N_set;                      ///< Number of particles that have the parameter set
+    double** values;                ///< values[i] points to the parameter of particle i (NULL if not set)
+    void** aps;                     ///< Particle ap pointers when the column was built (to detect added, removed or reordered particles)
+    unsigned long version;          ///< rebx->param_versions[id] when the column was built
+    unsigned long layout_version;   ///< rebx->param_layout_version when the column was built
+};
+
+/**
+ * @brief Cached indices of the particles that have a given parameter set, e.g. the sources or primaries of an effect (see rebx_get_role_particles).
+ */
+struct rebx_role_list{
+    int id;                         ///< Id of the parameter
+    int N;                          ///< Number of particles the list was built for
+    int N_allocated;                ///< Allocated length of the arrays below
+    int N_roles;                    ///< Number of particles that have the parameter set
+    int* indices;                   ///< Indices of those particles in increasing order
+    void** aps;                     ///< Their ap pointers when the list was built (to detect removed or reordered particles)
+    unsigned long version;          ///< rebx->param_versions[id] when the list was built
+    unsigned long layout_version;   ///< rebx->param_layout_version when the list was built
+};
+
+/**
+ * @brief Orbital elements effects can request from rebx_com_batch_orbits. Combine with |.
+ */
+enum REBX_ORBIT_ELEMENTS{
+    REBX_ORBIT_A = 1,               ///< Semimajor axis
+    REBX_ORBIT_E = 2,               ///< Eccentricity
+    REBX_ORBIT_INC = 4,             ///< Inclination
+    REBX_ORBIT_P = 8,               ///< Orbital period
+};
+
+#define REBX_ORBIT_CACHE_N_FRAMES 4 ///< Number of frames (coordinate system and reference particle pairs) the orbit cache holds at once
+
+/**
+ * @brief Cached orbital elements of the particles relative to the sources of one coordinate system (see rebx_enable_orbit_cache).
+ */
+struct rebx_orbit_frame{
+    enum REBX_COORDINATES coordinates;  ///< Coordinate system of the sources
+    int refindex;                       ///< Index of the reference particle for REBX_COORDINATES_PARTICLE (-1 for barycentric, 0 for Jacobi coordinates)
+    unsigned long last_used;            ///< Value of the cache's use counter when the frame was last looked up (0 if unused)
+    int N_allocated;                    ///< Allocated length of the arrays below
+    unsigned long* evaluations;         ///< evaluations[i] is the evaluation in which the elements of particle i were calculated
+    unsigned int* computed;             ///< computed[i] has the REBX_ORBIT_ELEMENTS bits of the elements of particle i calculated in that evaluation
+    double* a;                          ///< Elements indexed by particle
+    double* e;
+    double* inc;
+    double* P;
+};
+
+/**
+ * @brief Orbital elements shared between the effects that need them within one evaluation of the forces.
+ */
+struct rebx_orbit_cache{
+    unsigned long evaluation;           ///< Bumped before each evaluation of the forces and each operator step, which makes all cached elements stale
+    unsigned long uses;                 ///< Counter for picking the least recently used frame to replace
+    unsigned long hits;                 ///< Number of times a particle's requested elements were found in the cache
+    unsigned long misses;               ///< Number of times they had to be calculated
+    struct rebx_orbit_frame frames[REBX_ORBIT_CACHE_N_FRAMES];
+};
+
+/**
+ * @brief Newtonian accelerations from REBOUND's gravity routine, copied before REBOUNDx adds any forces (see rebx_get_gravity_snapshot).
+ */
+struct rebx_gravity_snapshot{
+    int N;                          ///< Number of particles in the snapshot
+    int N_allocated;                ///< Allocated length of the arrays below
+    int valid;                      ///< 1 while the forces are evaluated on the state the snapshot was taken from
+    double* ax;                     ///< Accelerations indexed by particle
+    double* ay;
+    double* az;
+};
+
+/**
+ * @brief Registered parameter: name, type and id shared by every particle or effect carrying the parameter.
+ * @details Each param set on a particle or effect is one allocation holding a rebx_node (whose object is the registered param) and the value, i.e. 16 bytes plus the value. A particle's params are not packed into a single block, since ap lists are linked lists that the rebx_set_param_* API inserts into, and effects hold pointers to values that growing such a block would move.
  */
 
 struct rebx_param{
     char* name;                 ///< For searching linked lists and informative errors
     enum rebx_param_type type;  ///< Needed to cast value
-    void* value;                ///< Pointer to parameter value
+    int id;                     ///< Id of the registered name (see rebx_get_param_id). Parameter lists are kept sorted by id.
+    void* value;                ///< Unused (NULL) for registered params. Params on particles and effects are list nodes whose object is the registered param, followed by the value (see rebx_get_param).
 };
 
 /**
@@ -205,6 +302,15 @@ struct rebx_force{
     // See comments in params.py in __init__
     enum rebx_force_type force_type;    ///< Force type for internal logic
     void (*update_accelerations) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N); ///< Function pointer to add additional accelerations
+    int (*prepare) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N); ///< Optional. Resolves params into force->plan (see rebx_get_force_plan). Returns 1 on success, 0 (after raising an error) otherwise.
+    void* plan;                 ///< Force-specific struct of resolved params built by prepare. Must be a single allocation (freed with free).
+    int plan_N;                 ///< Number of particles the plan was built for. -1 if it needs to be rebuilt.
+    unsigned long plan_version; ///< Sum of the versions of the particle params the plan depends on when it was built (see rebx_get_force_plan)
+    int* plan_param_ids;        ///< Ids of the particle params whose role lists or columns prepare requested
+    int N_plan_param_ids;       ///< Number of ids in plan_param_ids
+    int N_allocated_plan_param_ids; ///< Allocated length of plan_param_ids
+    void* workspace;            ///< Scratch memory reused between calls (see rebx_get_force_workspace)
+    size_t workspace_size;      ///< Size of workspace in bytes
 };
 
 /**
@@ -217,6 +323,8 @@ struct rebx_operator{
     // See comments in params.py in __init__
     enum rebx_operator_type operator_type;  ///< Operator type for internal logic
     void (*step_function) (struct reb_simulation* sim, struct rebx_operator* operator, const double dt);       ///< Function pointer to execute step
+    void* workspace;            ///< Scratch memory reused between calls (see rebx_get_operator_workspace)
+    size_t workspace_size;      ///< Size of workspace in bytes
 };
 
 /**
@@ -228,6 +336,30 @@ struct rebx_step{
     double dt_fraction;                 ///< Fraction of sim.dt to use each time it's called
 };
 
+/**
+ * @brief Name and type of a parameter an effect uses (see rebx_effect_descriptor).
+ */
+struct rebx_param_schema{
+    const char* name;                   ///< Parameter name
+    enum rebx_param_type type;          ///< Parameter type
+};
+
+/**
+ * @brief Everything rebx_load_force or rebx_load_operator needs to create an effect by name.
+ * @details Forces set update_accelerations and force_type, operators step_function and operator_type. See rebx_register_effect and rebx_load_plugin.
+ */
+struct rebx_effect_descriptor{
+    const char* name;                   ///< Name to load the effect with
+    void (*update_accelerations) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N); ///< Forces only. Copied to rebx_force
+    int (*prepare) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N); ///< Forces only, optional. Copied to rebx_force
+    enum rebx_force_type force_type;    ///< Forces only. Copied to rebx_force
+    void (*step_function) (struct reb_simulation* sim, struct rebx_operator* operator, const double dt); ///< Operators only. Copied to rebx_operator
+    enum rebx_operator_type operator_type;  ///< Operators only. Copied to rebx_operator
+    void (*free_arrays) (struct rebx_extras* rebx, struct rebx_force* force);   ///< Forces only, optional. Called when the force is freed
+    const struct rebx_param_schema* params; ///< Parameters to register when the effect is loaded, if not registered yet (can be NULL)
+    int N_params;                       ///< Number of entries in params
+};
+
 /**
  * @brief Structure used as building block to save and load binary files.
  */
@@ -244,6 +376,29 @@ struct rebx_interpolator{
     double* y2;
     int klo;
 };
+
+/**
+ * @brief Set of independent copies of a simulation and its REBOUNDx effects (see rebx_create_ensemble).
+ */
+struct rebx_ensemble{
+    int N_members;                      ///< Number of member simulations
+    struct reb_simulation** sims;       ///< Member simulations. Each has its own rebx_extras in sim->extras.
+    int* status;                        ///< Value returned by reb_simulation_integrate for each member in the last rebx_ensemble_integrate call
+};
+#define REBX_ARENA_N_CLASSES 16      ///< Number of small object size classes in a rebx_arena (multiples of 16 bytes)
+
+/**
+ * @brief Memory pool all REBOUNDx nodes, params, forces, operators and steps are allocated from (see arena.c).
+ */
+struct rebx_arena{
+    struct rebx_arena_chunk* chunks;                ///< Linked list of allocated chunks, most recent first
+    struct rebx_arena_large* large;                 ///< Doubly linked list of objects too large for a size class, each malloc'd on its own
+    void* free_lists[REBX_ARENA_N_CLASSES];         ///< Freed blocks available for reuse, by size class
+    size_t used;                                    ///< Bytes currently in use
+    size_t peak;                                    ///< Largest number of bytes ever in use at once
+    size_t reserved;                                ///< Bytes currently obtained from the system
+};
+
 /**
  * @brief Main REBOUNDx structure.
  * @details These fields are used internally by REBOUNDx and generally should not be changed manually by the user. Use the API instead.
@@ -255,9 +410,30 @@ struct rebx_extras {
     struct rebx_node* pre_timestep_modifications;   ///< Linked list of rebx_steps to apply before each timestep
 	struct rebx_node* post_timestep_modifications;  ///< Linked list of rebx_steps to apply after each timestep
 
-    struct rebx_node* registered_params;            ///< Linked list of rebx_params with all the parameter names registered with their type (for type safety)
+    struct rebx_node* registered_params;            ///< Linked list of the rebx_params registered with rebx_register_param (built-in ones are in a static table shared by all instances)
     struct rebx_node* allocated_forces;             ///< For memory management
     struct rebx_node* allocated_operators;          ///< For memory management
+
+    struct rebx_param** registered_param_table;     ///< User registered params indexed by their id minus the number of built-in params
+    int* registered_param_hash;                     ///< Open addressing hash table mapping hashed names of user registered params to ids (-1 for empty slots)
+    int N_registered_params;                        ///< Number of registered params, including built-in ones (also the next id to hand out)
+    int N_allocated_registered_params;              ///< Number of ids param_versions and param_columns have room for
+    int registered_param_hash_size;                 ///< Number of slots in registered_param_hash (power of 2)
+
+    unsigned long* param_versions;                  ///< Counters indexed by id, bumped whenever a param with that id is added or set
+    unsigned long param_layout_version;             ///< Bumped whenever a list of params is freed (e.g., when a particle is removed)
+    struct rebx_param_column** param_columns;       ///< Cached param columns indexed by id (NULL until requested)
+    struct rebx_role_list** role_lists;             ///< Cached role particle lists indexed by id (NULL until requested)
+    struct rebx_orbit_cache* orbit_cache;           ///< Orbital elements shared between effects (NULL unless enabled with rebx_enable_orbit_cache)
+    struct rebx_gravity_snapshot* gravity_snapshot; ///< Newtonian accelerations for forces with gr_reuse_gravity set (NULL until first needed)
+    struct rebx_jacobi_frame* jacobi_frame;         ///< Jacobi coordinates shared by forces within an evaluation (see rebx_get_jacobi_frame in rebxtools.h)
+    int evaluating_forces;                          ///< 1 while rebx_additional_forces is calling the forces, 0 otherwise
+    struct rebx_archive_state* archive_state;       ///< Last keyframe written by rebx_output_binary_archive (NULL until the first one)
+    int archive_keyframe_interval;                  ///< rebx_output_binary_archive writes a full snapshot every this many snapshots, and only changed param values in between
+    struct rebx_async_output* async_output;         ///< Queue and thread of rebx_output_binary_async (NULL unless enabled)
+    struct rebx_force* preparing_force;             ///< Force whose prepare function is running (NULL otherwise). Role lists and columns requested meanwhile become dependencies of its plan.
+
+    struct rebx_arena arena;                        ///< Memory pool for nodes, params, forces, operators and steps. Released all at once by rebx_free.
 };
 
 /****************************************
@@ -304,6 +480,31 @@ int rebx_remove_operator(struct rebx_extras* rebx, struct rebx_operator* operato
  */
 void rebx_output_binary(struct rebx_extras* rebx, char* filename);
 
+/**
+ * @brief Same as rebx_output_binary(), but writes to an open stream. The binary is written in a single forward pass, so the stream doesn't need to be seekable (e.g. a pipe).
+ * @param rebx Pointer to the rebx_extras instance
+ * @param of Stream to write to.
+ * @return 1 on success, 0 if writing failed.
+ */
+int rebx_output_binary_stream(struct rebx_extras* rebx, FILE* of);
+
+/**
+ * @brief Same as rebx_output_binary(), but passes the binary in consecutive chunks to a user function, e.g. to send it over a network or compress it.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param write Function called with each chunk and the context pointer. Must return the number of bytes it consumed (size on success).
+ * @param context Pointer passed through to write.
+ * @return 1 on success, 0 if write consumed fewer bytes than it was passed.
+ */
+int rebx_output_binary_callback(struct rebx_extras* rebx, size_t (*write)(const void* data, size_t size, void* context), void* context);
+
+/**
+ * @brief Same as rebx_output_binary(), but writes to a newly allocated memory buffer of exactly the binary's size.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param size Set to the size of the binary in bytes (0 on failure).
+ * @return Buffer the caller has to free, or NULL on failure.
+ */
+char* rebx_output_binary_buffer(struct rebx_extras* rebx, size_t* size);
+
 /**
  * @brief Reads a REBOUNDx binary file, loads all effects and parameters.
  * @param sim Pointer to the simulation to which the effects and parameters should be added.
@@ -318,6 +519,84 @@ struct rebx_extras* rebx_create_extras_from_binary(struct reb_simulation* sim, c
  * @param warnings Pointer to an array of warnings to be populated during loading.
  */
 void rebx_init_extras_from_binary(struct rebx_extras* rebx, const char* const filename, enum rebx_input_binary_messages* warnings);
+
+/**
+ * @brief Same as rebx_init_extras_from_binary(), but reads the binary from memory (e.g. from rebx_output_binary_buffer()).
+ * @param rebx Pointer to a rebx_extras instance to be updated.
+ * @param buffer Pointer to the binary. Only read during the call.
+ * @param size Size of the binary in bytes.
+ * @param warnings Pointer to an array of warnings to be populated during loading.
+ */
+void rebx_init_extras_from_buffer(struct rebx_extras* rebx, const void* const buffer, const size_t size, enum rebx_input_binary_messages* warnings);
+
+/**
+ * @brief Appends a snapshot of all the effects and parameters, with the simulation's t and steps_done, to a REBOUNDx archive.
+ * @details Creates the archive if it doesn't exist. Snapshots already in the file are never rewritten; only the index table at the end of the file is replaced, so that readers can find any snapshot with a seek. A binary from rebx_output_binary() can be appended to, and is read as an archive with a single snapshot.
+ * Every rebx->archive_keyframe_interval-th snapshot (and any snapshot after effects or particles were added or removed) stores everything. The ones in between only store the param values that changed since that keyframe, so loading any snapshot reads at most two. Set archive_keyframe_interval to 1 to store everything every time.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param filename Filename of the archive.
+ * @return 1 on success, 0 on failure.
+ */
+int rebx_output_binary_archive(struct rebx_extras* rebx, const char* const filename);
+
+/**
+ * @brief Reads the index of a REBOUNDx archive.
+ * @param filename Filename of the archive.
+ * @param entries Array filled with the first N_entries entries. Can be NULL to only get the number of snapshots.
+ * @param N_entries Length of entries.
+ * @return Number of snapshots in the archive, or -1 if it could not be read.
+ */
+int rebx_archive_read_index(const char* const filename, struct rebx_archive_entry* const entries, const int N_entries);
+
+/**
+ * @brief Same as rebx_init_extras_from_binary(), but loads one snapshot of a REBOUNDx archive.
+ * @param rebx Pointer to a rebx_extras instance to be updated.
+ * @param filename Filename of the archive.
+ * @param snapshot Index of the snapshot to load. Negative values count from the end (-1 is the last snapshot).
+ * @param warnings Pointer to an array of warnings to be populated during loading.
+ */
+void rebx_init_extras_from_archive(struct rebx_extras* rebx, const char* const filename, int snapshot, enum rebx_input_binary_messages* warnings);
+
+/**
+ * @brief Same as rebx_create_extras_from_binary(), but loads one snapshot of a REBOUNDx archive (see rebx_init_extras_from_archive()).
+ * @param sim Pointer to the simulation to which the effects and parameters should be added.
+ * @param filename Filename of the archive.
+ * @param snapshot Index of the snapshot to load. Negative values count from the end.
+ */
+struct rebx_extras* rebx_create_extras_from_archive(struct reb_simulation* sim, const char* const filename, const int snapshot);
+
+/**
+ * @brief Starts a background thread that writes the binaries queued with rebx_output_binary_async().
+ * @details Calling it again first waits for the snapshots queued with the old settings. Without threads (on Windows), rebx_output_binary_async() writes each binary before returning.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param max_pending Number of snapshots that can wait to be written. While that many are waiting, rebx_output_binary_async() skips snapshots rather than waiting for the disk.
+ * @param callback Called on the writer thread with the filename, 1 if the snapshot was written and synced to disk or else 0, and context. Can be NULL. It must not call REBOUND or REBOUNDx functions on the simulation being integrated.
+ * @param context Passed to callback.
+ * @return 1 on success, 0 on failure.
+ */
+int rebx_enable_async_output(struct rebx_extras* const rebx, const int max_pending, void (*callback)(const char* filename, int success, void* context), void* context);
+
+/**
+ * @brief Waits for the queued snapshots to be written and stops the writer thread. rebx_free() calls this.
+ * @param rebx Pointer to the rebx_extras instance
+ */
+void rebx_disable_async_output(struct rebx_extras* const rebx);
+
+/**
+ * @brief Same as rebx_output_binary(), but only copies the effects and parameters into memory and leaves writing them to the background thread.
+ * @details The binary first goes to filename.tmp, which replaces filename once it is synced to disk, so a crash never leaves a partial file. Starts the writer thread with room for 4 snapshots and no callback if rebx_enable_async_output() wasn't called. Only call it from one thread.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param filename Filename to which to save the binary.
+ * @return 1 if the snapshot was queued, 0 if it was skipped because max_pending snapshots are still being written, or on failure.
+ */
+int rebx_output_binary_async(struct rebx_extras* const rebx, const char* const filename);
+
+/**
+ * @brief Waits until all snapshots queued with rebx_output_binary_async() have been written.
+ * @param rebx Pointer to the rebx_extras instance
+ * @return Number of snapshots that could not be written since the last call.
+ */
+int rebx_wait_async_output(struct rebx_extras* const rebx);
 /** @} */
 /** @} */
 
@@ -348,6 +627,25 @@ struct rebx_operator* rebx_load_operator(struct rebx_extras* const rebx, const c
 struct rebx_force* rebx_load_force(struct rebx_extras* const rebx, const char* name);
 struct rebx_operator* rebx_create_operator(struct rebx_extras* const rebx, const char* name);
 struct rebx_force* rebx_create_force(struct rebx_extras* const rebx, const char* name);
+
+/**
+ * @brief Makes an effect available to rebx_load_force or rebx_load_operator in all REBOUNDx instances.
+ * @details Effects registered later take precedence over earlier ones and over the ones built into REBOUNDx with the same name, e.g. to swap in an optimized implementation.
+ * The descriptor is not copied and must stay valid.
+ * Not thread safe: the registry is shared by all instances and has no lock, so this (and rebx_load_plugin) must not run while effects are being loaded on another thread, e.g. by rebx_ensemble_integrate's OpenMP threads. Register effects before loading any in parallel.
+ * @param descriptor Pointer to the rebx_effect_descriptor of the effect.
+ * @return 1 on success, 0 if the descriptor is invalid.
+ */
+int rebx_register_effect(const struct rebx_effect_descriptor* const descriptor);
+
+/**
+ * @brief Registers the effects in a shared library (see rebx_register_effect).
+ * @details The library must define const struct rebx_effect_descriptor* rebx_plugin_effects(int* N_effects), which returns an array of its effect descriptors and sets N_effects to its length.
+ * It stays loaded for the rest of the program. Not supported on Windows. Like rebx_register_effect, must not run while effects are being loaded on other threads.
+ * @param filename Path to the shared library.
+ * @return 1 on success, 0 otherwise (with a message on stderr).
+ */
+int rebx_load_plugin(const char* const filename);
 /**
  * @brief Function for adding a custom force in REBOUNDx.
  * @param rebx Pointer to the rebx_extras instance
@@ -416,7 +714,116 @@ int rebx_remove_param(struct rebx_node** apptr, const char* const param_name);
  */
 
 void* rebx_get_param(struct rebx_extras* const rebx, struct rebx_node* ap, const char* const param_name);
-struct rebx_param* rebx_get_param_struct(struct rebx_extras* const rebx, struct rebx_node* ap, const char* const param_name);
+
+/**
+ * @brief Gets the registered rebx_param (name, type and id) of a parameter set on a particle or effect. Use rebx_get_param for its value.
+ * @param ap Pointer from which to get the param
+ * @param param_name Name of the parameter
+ * @return NULL if the parameter is not set on ap.
+ */
+const struct rebx_param* rebx_get_param_struct(struct rebx_extras* const rebx, struct rebx_node* ap, const char* const param_name);
+
+/**
+ * @brief Gets the integer id assigned to a registered parameter name.
+ * @details Ids are handed out by rebx_register_param and stay fixed for the lifetime of the rebx_extras instance. Effects should look up ids once (outside of loops over particles) and then use rebx_get_param_by_id, which avoids string comparisons.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param param_name Name of the parameter
+ * @return Id of the parameter, or -1 if the name has not been registered.
+ */
+int rebx_get_param_id(struct rebx_extras* const rebx, const char* const param_name);
+
+/**
+ * @brief Same as rebx_get_param, but takes the id returned by rebx_get_param_id instead of the name.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param ap Pointer from which to get the param
+ * @param id Id of the parameter we want to get
+ * @return A void pointer to the parameter. NULL if not found.
+ */
+void* rebx_get_param_by_id(struct rebx_extras* const rebx, struct rebx_node* ap, const int id);
+const struct rebx_param* rebx_get_param_struct_by_id(struct rebx_extras* const rebx, struct rebx_node* ap, const int id);
+
+/**
+ * @brief Gets the cached plan of a force, calling its prepare function first if the plan is out of date.
+ * @details Forces with a prepare function resolve their params once into a typed struct (force->plan), so update_accelerations can read plain fields instead of looking up params on every call. The plan is rebuilt when a param is set on the force through rebx_set_param_*, when N changes, or when a particle param whose role list or column prepare requested (see rebx_get_role_particles and rebx_get_param_column) is added or set, or a particle's params are freed. Changes to other particle params leave the plan alone. Values written directly through pointers returned by rebx_get_param are not detected.
+ * @param sim Pointer to the simulation
+ * @param force Pointer to the force
+ * @param particles Particle array the force is being evaluated on
+ * @param N Number of particles
+ * @return Pointer to the plan, or NULL if the force has no prepare function or preparing failed.
+ */
+void* rebx_get_force_plan(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N);
+
+/**
+ * @brief Gets scratch memory owned by a force, which is kept between calls and freed together with the force.
+ * @details Avoids allocating temporary arrays every time update_accelerations is called. The contents are not preserved when the workspace has to grow.
+ * @param sim Pointer to the simulation
+ * @param force Pointer to the force
+ * @param size Number of bytes needed
+ * @return Pointer to at least size bytes, or NULL if the allocation failed.
+ */
+void* rebx_get_force_workspace(struct reb_simulation* const sim, struct rebx_force* const force, const size_t size);
+
+/**
+ * @brief Gets scratch memory owned by an operator, analogous to rebx_get_force_workspace.
+ * @param sim Pointer to the simulation
+ * @param operator Pointer to the operator
+ * @param size Number of bytes needed
+ * @return Pointer to at least size bytes, or NULL if the allocation failed.
+ */
+void* rebx_get_operator_workspace(struct reb_simulation* const sim, struct rebx_operator* const operator, const size_t size);
+
+/**
+ * @brief Gets a contiguous (structure-of-arrays) array of pointers to a double parameter across a particle array.
+ * @details The column is cached in rebx and only rebuilt when the parameter is added or set through rebx_set_param_* / Python, when a particle's params are freed, or when the particles passed in (or their order) change. It points at the parameters themselves, so values written through pointers returned by rebx_get_param are seen. The returned pointer is owned by rebx and is only valid until the next call for the same id. Not thread-safe; call before entering parallel loops.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param id Id of a registered REBX_TYPE_DOUBLE parameter (see rebx_get_param_id)
+ * @param particles Particle array whose params should be gathered
+ * @param N Number of particles in the array
+ * @return Pointer to the column, or NULL on error (unregistered id or non-double type).
+ */
+struct rebx_param_column* rebx_get_param_column(struct rebx_extras* const rebx, const int id, struct reb_particle* const particles, const int N);
+
+/**
+ * @brief Gets the indices of the particles that have a parameter set, e.g. the sources of an effect or the particles it acts on.
+ * @details Effects that only act on a few of the particles can loop over this list instead of looking up the parameter on every particle. The list is cached in rebx, so only the first call after a change scans the particles. It is rebuilt when the parameter is added or set through rebx_set_param_* / Python, when a particle's params are freed, or when N changes or a particle in the list moves to a different index. The returned pointer is owned by rebx and is only valid until the next call for the same id. Not thread-safe; call before entering parallel loops.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param id Id of a registered parameter of any type (see rebx_get_param_id)
+ * @param particles Particle array to search
+ * @param N Number of particles in the array
+ * @return Pointer to the list, or NULL on error (unregistered id).
+ */
+const struct rebx_role_list* rebx_get_role_particles(struct rebx_extras* const rebx, const int id, struct reb_particle* const particles, const int N);
+
+/**
+ * @brief Gets the Newtonian accelerations REBOUND's gravity routine calculated for the current evaluation of the forces.
+ * @details Post-Newtonian forces with the gr_reuse_gravity param set use these instead of their own O(N^2) Newtonian pass, so that they match REBOUND's gravity options (softening, tree code, OpenMP). REBOUNDx only copies them, before calling any forces, while some force in the simulation has gr_reuse_gravity set. Terms REBOUND skips because of sim->gravity_ignore_terms are added back in O(N). There is no snapshot during operator steps (e.g. forces integrated with integrate_force), or if REBOUND's gravity is not plain Newtonian (REB_GRAVITY_NONE, MERCURIUS or JACOBI), so forces have to fall back to calculating the accelerations themselves when this returns NULL.
+ * @param rebx Pointer to the rebx_extras instance
+ * @param particles Particle array passed to the force
+ * @param N Number of particles in the array
+ * @return Pointer to the snapshot, or NULL if there is none for these particles.
+ */
+const struct rebx_gravity_snapshot* rebx_get_gravity_snapshot(struct rebx_extras* const rebx, const struct reb_particle* const particles, const int N);
+
+/**
+ * @brief Lets effects share the orbital elements they calculate within one evaluation of the forces.
+ * @details Effects that need the same elements of the same particles relative to the same sources (e.g. semimajor axes in Jacobi coordinates for both exponential_migration and type_I_migration) then calculate them only once per evaluation, and only the elements requested (see rebx_com_batch_orbits). Elements are calculated for whole batches of particles at once with the same formulas as reb_orbit_from_particle, in a loop the compiler can vectorize, so results can differ from runs without the cache in the last bits. Off by default. Not saved to binary files.
+ * @param rebx Pointer to the rebx_extras instance
+ * @return 1 on success, 0 if the cache could not be allocated.
+ */
+int rebx_enable_orbit_cache(struct rebx_extras* const rebx);
+
+/**
+ * @brief Frees the orbit cache, so that effects calculate their orbital elements themselves again.
+ * @param rebx Pointer to the rebx_extras instance
+ */
+void rebx_disable_orbit_cache(struct rebx_extras* const rebx);
+
+/**
+ * @brief Marks all elements in the orbit cache as stale.
+ * @details REBOUNDx does this before each evaluation of the forces and each operator step. Only needed when calling the update_accelerations function of forces directly after modifying particles.
+ * @param rebx Pointer to the rebx_extras instance
+ */
+void rebx_invalidate_orbit_cache(struct rebx_extras* const rebx);
 void rebx_set_param_pointer(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, void* val);
 void rebx_set_param_double(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, double val);
 void rebx_set_param_int(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name, int val);
@@ -597,7 +1004,7 @@ double rebx_gravitational_harmonics_potential(struct rebx_extras* const rebx);
  * @return Void pointer to the parameter. NULL if not found or type does not match (will write error to stderr).
  */
 void* rebx_get_param_check(struct reb_simulation* sim, struct rebx_node* ap, const char* const param_name, enum rebx_param_type param_type);
-struct rebx_param* rebx_get_or_add_param(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name);
+struct rebx_node* rebx_get_or_add_param(struct rebx_extras* const rebx, struct rebx_node** apptr, const char* const param_name);
 
 
 /****************************************
@@ -702,6 +1109,73 @@ double rebx_interpolate(struct rebx_extras* const rebx, struct rebx_interpolator
 /** @} */
 /** @} */
 
+/****************************************
+ Ensembles
+ *****************************************/
+/**
+ * \name Ensemble Functions
+ * @{
+ */
+/**
+ * @defgroup EnsembleFunctions
+ * @details Functions for running many near-identical copies of a simulation (e.g., parameter sweeps or stochastic realizations) across threads.
+ * Members are cloned through the REBOUNDx binary format, so custom forces, operators and pointer parameters set by the user are not copied.
+ * @{
+ */
+
+/**
+ * @brief Makes a deep copy of a simulation together with the REBOUNDx effects and parameters attached to it.
+ * @param sim Pointer to the simulation to copy (must have REBOUNDx attached).
+ * @return Pointer to the new simulation, with its own rebx_extras in sim->extras. NULL on failure.
+ */
+struct reb_simulation* rebx_copy_simulation(struct reb_simulation* const sim);
+
+/**
+ * @brief Creates an ensemble of copies of a configured simulation.
+ * @details Each member gets a distinct rand_seed derived from sim's, so stochastic effects give independent realizations.
+ * @param sim Pointer to the template simulation (must have REBOUNDx attached). It is not modified.
+ * @param N_members Number of copies to make.
+ * @return Pointer to the ensemble. NULL on failure.
+ */
+struct rebx_ensemble* rebx_create_ensemble(struct reb_simulation* const sim, const int N_members);
+
+/**
+ * @brief Frees all member simulations, their REBOUNDx extras and the ensemble itself.
+ */
+void rebx_free_ensemble(struct rebx_ensemble* const ensemble);
+
+/**
+ * @brief Sets a double parameter on the same particle in every member, e.g., for a parameter sweep.
+ * @param ensemble Pointer to the ensemble.
+ * @param particle_index Index of the particle in each member's particles array.
+ * @param param_name Name of the (registered) parameter.
+ * @param values Array of N_members values. Member m gets values[m].
+ * @return 1 on success, 0 on failure.
+ */
+int rebx_ensemble_set_particle_param_double(struct rebx_ensemble* const ensemble, const int particle_index, const char* const param_name, const double* const values);
+
+/**
+ * @brief Integrates all members to tmax, in parallel when REBOUNDx is compiled with OpenMP.
+ * @details Members are handed out to threads one at a time as they become free, so members that take longer don't hold up the rest.
+ * Other per-member overrides can be made before calling this by modifying ensemble->sims[m] and its extras directly.
+ * @param ensemble Pointer to the ensemble.
+ * @param tmax Time to integrate each member to.
+ * @param collect Function called for each member after it finishes to write N_outputs values to output (it gets passed N_outputs, and must not write more). Can be NULL. Called from worker threads, so must be thread safe.
+ * @param outputs Preallocated array of N_members*N_outputs doubles. Member m writes to outputs + m*N_outputs.
+ * @param N_outputs Number of outputs per member.
+ * @param data Pointer passed through to collect.
+ * @return Number of members for which reb_simulation_integrate did not return success (see ensemble->status).
+ */
+int rebx_ensemble_integrate(struct rebx_ensemble* const ensemble, const double tmax, void (*collect)(struct reb_simulation* const sim, const int member, double* const output, const int N_outputs, void* const data), double* const outputs, const int N_outputs, void* const data);
+
+/**
+ * @brief Collect function for rebx_ensemble_integrate that writes x, y, z, vx, vy, vz for every particle (pass N_outputs = 6*N).
+ * @details Members can lose particles to collisions or ejections, or gain some, so the particles are written in order for as long as they fit in N_outputs, and any entries left over are set to NaN.
+ */
+void rebx_ensemble_collect_particles(struct reb_simulation* const sim, const int member, double* const output, const int N_outputs, void* const data);
+/** @} */
+/** @} */
+
 /****************************************
  Testing Functions
  *****************************************/
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "reboundx.h"
+#include "rebxtools.h"
 
 struct reb_particle rebx_get_com_without_particle(struct reb_particle com, struct reb_particle p){
     com.x = com.x*com.m - p.x*p.m;
@@ -30,21 +31,6 @@ struct reb_particle rebx_get_com_without_particle(struct reb_particle com, struc
 }
 
 
-static inline struct reb_particle rebx_particle_minus(struct reb_particle p1, struct reb_particle p2){
-    struct reb_particle p = {0};
-    p.m = p1.m-p2.m;
-    p.x = p1.x-p2.x;
-    p.y = p1.y-p2.y;
-    p.z = p1.z-p2.z;
-    p.vx = p1.vx-p2.vx;
-    p.vy = p1.vy-p2.vy;
-    p.vz = p1.vz-p2.vz;
-    p.ax = p1.ax-p2.ax;
-    p.ay = p1.ay-p2.ay;
-    p.az = p1.az-p2.az;
-    return p;
-}
-
 void rebx_calculate_jacobi_masses(const struct reb_particle* const ps, double* const m_j, const int N){
     double eta = ps[0].m;
     for (unsigned int i=1;i<N;i++){ // jacobi masses are reduced mass of particle with interior masses
@@ -55,6 +41,76 @@ void rebx_calculate_jacobi_masses(const struct reb_particle* const ps, double* c
     m_j[0] = eta;
 }
 
+const struct rebx_jacobi_frame* rebx_get_jacobi_frame(struct reb_simulation* const sim, const struct reb_particle* const particles, const int N, const unsigned int parts){
+    struct rebx_extras* const rebx = sim->extras;
+    if (N < 1 || particles != sim->particles || N != sim->N - sim->N_var){
+        return NULL;
+    }
+    struct rebx_jacobi_frame* frame = rebx->jacobi_frame;
+    if (frame == NULL){
+        frame = malloc(sizeof(*frame));
+        if (frame == NULL){
+            rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+            return NULL;
+        }
+        frame->N = 0;
+        frame->N_allocated = 0;
+        frame->computed = 0;
+        frame->ps_j = NULL;
+        frame->m_j = NULL;
+        frame->interiors = NULL;
+        rebx->jacobi_frame = frame;
+    }
+    if (N > frame->N_allocated){
+        struct reb_particle* ps_j = realloc(frame->ps_j, N*sizeof(*ps_j));
+        double* m_j = realloc(frame->m_j, N*sizeof(*m_j));
+        struct reb_particle* interiors = realloc(frame->interiors, N*sizeof(*interiors));
+        if (ps_j) frame->ps_j = ps_j;
+        if (m_j) frame->m_j = m_j;
+        if (interiors) frame->interiors = interiors;
+        if (ps_j == NULL || m_j == NULL || interiors == NULL){
+            frame->computed = 0;
+            rebx_error(rebx, "REBOUNDx Error: Could not allocate memory.\n");
+            return NULL;
+        }
+        frame->N_allocated = N;
+    }
+    // Outside rebx_additional_forces the particles may have moved since the last call
+    if (frame->N != N || !rebx->evaluating_forces){
+        frame->computed = 0;
+    }
+    frame->N = N;
+
+    const unsigned int missing = parts & ~frame->computed;
+    if (missing & REBX_JACOBI_POSVEL){
+        reb_particles_transform_inertial_to_jacobi_posvel(particles, frame->ps_j, particles, N, N);
+    }
+    if (missing & REBX_JACOBI_MASSES){
+        rebx_calculate_jacobi_masses(particles, frame->m_j, N);
+    }
+    if (missing & REBX_JACOBI_INTERIORS){
+        // Run through backwards removing particles from the full com, in the same order as rebx_com_force always has
+        struct reb_particle com = reb_simulation_com(sim);
+        for (int i=N-1; i>0; i--){
+            com = rebx_get_com_without_particle(com, particles[i]);
+            frame->interiors[i] = com;
+        }
+        frame->interiors[0] = (struct reb_particle){0};
+    }
+    frame->computed |= missing;
+    return frame;
+}
+
+void rebx_free_jacobi_frame(struct rebx_jacobi_frame* const frame){
+    if (frame == NULL){
+        return;
+    }
+    free(frame->ps_j);
+    free(frame->m_j);
+    free(frame->interiors);
+    free(frame);
+}
+
 double rebx_Edot(struct reb_particle* const ps, const int N){
     double Edot = 0.;
     for(int i=0; i<N; i++){
@@ -63,8 +119,87 @@ double rebx_Edot(struct reb_particle* const ps, const int N){
     return Edot;
 }
 
-void rebx_com_force(struct reb_simulation* const sim, struct rebx_force* const force, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, struct reb_vec3d (*calculate_force) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* p, struct reb_particle* source), struct reb_particle* const particles, const int N){
+// Room needed for a batch of N particles: 21 arrays of doubles followed by the indices
+static size_t rebx_com_batch_size(const int N){
+    return (size_t)N*(21*sizeof(double) + sizeof(int));
+}
+
+static void rebx_com_batch_init(struct rebx_com_batch* const batch, void* const memory, const int N, const enum REBX_COORDINATES coordinates, const int refindex, const int cacheable){
+    double** const arrays[21] = {&batch->m, &batch->x, &batch->y, &batch->z, &batch->vx, &batch->vy, &batch->vz,
+        &batch->source_m, &batch->source_x, &batch->source_y, &batch->source_z, &batch->source_vx, &batch->source_vy, &batch->source_vz,
+        &batch->ax, &batch->ay, &batch->az, &batch->a, &batch->e, &batch->inc, &batch->P};
+    double* const d = memory;
+    for (int j=0; j<21; j++){
+        *arrays[j] = d + (size_t)j*N;
+    }
+    batch->indices = (int*)(d + (size_t)21*N);
+    batch->N = 0;
+    batch->coordinates = coordinates;
+    batch->refindex = refindex;
+    batch->cacheable = cacheable;
+}
+
+static void rebx_com_batch_add(struct rebx_com_batch* const batch, const int index, const struct reb_particle* const p, const struct reb_particle* const source){
+    const int k = batch->N++;
+    batch->indices[k] = index;
+    batch->m[k] = p->m;
+    batch->x[k] = p->x;
+    batch->y[k] = p->y;
+    batch->z[k] = p->z;
+    batch->vx[k] = p->vx;
+    batch->vy[k] = p->vy;
+    batch->vz[k] = p->vz;
+    batch->source_m[k] = source->m;
+    batch->source_x[k] = source->x;
+    batch->source_y[k] = source->y;
+    batch->source_z[k] = source->z;
+    batch->source_vx[k] = source->vx;
+    batch->source_vy[k] = source->vy;
+    batch->source_vz[k] = source->vz;
+}
+
+struct reb_particle rebx_com_batch_particle(const struct rebx_com_batch* const batch, const int k){
+    struct reb_particle p = {0};
+    p.m = batch->m[k];
+    p.x = batch->x[k];
+    p.y = batch->y[k];
+    p.z = batch->z[k];
+    p.vx = batch->vx[k];
+    p.vy = batch->vy[k];
+    p.vz = batch->vz[k];
+    return p;
+}
+
+struct reb_particle rebx_com_batch_source(const struct rebx_com_batch* const batch, const int k){
+    struct reb_particle source = {0};
+    source.m = batch->source_m[k];
+    source.x = batch->source_x[k];
+    source.y = batch->source_y[k];
+    source.z = batch->source_z[k];
+    source.vx = batch->source_vx[k];
+    source.vy = batch->source_vy[k];
+    source.vz = batch->source_vz[k];
+    return source;
+}
+
+int rebx_com_batch_reference(struct reb_simulation* const sim, struct rebx_force* const force, struct rebx_com_batch* const batch, struct reb_particle* const particles, const int N, const int refindex){
+    void* const workspace = rebx_get_force_workspace(sim, force, rebx_com_batch_size(N));
+    if (workspace == NULL){
+        return 0;
+    }
+    rebx_com_batch_init(batch, workspace, N, REBX_COORDINATES_PARTICLE, refindex, particles == sim->particles);
+    return 1;
+}
+
+void rebx_com_batch_add_reference(struct rebx_com_batch* const batch, const struct reb_particle* const particles, const int index){
+    rebx_com_batch_add(batch, index, &particles[index], &particles[batch->refindex]);
+}
+
+void rebx_com_force(struct reb_simulation* const sim, struct rebx_force* const force, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, void (*calculate_forces) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, struct rebx_com_batch* const batch), struct reb_particle* const particles, const int N){
     struct rebx_extras* const rebx = sim->extras;
+    if (N < 1){
+        return;
+    }
     struct reb_particle com = reb_simulation_com(sim); // Start with full com for jacobi and barycentric coordinates.
 
     int refindex = -1;
@@ -72,69 +207,92 @@ void rebx_com_force(struct reb_simulation* const sim, struct rebx_force* const f
         refindex = 0;                           // There is no jacobi coordinate for the 0th particle, so set refindex to skip it in loop below.
     }
     else if(coordinates == REBX_COORDINATES_PARTICLE){
-        for (int i=0; i < N; i++){
-			struct reb_particle* p = &particles[i];
-            const int* const reference = rebx_get_param(rebx, p->ap, reference_name);
-            if (reference){
-                com = particles[i];
-                refindex = i;
-                break;
-            }
-            if (i == N-1){
-                char str[200];
-                sprintf(str, "Coordinates set to REBX_COORDINATES_PARTICLE, but %s param was not found in any particle.  Need to set parameter.\n", reference_name);
-                reb_simulation_error(sim, str);
-            }
+        const int reference_id = rebx_get_param_id(rebx, reference_name);
+        const struct rebx_role_list* const references = (reference_id < 0) ? NULL : rebx_get_role_particles(rebx, reference_id, particles, N);
+        if (references == NULL || references->N_roles == 0){
+            char str[200];
+            sprintf(str, "Coordinates set to REBX_COORDINATES_PARTICLE, but %s param was not found in any particle.  Need to set parameter.\n", reference_name);
+            reb_simulation_error(sim, str);
+            return;
         }
+        refindex = references->indices[0];  // the first particle with the param is the reference
+        com = particles[refindex];
     }
 
+    void* const workspace = rebx_get_force_workspace(sim, force, rebx_com_batch_size(N));
+    if (workspace == NULL){
+        return;
+    }
+    struct rebx_com_batch batch;
+    rebx_com_batch_init(&batch, workspace, N, coordinates, refindex, particles == sim->particles); // integrators pass forces temporary particle arrays
 
-    for(int i=N-1; i>=0; i--){ // Run through backwards so each iteration does not depend on previous ones in Jacobi coordinates.
+    // The forces only depend on positions, velocities and masses, so the frames of all particles can be built before calculating any of them.
+    // Run through backwards, the order in which Jacobi coordinates remove particles from the com. The interior coms are shared by all forces in an evaluation.
+    const struct rebx_jacobi_frame* const jacobi = (coordinates == REBX_COORDINATES_JACOBI) ? rebx_get_jacobi_frame(sim, particles, N, REBX_JACOBI_INTERIORS) : NULL;
+    for(int i=N-1; i>=0; i--){
         if (i==refindex){
             continue;
         }
-        struct reb_particle* p = &particles[i];
+        if (jacobi != NULL){
+            com = jacobi->interiors[i];
+        }
+        else if (coordinates == REBX_COORDINATES_JACOBI){
+            com = rebx_get_com_without_particle(com, particles[i]);
+        }
+        rebx_com_batch_add(&batch, i, &particles[i], &com);
+    }
+    if (batch.N > 0){
+        calculate_forces(sim, force, particles, &batch);
+    }
+
+    // Back reactions are accumulated in a running sum and applied once per particle, rather than looping over all the particles for each perturbed particle.
+    struct reb_vec3d back_reaction = {0};
+    for(int k=0; k<batch.N; k++){
+        struct reb_particle* p = &particles[batch.indices[k]];
         if (coordinates == REBX_COORDINATES_JACOBI){
-            com = rebx_get_com_without_particle(com, *p);
+            // particle has to feel the back reactions from all outer particles
+            p->ax -= back_reaction.x;
+            p->ay -= back_reaction.y;
+            p->az -= back_reaction.z;
         }
 
-        struct reb_vec3d a = calculate_force(sim, force, p, &com);
+        const struct reb_vec3d a = {.x = batch.ax[k], .y = batch.ay[k], .z = batch.az[k]};
         p->ax += a.x;
         p->ay += a.y;
         p->az += a.z;
 
+        const double source_m = batch.source_m[k];
         double massratio;
         switch(coordinates){
             case REBX_COORDINATES_BARYCENTRIC:
-                massratio = p->m/com.m;
-                for(int j=0; j < N; j++){
-                    particles[j].ax -= massratio*a.x;
-                    particles[j].ay -= massratio*a.y;
-                    particles[j].az -= massratio*a.z;
-                }
+                massratio = p->m/source_m;
+                back_reaction.x += massratio*a.x;  // applied to all particles after the loop
+                back_reaction.y += massratio*a.y;
+                back_reaction.z += massratio*a.z;
                 break;
             case REBX_COORDINATES_JACOBI:
                 if(back_reactions_inclusive){
-                    massratio = p->m/(com.m + p->m);
+                    massratio = p->m/(source_m + p->m);
+                    p->ax -= massratio*a.x;
+                    p->ay -= massratio*a.y;
+                    p->az -= massratio*a.z;
                 }
                 else{
-                    massratio = p->m/com.m;
-                }
-                for(int j=0; j < i + back_reactions_inclusive; j++){    // stop at j=i if inclusive, at i-1 if not
-                    particles[j].ax -= massratio*a.x;
-                    particles[j].ay -= massratio*a.y;
-                    particles[j].az -= massratio*a.z;
+                    massratio = p->m/source_m;
                 }
+                back_reaction.x += massratio*a.x;  // applied to inner particles as the loop reaches them
+                back_reaction.y += massratio*a.y;
+                back_reaction.z += massratio*a.z;
                 break;
             case REBX_COORDINATES_PARTICLE:
                 if(back_reactions_inclusive){
-                    massratio = p->m/(com.m + p->m);
+                    massratio = p->m/(source_m + p->m);
                     p->ax -= massratio*a.x;
                     p->ay -= massratio*a.y;
                     p->az -= massratio*a.z;
                 }
                 else{
-                    massratio = p->m/com.m;
+                    massratio = p->m/source_m;
                 }
                 particles[refindex].ax -= massratio*a.x;
                 particles[refindex].ay -= massratio*a.y;
@@ -144,6 +302,19 @@ void rebx_com_force(struct reb_simulation* const sim, struct rebx_force* const f
                 reb_simulation_error(sim, "Coordinates not supported in REBOUNDx.\n");
         }
     }
+
+    if (coordinates == REBX_COORDINATES_BARYCENTRIC){
+        for(int j=0; j < N; j++){
+            particles[j].ax -= back_reaction.x;
+            particles[j].ay -= back_reaction.y;
+            particles[j].az -= back_reaction.z;
+        }
+    }
+    else if (coordinates == REBX_COORDINATES_JACOBI){
+        particles[0].ax -= back_reaction.x;
+        particles[0].ay -= back_reaction.y;
+        particles[0].az -= back_reaction.z;
+    }
 }
 
 static inline void rebx_subtract_posvel(struct reb_particle* p, struct reb_particle* diff, const double massratio){
@@ -156,13 +327,16 @@ static inline void rebx_subtract_posvel(struct reb_particle* p, struct reb_parti
 }
 
 /* only accepts one reference particle if coordinates=REBX_COORDINATES_PARTICLE.
- * calculate_effect function should check for edge case where particle and reference are the same
+ * calculate_steps function should check for edge case where particle and reference are the same
  * (could happen e.g. with barycentric coordinates with test particles and single massive body)
  */
 
-void rebx_tools_com_ptm(struct reb_simulation* const sim, struct rebx_operator* const operator, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, struct reb_particle (*calculate_step) (struct reb_simulation* const sim, struct rebx_operator* const operator, struct reb_particle* p, struct reb_particle* source, const double dt), const double dt){
+void rebx_tools_com_ptm(struct reb_simulation* const sim, struct rebx_operator* const operator, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, void (*calculate_steps) (struct reb_simulation* const sim, struct rebx_operator* const operator, struct reb_particle* const particles, struct rebx_com_batch* const batch, const void* const context, const double dt), const void* const context, const double dt){
     struct rebx_extras* const rebx = sim->extras;
     const int N_real = sim->N - sim->N_var;
+    if (N_real < 1){
+        return;
+    }
     struct reb_particle com = reb_simulation_com(sim); // Start with full com for jacobi and barycentric coordinates.
 
     int refindex = -1;
@@ -170,59 +344,93 @@ void rebx_tools_com_ptm(struct reb_simulation* const sim, struct rebx_operator*
         refindex = 0;                           // There is no jacobi coordinate for the 0th particle, so should skip index 0
     }
     else if(coordinates == REBX_COORDINATES_PARTICLE){
-        for (int i=0; i < N_real; i++){
-            struct reb_particle* p = &sim->particles[i];
-            const int* const reference = rebx_get_param(rebx, p->ap, reference_name);
-            if (reference){
-                com = sim->particles[i];
-                refindex = i;
-                break;
-            }
-            if (i == N_real-1){
-                char str[200];
-                sprintf(str, "Coordinates set to REBX_COORDINATES_PARTICLE, but %s param was not found in any particle.  Need to set parameter.\n", reference_name);
-                reb_simulation_error(sim, str);
-            }
+        const int reference_id = rebx_get_param_id(rebx, reference_name);
+        const struct rebx_role_list* const references = (reference_id < 0) ? NULL : rebx_get_role_particles(rebx, reference_id, sim->particles, N_real);
+        if (references == NULL || references->N_roles == 0){
+            char str[200];
+            sprintf(str, "Coordinates set to REBX_COORDINATES_PARTICLE, but %s param was not found in any particle.  Need to set parameter.\n", reference_name);
+            reb_simulation_error(sim, str);
+            return;
         }
+        refindex = references->indices[0];  // the first particle with the param is the reference
+        com = sim->particles[refindex];
     }
 
+    // In Jacobi and barycentric coordinates, the input state of each particle includes the back reactions of the particles modified before it,
+    // so those have to be stepped one at a time. Relative to a reference particle, all the inputs are known up front and go to the kernel in one batch.
+    const int sequential = (coordinates != REBX_COORDINATES_PARTICLE);
+    const int N_batch = sequential ? 1 : N_real;
+    void* const workspace = rebx_get_operator_workspace(sim, operator, rebx_com_batch_size(N_batch));
+    if (workspace == NULL){
+        return;
+    }
+    struct rebx_com_batch batch;
+    rebx_com_batch_init(&batch, workspace, N_batch, coordinates, refindex, 0); // states change with every step, so nothing to share
+    if (!sequential){
+        for(int i=N_real-1; i>=0; i--){
+            if (i!=refindex){
+                rebx_com_batch_add(&batch, i, &sim->particles[i], &com);
+            }
+        }
+        if (batch.N > 0){
+            calculate_steps(sim, operator, sim->particles, &batch, context, dt);
+        }
+    }
 
+    // Back reactions are accumulated in a running sum rather than looping over all the particles for each modified particle.
+    // In barycentric coordinates every particle is shifted by each back reaction, including ones not yet modified (whose input state to calculate_steps therefore includes the shifts so far).
+    // So that all particles can be shifted by the total once at the end, each modified particle is pre-compensated for the shifts it has already received.
+    struct reb_particle back_reaction = {0};
+    int k = 0;
     for(int i=N_real-1; i>=0; i--){ // Run through backwards so each iteration does not depend on previous ones in Jacobi coordinates.
         if (i==refindex){
             continue;
         }
         struct reb_particle* p = &sim->particles[i];
-        if (coordinates == REBX_COORDINATES_JACOBI){
-            com = rebx_get_com_without_particle(com, *p);
+        if (sequential){
+            rebx_subtract_posvel(p, &back_reaction, 1.); // back reactions from particles modified so far
+            if (coordinates == REBX_COORDINATES_JACOBI){
+                com = rebx_get_com_without_particle(com, *p);
+            }
+            batch.N = 0;
+            rebx_com_batch_add(&batch, i, p, &com);
+            calculate_steps(sim, operator, sim->particles, &batch, context, dt);
         }
 
-        struct reb_particle modified_particle = calculate_step(sim, operator, p, &com, dt);
-        struct reb_particle diff = rebx_particle_minus(modified_particle, *p);
-        p->x = modified_particle.x;
-        p->y = modified_particle.y;
-        p->z = modified_particle.z;
-        p->vx = modified_particle.vx;
-        p->vy = modified_particle.vy;
-        p->vz = modified_particle.vz;
+        struct reb_particle diff = {0};
+        diff.x = batch.x[k] - p->x;
+        diff.y = batch.y[k] - p->y;
+        diff.z = batch.z[k] - p->z;
+        diff.vx = batch.vx[k] - p->vx;
+        diff.vy = batch.vy[k] - p->vy;
+        diff.vz = batch.vz[k] - p->vz;
+        p->x = batch.x[k];
+        p->y = batch.y[k];
+        p->z = batch.z[k];
+        p->vx = batch.vx[k];
+        p->vy = batch.vy[k];
+        p->vz = batch.vz[k];
+        if (!sequential){
+            k++;
+        }
 
         double massratio;
         switch(coordinates){
             case REBX_COORDINATES_BARYCENTRIC:
                 massratio = p->m/com.m;
-                for(int j=0; j < N_real; j++){
-                    rebx_subtract_posvel(&sim->particles[j], &diff, massratio);
-                }
+                rebx_subtract_posvel(&back_reaction, &diff, -massratio);
+                rebx_subtract_posvel(p, &diff, massratio);
+                rebx_subtract_posvel(p, &back_reaction, -1.); // undone by the shift of all particles after the loop
                 break;
             case REBX_COORDINATES_JACOBI:
                 if(back_reactions_inclusive){
                     massratio = p->m/(com.m + p->m);
+                    rebx_subtract_posvel(p, &diff, massratio);
                 }
                 else{
                     massratio = p->m/com.m;
                 }
-                for(int j=0; j < i + back_reactions_inclusive; j++){    // stop at j=i if inclusive, at i-1 if not
-                    rebx_subtract_posvel(&sim->particles[j], &diff, massratio);
-                }
+                rebx_subtract_posvel(&back_reaction, &diff, -massratio); // applied to inner particles as the loop reaches them
                 break;
             case REBX_COORDINATES_PARTICLE:
                 if(back_reactions_inclusive){
@@ -238,6 +446,15 @@ void rebx_tools_com_ptm(struct reb_simulation* const sim, struct rebx_operator*
                 reb_simulation_error(sim, "Coordinates not supported in REBOUNDx.\n");
         }
     }
+
+    if (coordinates == REBX_COORDINATES_BARYCENTRIC){
+        for(int j=0; j < N_real; j++){
+            rebx_subtract_posvel(&sim->particles[j], &back_reaction, 1.);
+        }
+    }
+    else if (coordinates == REBX_COORDINATES_JACOBI){
+        rebx_subtract_posvel(&sim->particles[0], &back_reaction, 1.);
+    }
 }
 
 struct reb_vec3d rebx_tools_spin_angular_momentum(struct rebx_extras* const rebx){
@@ -245,10 +462,12 @@ struct reb_vec3d rebx_tools_spin_angular_momentum(struct rebx_extras* const rebx
     // Add spin angular momentum of any particles with spin parameters set
     const int N_real = sim->N - sim->N_var;
     struct reb_vec3d L = {0.};
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
+    const int I_id = rebx_get_param_id(rebx, "I");
     for (int i=0;i<N_real;i++){
 		struct reb_particle* pi = &sim->particles[i];
-        const struct reb_vec3d* Omega = rebx_get_param(rebx, pi->ap, "Omega");
-        const double* I = rebx_get_param(rebx, pi->ap, "I");
+        const struct reb_vec3d* Omega = rebx_get_param_by_id(rebx, pi->ap, Omega_id);
+        const double* I = rebx_get_param_by_id(rebx, pi->ap, I_id);
 
         if (Omega != NULL && I != NULL){
           L.x += (*I) * (Omega->x);
@@ -263,10 +482,11 @@ void rebx_simulation_irotate(struct rebx_extras* const rebx, const struct reb_ro
     // Modified from celmech nbody_simulation_utilities.py to include spin angular momentum
     struct reb_simulation* const sim = rebx->sim;
     reb_simulation_irotate(sim, q); // rotate all the orbits first
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
     for (int i=0; i<sim->N; i++){
         struct reb_particle* p = &sim->particles[i];
         // Rotate spins
-        struct reb_vec3d* Omega = rebx_get_param(rebx, p->ap, "Omega");
+        struct reb_vec3d* Omega = rebx_get_param_by_id(rebx, p->ap, Omega_id);
         if (Omega != NULL){
             reb_vec3d_irotate(Omega, q);
         }
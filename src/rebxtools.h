@@ -33,11 +33,84 @@ struct reb_orbit;
 struct reb_vec3d;
 struct rebx_force;
 struct rebx_operator;
+struct rebx_jacobi_frame;
 enum REBX_COORDINATES;
 
-void rebx_com_force(struct reb_simulation* const sim, struct rebx_force* const force, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, struct reb_vec3d (*calculate_force) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* p, struct reb_particle* source), struct reb_particle* const particles, const int N);
+/*
+ * Particles and the com (or reference particle) each one is referred to, passed as arrays (structure of arrays)
+ * to the kernels of rebx_com_force and rebx_tools_com_ptm, so that a kernel loops over all the particles in one call.
+ */
+struct rebx_com_batch{
+    int N;                  // Number of particles in the batch
+    int* indices;           // indices[k] is the index of the k-th particle in the particle array
+    double* m;              // Particle masses
+    double* x;              // Particle positions and velocities (operator kernels overwrite them with the updated states)
+    double* y;
+    double* z;
+    double* vx;
+    double* vy;
+    double* vz;
+    double* source_m;       // Mass, position and velocity of the com or reference particle each particle is referred to
+    double* source_x;
+    double* source_y;
+    double* source_z;
+    double* source_vx;
+    double* source_vy;
+    double* source_vz;
+    double* ax;             // Accelerations calculated by force kernels
+    double* ay;
+    double* az;
+    double* a;              // Orbital elements of the particles relative to their sources, filled by rebx_com_batch_orbits
+    double* e;
+    double* inc;
+    double* P;
+    int coordinates;        // enum REBX_COORDINATES of the sources
+    int refindex;           // Index of the reference particle (-1 for barycentric, 0 for Jacobi coordinates)
+    int cacheable;          // 1 if the batch holds the current state of sim->particles, so its elements can be shared through rebx->orbit_cache
+};
+
+// Kernels fill batch->ax/ay/az for all N particles in the batch. They must only depend on positions, velocities and masses.
+void rebx_com_force(struct reb_simulation* const sim, struct rebx_force* const force, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, void (*calculate_forces) (struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, struct rebx_com_batch* const batch), struct reb_particle* const particles, const int N);
+
+// Kernels overwrite the positions and velocities in the batch with the updated states. context is passed through to every kernel call,
+// so that the operator can resolve its params once per step rather than once per batch (one per particle in Jacobi and barycentric coordinates).
+void rebx_tools_com_ptm(struct reb_simulation* const sim, struct rebx_operator* const operator, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, void (*calculate_steps) (struct reb_simulation* const sim, struct rebx_operator* const operator, struct reb_particle* const particles, struct rebx_com_batch* const batch, const void* const context, const double dt), const void* const context, const double dt);
+
+// k-th particle (only mass, position and velocity) and its source in a batch, e.g. to pass to reb_orbit_from_particle
+struct reb_particle rebx_com_batch_particle(const struct rebx_com_batch* const batch, const int k);
+struct reb_particle rebx_com_batch_source(const struct rebx_com_batch* const batch, const int k);
+
+// Starts an empty batch in the force's workspace for up to N particles referred to particles[refindex], for effects that don't go through rebx_com_force
+// but need the particles' orbits from rebx_com_batch_orbits. Returns 0 (after raising an error) if out of memory.
+int rebx_com_batch_reference(struct reb_simulation* const sim, struct rebx_force* const force, struct rebx_com_batch* const batch, struct reb_particle* const particles, const int N, const int refindex);
+// Adds particles[index] to a batch started by rebx_com_batch_reference
+void rebx_com_batch_add_reference(struct rebx_com_batch* const batch, const struct reb_particle* const particles, const int index);
+
+// Fills the requested elements (REBX_ORBIT_ELEMENTS bits) of all particles in the batch, from rebx->orbit_cache where possible. Call before entering parallel loops.
+void rebx_com_batch_orbits(struct reb_simulation* const sim, struct rebx_com_batch* const batch, const unsigned int elements);
+
+/*
+ * Jacobi quantities of sim->particles shared by the effects that need them. While rebx_additional_forces calls the forces
+ * the particles don't move, so each part is only calculated by the first effect that asks for it in an evaluation.
+ */
+enum REBX_JACOBI_PARTS{
+    REBX_JACOBI_POSVEL = 1,     // ps_j
+    REBX_JACOBI_MASSES = 2,     // m_j
+    REBX_JACOBI_INTERIORS = 4,  // interiors
+};
+
+struct rebx_jacobi_frame{
+    int N;                          // Number of particles
+    int N_allocated;                // Allocated length of the arrays below
+    unsigned int computed;          // REBX_JACOBI_PARTS bits of the parts that are up to date
+    struct reb_particle* ps_j;      // Jacobi positions and velocities from reb_particles_transform_inertial_to_jacobi_posvel
+    double* m_j;                    // Jacobi masses from rebx_calculate_jacobi_masses
+    struct reb_particle* interiors; // interiors[i] is the com of particles 0 to i-1 (mass, position and velocity) that rebx_com_force refers particle i to
+};
 
-void rebx_tools_com_ptm(struct reb_simulation* const sim, struct rebx_operator* const operator, const enum REBX_COORDINATES coordinates, const int back_reactions_inclusive, const char* reference_name, struct reb_particle (*calculate_step) (struct reb_simulation* const sim, struct rebx_operator* const operator, struct reb_particle* p, struct reb_particle* source, const double dt), const double dt);
+// Returns the frame with the requested parts (REBX_JACOBI_PARTS bits) up to date, or NULL if particles is not sim->particles (e.g. temporary arrays in integrate_force) or out of memory.
+// The returned pointer is owned by rebx and the contents are only valid until the particles move. Not thread safe; call before entering parallel loops.
+const struct rebx_jacobi_frame* rebx_get_jacobi_frame(struct reb_simulation* const sim, const struct reb_particle* const particles, const int N, const unsigned int parts);
 
 double rebx_Edot(struct reb_particle* const ps, const int N);
 
@@ -36,6 +36,8 @@
  * ======================= ===============================================
  * 
  * This applies stochastic forces to particles in the simulation.  
+ * Random numbers are drawn from a counter-based generator keyed by the simulation's rand_seed, the particle's hash (or index if it has none), the step number and the component.
+ * Each particle's kicks are therefore reproducible on their own, independent of the order in which particles are processed, and restarts from binaries reproduce the same sequence.
  * 
  * **Effect Parameters**
  * 
@@ -59,76 +61,196 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "reboundx.h"
 
+/*
+ * Random numbers come from the counter-based Philox4x32-10 generator (Salmon et al. 2011). Each draw is a pure
+ * function of (sim->rand_seed, particle, step, call within the step, component), so particles can be processed
+ * in any order or in parallel, a single particle's kicks can be reproduced exactly, and restarting from a binary 
+ * gives the same sequence. No state is advanced in the simulation.
+ */
+static void rebx_philox4x32_10(uint32_t ctr[4], const uint32_t key[2]){
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (int round=0; round<10; round++){
+        const uint64_t p0 = (uint64_t)0xD2511F53*ctr[0];
+        const uint64_t p1 = (uint64_t)0xCD9E8D57*ctr[2];
+        const uint32_t c1 = ctr[1];
+        const uint32_t c3 = ctr[3];
+        ctr[0] = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        ctr[1] = (uint32_t)p1;
+        ctr[2] = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        ctr[3] = (uint32_t)p0;
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+}
+
+// Uniform double in the open interval (0,1) from 64 random bits
+static inline double rebx_uniform_from_bits(const uint32_t hi, const uint32_t lo){
+    const uint64_t bits = ((uint64_t)hi << 32) | lo;
+    return ((double)(bits >> 11) + 0.5)*(1./9007199254740992.); // 2^-53
+}
 
-static void rebx_random_normal2(struct reb_simulation* r, double* n0, double* n1){
-	double v1,v2,rsq=1.;
-	while(rsq>=1. || rsq<1.0e-12){
-		v1=2.*((double)rand_r(&(r->rand_seed)))/((double)(RAND_MAX))-1.0;
-		v2=2.*((double)rand_r(&(r->rand_seed)))/((double)(RAND_MAX))-1.0;
-		rsq=v1*v1+v2*v2;
-	}
-	*n0 = v1*sqrt(-2.*log(rsq)/rsq);
-	*n1 = v2*sqrt(-2.*log(rsq)/rsq);
+// Two independent standard normals (Box-Muller) from one block of the stream
+static void rebx_random_normal2(const uint32_t key[2], const unsigned long long steps_done, const uint32_t call, const uint32_t stream, double* n0, double* n1){
+    uint32_t ctr[4] = {(uint32_t)steps_done, (uint32_t)(steps_done >> 32), call, stream};
+    rebx_philox4x32_10(ctr, key);
+    const double u1 = rebx_uniform_from_bits(ctr[0], ctr[1]);
+    const double u2 = rebx_uniform_from_bits(ctr[2], ctr[3]);
+    const double r = sqrt(-2.*log(u1));
+    *n0 = r*cos(2.*M_PI*u2);
+    *n1 = r*sin(2.*M_PI*u2);
 }
 
+enum REBX_STOCHASTIC_STREAM {
+    REBX_STOCHASTIC_STREAM_RPHI = 0,
+    REBX_STOCHASTIC_STREAM_X = 1,
+    REBX_STOCHASTIC_STREAM_Y = 2,
+    REBX_STOCHASTIC_STREAM_Z = 3,
+};
+
+// Persists across plan rebuilds so that calls within a step keep getting distinct counters
+struct rebx_stochastic_forces_plan{
+    unsigned long long steps_done;  // step during which calls was last incremented
+    uint32_t calls;                 // number of calls so far during that step
+    int started;
+};
 
-void rebx_stochastic_forces(struct reb_simulation* const sim, struct rebx_force* const radiation_forces, struct reb_particle* const particles, const int N){
+int rebx_stochastic_forces_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    if (force->plan == NULL){
+        struct rebx_stochastic_forces_plan* const plan = malloc(sizeof(*plan));
+        if (plan == NULL){
+            reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+            return 0;
+        }
+        plan->steps_done = 0;
+        plan->calls = 0;
+        plan->started = 0;
+        force->plan = plan;
+    }
+    return 1;
+}
+
+// Pointers to one particle's params (NULL if not set) and the center of mass it orbits, gathered serially each call
+struct rebx_stochastic_particle{
+    struct reb_particle com;
+    double* kappa;
+    double* tau_kappa;
+    double* force_r;
+    double* force_phi;
+    double* kappa_xyz[3];
+    double* tau_kappa_xyz[3];
+    double* force_xyz[3];
+};
+
+enum REBX_STOCHASTIC_ERROR {
+    REBX_STOCHASTIC_ERROR_NONE = 0,
+    REBX_STOCHASTIC_ERROR_ORBIT = 1,
+    REBX_STOCHASTIC_ERROR_VARIANCE = 2,
+};
+
+void rebx_stochastic_forces(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
     struct rebx_extras* const rebx = sim->extras;
+    struct rebx_stochastic_forces_plan* const plan = rebx_get_force_plan(sim, force, particles, N);
+    struct rebx_stochastic_particle* const sps = rebx_get_force_workspace(sim, force, N*sizeof(*sps));
+    if (plan == NULL || sps == NULL){
+        return;
+    }
+    if (!plan->started || plan->steps_done != sim->steps_done){
+        plan->started = 1;
+        plan->steps_done = sim->steps_done;
+        plan->calls = 0;
+    }
+    const uint32_t call = plan->calls++;
+    const unsigned long long steps_done = sim->steps_done;
+    const double dt = sim->dt_last_done;
+
+    const int kappa_id = rebx_get_param_id(rebx, "kappa");
+    const int tau_kappa_id = rebx_get_param_id(rebx, "tau_kappa");
+    const int stochastic_force_r_id = rebx_get_param_id(rebx, "stochastic_force_r");
+    const int stochastic_force_phi_id = rebx_get_param_id(rebx, "stochastic_force_phi");
+    const int kappa_xyz_id[3] = {rebx_get_param_id(rebx, "kappa_x"), rebx_get_param_id(rebx, "kappa_y"), rebx_get_param_id(rebx, "kappa_z")};
+    const int tau_kappa_xyz_id[3] = {rebx_get_param_id(rebx, "tau_kappa_x"), rebx_get_param_id(rebx, "tau_kappa_y"), rebx_get_param_id(rebx, "tau_kappa_z")};
+    const int stochastic_force_xyz_id[3] = {rebx_get_param_id(rebx, "stochastic_force_x"), rebx_get_param_id(rebx, "stochastic_force_y"), rebx_get_param_id(rebx, "stochastic_force_z")};
+    const char* const stochastic_force_xyz_names[3] = {"stochastic_force_x", "stochastic_force_y", "stochastic_force_z"};
+    const char* const tau_kappa_xyz_errors[3] = {"Need to set tau_kappa_x to enable stochastic forces.\n", "Need to set tau_kappa_y to enable stochastic forces.\n", "Need to set tau_kappa_z to enable stochastic forces.\n"};
+
+    // Serial pass: add the force state params on the first run (not thread safe), and accumulate the center of mass
+    // interior to each particle with kappa set, which the kicks in the radial/azimuthal directions are relative to.
     struct reb_particle com = particles[0];
-    
     for (int i=0; i<N; i++){
-        double* kappa = rebx_get_param(rebx, particles[i].ap, "kappa");
-        if (i>0 && kappa != NULL){
-            double* stochastic_force_r = rebx_get_param(rebx, particles[i].ap, "stochastic_force_r");
-            if (stochastic_force_r == NULL) { // First run?
+        struct rebx_stochastic_particle* const sp = &sps[i];
+        sp->kappa = (i>0) ? rebx_get_param_by_id(rebx, particles[i].ap, kappa_id) : NULL;
+        if (sp->kappa != NULL){
+            sp->force_r = rebx_get_param_by_id(rebx, particles[i].ap, stochastic_force_r_id);
+            if (sp->force_r == NULL) { // First run?
                 rebx_set_param_double(rebx, (struct rebx_node**)&particles[i].ap, "stochastic_force_r", 0.);
-                stochastic_force_r = rebx_get_param(rebx, particles[i].ap, "stochastic_force_r");
+                sp->force_r = rebx_get_param_by_id(rebx, particles[i].ap, stochastic_force_r_id);
             }
-            double* stochastic_force_phi = rebx_get_param(rebx, particles[i].ap, "stochastic_force_phi");
-            if (stochastic_force_phi == NULL) { // First run?
+            sp->force_phi = rebx_get_param_by_id(rebx, particles[i].ap, stochastic_force_phi_id);
+            if (sp->force_phi == NULL) { // First run?
                 rebx_set_param_double(rebx, (struct rebx_node**)&particles[i].ap, "stochastic_force_phi", 0.);
-                stochastic_force_phi = rebx_get_param(rebx, particles[i].ap, "stochastic_force_phi");
+                sp->force_phi = rebx_get_param_by_id(rebx, particles[i].ap, stochastic_force_phi_id);
+            }
+            sp->tau_kappa = rebx_get_param_by_id(rebx, particles[i].ap, tau_kappa_id);
+            sp->com = com;
+            com = reb_particle_com_of_pair(com, particles[i]);
+        }
+        for (int k=0; k<3; k++){
+            sp->kappa_xyz[k] = rebx_get_param_by_id(rebx, particles[i].ap, kappa_xyz_id[k]);
+            if (sp->kappa_xyz[k] != NULL){
+                sp->force_xyz[k] = rebx_get_param_by_id(rebx, particles[i].ap, stochastic_force_xyz_id[k]);
+                if (sp->force_xyz[k] == NULL) { // First run?
+                    rebx_set_param_double(rebx, (struct rebx_node**)&particles[i].ap, stochastic_force_xyz_names[k], 0.);
+                    sp->force_xyz[k] = rebx_get_param_by_id(rebx, particles[i].ap, stochastic_force_xyz_id[k]);
+                }
+                sp->tau_kappa_xyz[k] = rebx_get_param_by_id(rebx, particles[i].ap, tau_kappa_xyz_id[k]);
+                if (sp->tau_kappa_xyz[k] == NULL){
+                    reb_simulation_error(sim, tau_kappa_xyz_errors[k]);
+                    return;
+                }
             }
+        }
+    }
 
+    int error = REBX_STOCHASTIC_ERROR_NONE;
+#pragma omp parallel for reduction(max:error)
+    for (int i=0; i<N; i++){
+        const struct rebx_stochastic_particle* const sp = &sps[i];
+        const uint32_t key[2] = {sim->rand_seed, particles[i].hash ? particles[i].hash : (uint32_t)i};
+        if (sp->kappa != NULL){
             const struct reb_particle p = particles[i];
+            const struct reb_particle com = sp->com;
 
             // Get auto-correlation time
             int err=0;
-            struct reb_orbit o = reb_orbit_from_particle_err(sim->G, particles[i], com, &err);
+            struct reb_orbit o = reb_orbit_from_particle_err(sim->G, p, com, &err);
             if (err){
-                reb_simulation_error(sim, "An error occured during the orbit calculation in rebx_stochastic_forces.\n");
-                return;
+                error = REBX_STOCHASTIC_ERROR_ORBIT > error ? REBX_STOCHASTIC_ERROR_ORBIT : error;
+                continue;
             }
             double tau = o.P; // Default is current orbital period.
-            
-            double* tau_kappa = rebx_get_param(rebx, particles[i].ap, "tau_kappa");
-            if (tau_kappa != NULL){
-                tau *= *tau_kappa;
+            if (sp->tau_kappa != NULL){
+                tau *= *sp->tau_kappa;
             }
-
-            double dt = sim->dt_last_done;
             
             double prefac = exp(-dt/tau);
 
-            // Decay
-            *stochastic_force_r = (*stochastic_force_r) * prefac;
-            *stochastic_force_phi = (*stochastic_force_phi) * prefac;
-
             double variance = 1.- prefac*prefac;
             if (variance <0.){
-                reb_simulation_error(sim, "Timestep is larger than the correlation time for stochastic forces.\n");
-                return;
+                error = REBX_STOCHASTIC_ERROR_VARIANCE > error ? REBX_STOCHASTIC_ERROR_VARIANCE : error;
+                continue;
             }
             double std = sqrt(variance);
 
             double n0, n1;
-            rebx_random_normal2(sim, &n0, &n1);
+            rebx_random_normal2(key, steps_done, call, REBX_STOCHASTIC_STREAM_RPHI, &n0, &n1);
             
-            // Excitation
-            *stochastic_force_r = (*stochastic_force_r) + n0*std;
-            *stochastic_force_phi = (*stochastic_force_phi) + n1*std;
+            // Decay and excitation
+            *sp->force_r = (*sp->force_r) * prefac + n0*std;
+            *sp->force_phi = (*sp->force_phi) * prefac + n1*std;
 
             const double dx = p.x - com.x; 
             const double dy = p.y - com.y;
@@ -140,113 +262,40 @@ void rebx_stochastic_forces(struct reb_simulation* const sim, struct rebx_force*
             const double dvz = p.vz - com.vz;
             const double dv = sqrt(dvx*dvx + dvy*dvy + dvz*dvz);
 
-            const double force_prefac = (*kappa) *sim->G/(dr*dr)*com.m;
-            particles[i].ax += force_prefac*(*stochastic_force_r*dx/dr + *stochastic_force_phi*dvx/dv);
-            particles[i].ay += force_prefac*(*stochastic_force_r*dy/dr + *stochastic_force_phi*dvy/dv);
-            particles[i].az += force_prefac*(*stochastic_force_r*dz/dr + *stochastic_force_phi*dvz/dv);
-
-
-		    com = reb_particle_com_of_pair(com, p);
-        }
-        double* kappa_x = rebx_get_param(rebx, particles[i].ap, "kappa_x");
-        if (kappa_x != NULL){
-            double* stochastic_force_x = rebx_get_param(rebx, particles[i].ap, "stochastic_force_x");
-            if (stochastic_force_x == NULL) { // First run?
-                rebx_set_param_double(rebx, (struct rebx_node**)&particles[i].ap, "stochastic_force_x", 0.);
-                stochastic_force_x = rebx_get_param(rebx, particles[i].ap, "stochastic_force_x");
-            }
-            
-            double* tau_kappa_x = rebx_get_param(rebx, particles[i].ap, "tau_kappa_x");
-            if (tau_kappa_x == NULL){
-                reb_simulation_error(sim, "Need to set tau_kappa_x to enable stochastic forces.\n");
-                return;
-            }
-
-            double dt = sim->dt_last_done;
-            double prefac = exp(-dt/ (*tau_kappa_x));
-
-            // Decay
-            *stochastic_force_x = (*stochastic_force_x) * prefac;
-
-            // Excitation
-            double variance = 1.- prefac*prefac;
-            if (variance <0.){
-                reb_simulation_error(sim, "Timestep is larger than the correlation time for stochastic forces.\n");
-                return;
-            }
-            double std = (*kappa_x)*sqrt(variance);
-            double n0, n1;
-            rebx_random_normal2(sim, &n0, &n1);
-            *stochastic_force_x = (*stochastic_force_x) + n0*std;
-            
-            particles[i].ax += *stochastic_force_x;
+            const double force_prefac = (*sp->kappa) *sim->G/(dr*dr)*com.m;
+            particles[i].ax += force_prefac*(*sp->force_r*dx/dr + *sp->force_phi*dvx/dv);
+            particles[i].ay += force_prefac*(*sp->force_r*dy/dr + *sp->force_phi*dvy/dv);
+            particles[i].az += force_prefac*(*sp->force_r*dz/dr + *sp->force_phi*dvz/dv);
         }
-        double* kappa_y = rebx_get_param(rebx, particles[i].ap, "kappa_y");
-        if (kappa_y != NULL){
-            double* stochastic_force_y = rebx_get_param(rebx, particles[i].ap, "stochastic_force_y");
-            if (stochastic_force_y == NULL) { // First run?
-                rebx_set_param_double(rebx, (struct rebx_node**)&particles[i].ap, "stochastic_force_y", 0.);
-                stochastic_force_y = rebx_get_param(rebx, particles[i].ap, "stochastic_force_y");
-            }
-            
-            double* tau_kappa_y = rebx_get_param(rebx, particles[i].ap, "tau_kappa_y");
-            if (tau_kappa_y == NULL){
-                reb_simulation_error(sim, "Need to set tau_kappa_y to enable stochastic forces.\n");
-                return;
-            }
-
-            double dt = sim->dt_last_done;
-            double prefac = exp(-dt/ (*tau_kappa_y));
+        double kick[3] = {0., 0., 0.};
+        for (int k=0; k<3; k++){
+            if (sp->kappa_xyz[k] != NULL){
+                double prefac = exp(-dt/ (*sp->tau_kappa_xyz[k]));
 
-            // Decay
-            *stochastic_force_y = (*stochastic_force_y) * prefac;
+                // Excitation
+                double variance = 1.- prefac*prefac;
+                if (variance <0.){
+                    error = REBX_STOCHASTIC_ERROR_VARIANCE > error ? REBX_STOCHASTIC_ERROR_VARIANCE : error;
+                    continue;
+                }
+                double std = (*sp->kappa_xyz[k])*sqrt(variance);
+                double n0, n1;
+                rebx_random_normal2(key, steps_done, call, REBX_STOCHASTIC_STREAM_X + k, &n0, &n1);
 
-            // Excitation
-            double variance = 1.- prefac*prefac;
-            if (variance <0.){
-                reb_simulation_error(sim, "Timestep is larger than the correlation time for stochastic forces.\n");
-                return;
+                // Decay and excitation
+                *sp->force_xyz[k] = (*sp->force_xyz[k]) * prefac + n0*std;
+                kick[k] = *sp->force_xyz[k];
             }
-            double std = (*kappa_y)*sqrt(variance);
-            double n0, n1;
-            rebx_random_normal2(sim, &n0, &n1);
-            *stochastic_force_y = (*stochastic_force_y) + n0*std;
-            
-            particles[i].ay += *stochastic_force_y;
         }
-        double* kappa_z = rebx_get_param(rebx, particles[i].ap, "kappa_z");
-        if (kappa_z != NULL){
-            double* stochastic_force_z = rebx_get_param(rebx, particles[i].ap, "stochastic_force_z");
-            if (stochastic_force_z == NULL) { // First run?
-                rebx_set_param_double(rebx, (struct rebx_node**)&particles[i].ap, "stochastic_force_z", 0.);
-                stochastic_force_z = rebx_get_param(rebx, particles[i].ap, "stochastic_force_z");
-            }
-            
-            double* tau_kappa_z = rebx_get_param(rebx, particles[i].ap, "tau_kappa_z");
-            if (tau_kappa_z == NULL){
-                reb_simulation_error(sim, "Need to set tau_kappa_z to enable stochastic forces.\n");
-                return;
-            }
-
-            double dt = sim->dt_last_done;
-            double prefac = exp(-dt/ (*tau_kappa_z));
-
-            // Decay
-            *stochastic_force_z = (*stochastic_force_z) * prefac;
+        particles[i].ax += kick[0];
+        particles[i].ay += kick[1];
+        particles[i].az += kick[2];
+    }
 
-            // Excitation
-            double variance = 1.- prefac*prefac;
-            if (variance <0.){
-                reb_simulation_error(sim, "Timestep is larger than the correlation time for stochastic forces.\n");
-                return;
-            }
-            double std = (*kappa_z)*sqrt(variance);
-            double n0, n1;
-            rebx_random_normal2(sim, &n0, &n1);
-            *stochastic_force_z = (*stochastic_force_z) + n0*std;
-            
-            particles[i].az += *stochastic_force_z;
-        }
+    if (error == REBX_STOCHASTIC_ERROR_ORBIT){
+        reb_simulation_error(sim, "An error occured during the orbit calculation in rebx_stochastic_forces.\n");
+    }
+    else if (error == REBX_STOCHASTIC_ERROR_VARIANCE){
+        reb_simulation_error(sim, "Timestep is larger than the correlation time for stochastic forces.\n");
     }
 }
-
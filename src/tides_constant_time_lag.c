@@ -119,21 +119,28 @@ static void rebx_calculate_tides(struct reb_particle* source, struct reb_particl
 void rebx_tides_constant_time_lag(struct reb_simulation* const sim, struct rebx_force* const tides, struct reb_particle* const particles, const int N){
     struct rebx_extras* const rebx = sim->extras;
     const double G = sim->G;
+    const int k2_id = rebx_get_param_id(rebx, "tctl_k2");
+    const int tau_id = rebx_get_param_id(rebx, "tctl_tau");
+    const int OmegaMag_id = rebx_get_param_id(rebx, "OmegaMag");
 
     // Calculate tides raised on star
     struct reb_particle* target = &particles[0];// assumes nearly Keplerian motion around a single primary (particles[0])
     if (target->m == 0){                        // nothing makes sense if primary has no mass
         return;
     }
-    double* k2 = rebx_get_param(rebx, target->ap, "tctl_k2");
+    const struct rebx_role_list* const bodies = rebx_get_role_particles(rebx, k2_id, particles, N); // only bodies with k2 set are tidally deformed
+    if (bodies == NULL || bodies->N_roles == 0){
+        return;
+    }
+    double* k2 = (bodies->indices[0] == 0) ? rebx_get_param_by_id(rebx, target->ap, k2_id) : NULL;
     if (k2 != NULL && target->r != 0){  // tides on star only nonzero if k2 and finite size are set
         // We don't require time lag tau to be set. Might just want conservative piece of tidal potential
         double tau = 0.;
         double Omega = 0.;
-        double* tauptr = rebx_get_param(rebx, target->ap, "tctl_tau");
+        double* tauptr = rebx_get_param_by_id(rebx, target->ap, tau_id);
         if (tauptr){
             tau = *tauptr;
-            double* Omegaptr = rebx_get_param(rebx, target->ap, "OmegaMag");
+            double* Omegaptr = rebx_get_param_by_id(rebx, target->ap, OmegaMag_id);
             if (Omegaptr){
                 Omega = *Omegaptr;
             }
@@ -149,18 +156,22 @@ void rebx_tides_constant_time_lag(struct reb_simulation* const sim, struct rebx_
 
     // Calculate tides raised on the planets
     struct reb_particle* source = &particles[0]; // Source is always the star (no planet-planet tides)
-    for (int i=1; i<N; i++){
+    for (int k=0; k<bodies->N_roles; k++){
+        const int i = bodies->indices[k];
+        if (i == 0){
+            continue;
+        }
         struct reb_particle* target = &particles[i]; 
-        double* k2 = rebx_get_param(rebx, target->ap, "tctl_k2");
-        if (k2 == NULL || target->r == 0 || target->m == 0){
+        double* k2 = rebx_get_param_by_id(rebx, target->ap, k2_id);
+        if (target->r == 0 || target->m == 0){
             continue;
         }
         double tau = 0.;
         double Omega = 0.;
-        double* tauptr = rebx_get_param(rebx, target->ap, "tctl_tau");
+        double* tauptr = rebx_get_param_by_id(rebx, target->ap, tau_id);
         if (tauptr){
             tau = *tauptr;
-            double* Omegaptr = rebx_get_param(rebx, target->ap, "OmegaMag");
+            double* Omegaptr = rebx_get_param_by_id(rebx, target->ap, OmegaMag_id);
             if (Omegaptr){
                 Omega = *Omegaptr;
             }
@@ -195,6 +206,7 @@ double rebx_tides_constant_time_lag_potential(struct rebx_extras* const rebx){
     const int N_real = sim->N - sim->N_var;
     struct reb_particle* const particles = sim->particles;
     const double G = sim->G;
+    const int k2_id = rebx_get_param_id(rebx, "tctl_k2");
     double H=0.;
 
     // Calculate tides raised on star
@@ -202,7 +214,7 @@ double rebx_tides_constant_time_lag_potential(struct rebx_extras* const rebx){
     if (target->m == 0){                        // No potential with massless primary
         return 0.;
     }
-    double* k2 = rebx_get_param(rebx, target->ap, "tctl_k2");
+    double* k2 = rebx_get_param_by_id(rebx, target->ap, k2_id);
     if (k2 != NULL && target->r != 0){  // tides on star only nonzero if k2 and finite size are set
         for (int i=1; i<N_real; i++){
             struct reb_particle* source = &particles[i]; // planet raising the tides on the star
@@ -217,7 +229,7 @@ double rebx_tides_constant_time_lag_potential(struct rebx_extras* const rebx){
     struct reb_particle* source = &particles[0]; // Source is always the star (no planet-planet tides)
     for (int i=1; i<N_real; i++){
         struct reb_particle* target = &particles[i]; 
-        double* k2 = rebx_get_param(rebx, target->ap, "tctl_k2");
+        double* k2 = rebx_get_param_by_id(rebx, target->ap, k2_id);
         if (k2 == NULL || target->r == 0 || target->m == 0){
             continue;
         }
@@ -171,11 +171,14 @@ static void rebx_spin_derivatives(struct reb_ode* const ode, double* const yDot,
     struct rebx_extras* const rebx = sim->extras;
     unsigned int Nspins = 0;
     const int N_real = sim->N - sim->N_var;
+    const int k2_id = rebx_get_param_id(rebx, "k2");
+    const int tau_id = rebx_get_param_id(rebx, "tau");
+    const int I_id = rebx_get_param_id(rebx, "I");
     for (int i=0; i<N_real; i++){
         struct reb_particle* pi = &sim->particles[i]; // target particle
-        const double* k2 = rebx_get_param(rebx, pi->ap, "k2"); // This is slow
-        const double* tau = rebx_get_param(rebx, pi->ap, "tau");
-        const double* I = rebx_get_param(rebx, pi->ap, "I");
+        const double* k2 = rebx_get_param_by_id(rebx, pi->ap, k2_id);
+        const double* tau = rebx_get_param_by_id(rebx, pi->ap, tau_id);
+        const double* I = rebx_get_param_by_id(rebx, pi->ap, I_id);
 
         // Particle MUST have k2 and moment of inertia to feel effects
         if (k2 != NULL && I != NULL){
@@ -239,12 +242,14 @@ static void rebx_spin_sync_pre(struct reb_ode* const ode, const double* const y0
     struct rebx_extras* const rebx = sim->extras;
     unsigned int Nspins = 0;
     const int N_real = sim->N - sim->N_var;
+    const int I_id = rebx_get_param_id(rebx, "I");
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
     for (int i=0; i<N_real; i++){
         struct reb_particle* p = &sim->particles[i];
-        double* I = rebx_get_param(rebx, p->ap, "I");
-        struct reb_vec3d* Omega = rebx_get_param(rebx, p->ap, "Omega");
+        double* I = rebx_get_param_by_id(rebx, p->ap, I_id);
+        struct reb_vec3d* Omega = rebx_get_param_by_id(rebx, p->ap, Omega_id);
         if (I != NULL && Omega != NULL){
-            const struct reb_vec3d* Omega = rebx_get_param(rebx, p->ap, "Omega");
+            const struct reb_vec3d* Omega = rebx_get_param_by_id(rebx, p->ap, Omega_id);
             ode->y[3*Nspins] = Omega->x;
             ode->y[3*Nspins+1] = Omega->y;
             ode->y[3*Nspins+2] = Omega->z;
@@ -263,12 +268,16 @@ static void rebx_spin_sync_post(struct reb_ode* const ode, const double* const y
     struct rebx_extras* const rebx = sim->extras;
     unsigned int Nspins = 0;
     const int N_real = sim->N - sim->N_var;
+    const int I_id = rebx_get_param_id(rebx, "I");
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
     for (int i=0; i<N_real; i++){
         struct reb_particle* p = &sim->particles[i];
-        double* I = rebx_get_param(rebx, p->ap, "I");
-        struct reb_vec3d* Omega = rebx_get_param(rebx, p->ap, "Omega");
+        double* I = rebx_get_param_by_id(rebx, p->ap, I_id);
+        struct reb_vec3d* Omega = rebx_get_param_by_id(rebx, p->ap, Omega_id);
         if (I != NULL && Omega != NULL){
-            rebx_set_param_vec3d(rebx, (struct rebx_node**)&p->ap, "Omega", (struct reb_vec3d){.x=y0[3*Nspins], .y=y0[3*Nspins+1], .z=y0[3*Nspins+2]});
+            Omega->x = y0[3*Nspins];
+            Omega->y = y0[3*Nspins+1];
+            Omega->z = y0[3*Nspins+2];
             Nspins += 1;
         }
     }
@@ -282,11 +291,13 @@ void rebx_spin_initialize_ode(struct rebx_extras* const rebx, struct rebx_force*
     struct reb_simulation* sim = rebx->sim;
     unsigned int Nspins = 0;
     const int N_real = sim->N - sim->N_var;
+    const int I_id = rebx_get_param_id(rebx, "I");
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
     for (int i=0; i<N_real; i++){
         struct reb_particle* p = &sim->particles[i];
         // Only track spin if particle has moment of inertia and valid spin axis set
-        double* I = rebx_get_param(rebx, p->ap, "I");
-        struct reb_vec3d* Omega = rebx_get_param(rebx, p->ap, "Omega");
+        double* I = rebx_get_param_by_id(rebx, p->ap, I_id);
+        struct reb_vec3d* Omega = rebx_get_param_by_id(rebx, p->ap, Omega_id);
         if (I != NULL && Omega != NULL){
             Nspins += 1;
         }
@@ -312,12 +323,20 @@ void rebx_tides_spin(struct reb_simulation* const sim, struct rebx_force* const
       reb_simulation_warning(sim, "Spin axes are not being evolved. Call rebx_spin_initialize_ode to evolve\n");
     }
 
-    for (int i=0; i<N; i++){
+    const int k2_id = rebx_get_param_id(rebx, "k2");
+    const int tau_id = rebx_get_param_id(rebx, "tau");
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
+    const struct rebx_role_list* const spinning = rebx_get_role_particles(rebx, Omega_id, particles, N);
+    if (spinning == NULL){
+        return;
+    }
+    for (int k=0; k<spinning->N_roles; k++){
+        const int i = spinning->indices[k];
         struct reb_particle* source = &particles[i];
         // Particle must have a k2 set, otherwise we treat this body as a point particle
-        const double* k2 = rebx_get_param(rebx, source->ap, "k2");
-        const double* tau = rebx_get_param(rebx, source->ap, "tau");
-        const struct reb_vec3d* Omega = rebx_get_param(rebx, source->ap, "Omega");
+        const double* k2 = rebx_get_param_by_id(rebx, source->ap, k2_id);
+        const double* tau = rebx_get_param_by_id(rebx, source->ap, tau_id);
+        const struct reb_vec3d* Omega = rebx_get_param_by_id(rebx, source->ap, Omega_id);
 
         // Particle needs all three spin components and k2 to feel additional forces
         if (Omega != NULL && k2 != NULL){
@@ -378,11 +397,14 @@ double rebx_tides_spin_energy(struct rebx_extras* const rebx){
     const double G = sim->G;
     double E=0.;
 
+    const int k2_id = rebx_get_param_id(rebx, "k2");
+    const int Omega_id = rebx_get_param_id(rebx, "Omega");
+    const int I_id = rebx_get_param_id(rebx, "I");
     for (int i=0; i<N_real; i++){
         struct reb_particle* source = &particles[i];
         // Particle must have a k2, radius and mass set, otherwise we treat this body as a point particle
-        const double* k2 = rebx_get_param(rebx, source->ap, "k2");
-        const struct reb_vec3d* Omegaptr = rebx_get_param(rebx, source->ap, "Omega");
+        const double* k2 = rebx_get_param_by_id(rebx, source->ap, k2_id);
+        const struct reb_vec3d* Omegaptr = rebx_get_param_by_id(rebx, source->ap, Omega_id);
         if (k2 == NULL || source->m == 0 || source->r == 0){
             continue;
         }
@@ -390,7 +412,7 @@ double rebx_tides_spin_energy(struct rebx_extras* const rebx){
         if (Omegaptr != NULL){
             Omega = *Omegaptr;
         }
-        double* I = rebx_get_param(rebx, source->ap, "I");
+        double* I = rebx_get_param_by_id(rebx, source->ap, I_id);
         if (I != NULL){
             const double omega_squared = Omega.x * Omega.x + Omega.y * Omega.y + Omega.z * Omega.z;
             E += 0.5 * (*I) * omega_squared;
@@ -112,103 +112,143 @@ const double rebx_calculate_inclination_damping_timescale(const double wave, con
     return t_i;
 }
 
-static struct reb_vec3d rebx_calculate_modify_orbits_with_type_I_migration(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* p, struct reb_particle* source){
-    double invtau_mig;
-    double tau_e;
-    double tau_inc;
+struct rebx_type_I_migration_plan{
+    enum REBX_COORDINATES coordinates;
+    double beta;
+    double h0;
+    double sd0;
+    double s;
+    double dedge;
+    double hedge;
+};
+
+int rebx_type_I_migration_prepare(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
+    struct rebx_extras* const rebx = sim->extras;
+    if (force->plan == NULL){
+        force->plan = malloc(sizeof(struct rebx_type_I_migration_plan));
+        if (force->plan == NULL){
+            reb_simulation_error(sim, "REBOUNDx Error: Could not allocate memory.\n");
+            return 0;
+        }
+    }
+    struct rebx_type_I_migration_plan* const plan = force->plan;
+    const int* const ptr = rebx_get_param(rebx, force->ap, "coordinates");
+    plan->coordinates = REBX_COORDINATES_JACOBI; // Default
+    if (ptr != NULL){
+        plan->coordinates = *ptr;
+    }
 
     /* Default values for the parameters in case the user forgets to define them when using this code */
-    double beta = 0.0;
-    double h0 = 0.01;
-    double sd0 = 0.0;
-    double s = 0.0;
-    double dedge = 0.0;
-    double hedge = 0.0;
+    plan->beta = 0.0;
+    plan->h0 = 0.01;
+    plan->sd0 = 0.0;
+    plan->s = 0.0;
+    plan->dedge = 0.0;
+    plan->hedge = 0.0;
 
     /* Parameters that should be changed/set in Python notebook or in C outside of this */
-    const double* const dedge_ptr = rebx_get_param(sim->extras, force->ap, "ide_position");
-    const double* const hedge_ptr = rebx_get_param(sim->extras, force->ap, "ide_width");
-    const double* const beta_ptr = rebx_get_param(sim->extras, force->ap, "tIm_flaring_index");
-    const double* const s_ptr = rebx_get_param(sim->extras, force->ap, "tIm_surface_density_exponent");
-    const double* const sd0_ptr = rebx_get_param(sim->extras, force->ap, "tIm_surface_density_1");
-    const double* const h0_ptr = rebx_get_param(sim->extras, force->ap, "tIm_scale_height_1");
-
-    /* Accessing the calculated semi-major axis, eccentricity and inclination for each integration step, via modify_orbits_direct where they are calculated and returned*/
-    int err=0;
-    struct reb_orbit o = reb_orbit_from_particle_err(sim->G, *p, *source, &err);
-  
-    const double a0 = o.a;
-    const double e0 = o.e;
-    const double inc0 = o.inc;
-    const double mp = p->m;  
-    const double ms = source->m;
-
-    const double dvx = p->vx - source->vx;
-    const double dvy = p->vy - source->vy;
-    const double dvz = p->vz - source->vz;
-    const double dx = p->x-source->x;
-    const double dy = p->y-source->y;
-    const double dz = p->z-source->z;
-    const double r2 = dx*dx + dy*dy + dz*dz;
+    const double* const dedge_ptr = rebx_get_param(rebx, force->ap, "ide_position");
+    const double* const hedge_ptr = rebx_get_param(rebx, force->ap, "ide_width");
+    const double* const beta_ptr = rebx_get_param(rebx, force->ap, "tIm_flaring_index");
+    const double* const s_ptr = rebx_get_param(rebx, force->ap, "tIm_surface_density_exponent");
+    const double* const sd0_ptr = rebx_get_param(rebx, force->ap, "tIm_surface_density_1");
+    const double* const h0_ptr = rebx_get_param(rebx, force->ap, "tIm_scale_height_1");
 
     if (beta_ptr != NULL){
-        beta = *beta_ptr;
+        plan->beta = *beta_ptr;
     }
     if (s_ptr != NULL){
-        s = *s_ptr;
+        plan->s = *s_ptr;
     }
     if (sd0_ptr != NULL){
-        sd0 = *sd0_ptr;
+        plan->sd0 = *sd0_ptr;
     }
     if (h0_ptr != NULL){
-        h0 = *h0_ptr;
+        plan->h0 = *h0_ptr;
     }
     if (dedge_ptr != NULL){
-        dedge = *dedge_ptr;
+        plan->dedge = *dedge_ptr;
     }
     if (hedge_ptr != NULL){
-        hedge = *hedge_ptr;
+        plan->hedge = *hedge_ptr;
     }
+    return 1;
+}
 
-    /* Calculating the aspect ratio evaluated at the position of the planet, r and defining other variables */
-
-    const double h = (h0) * pow(r2, beta/2); 
-    const double h2 = h*h;
-
-    const double eh = e0/h;
-    const double ih = inc0/h;
-
+static void rebx_calculate_modify_orbits_with_type_I_migration(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, struct rebx_com_batch* const batch){
+    const struct rebx_type_I_migration_plan* const plan = force->plan;
+    const double beta = plan->beta;
+    const double h0 = plan->h0;
+    const double sd0 = plan->sd0;
+    const double s = plan->s;
+    const double dedge = plan->dedge;
+    const double hedge = plan->hedge;
     const double G = sim->G;
-    const double wave = rebx_calculate_damping_timescale(G, sd0, sqrt(r2), s, ms, mp, a0, h2);
-    invtau_mig = rebx_calculate_planet_trap(a0, dedge, hedge)/(rebx_calculate_migration_timescale(wave, eh, ih, h2, s));
-    tau_e = rebx_calculate_eccentricity_damping_timescale(wave, eh, ih);
-    tau_inc = rebx_calculate_inclination_damping_timescale(wave, eh, ih);
-
-    struct reb_vec3d a = {0};
-
-    if (invtau_mig != 0.0){
-        a.x = -dvx*(invtau_mig);
-        a.y = -dvy*(invtau_mig);
-        a.z = -dvz*(invtau_mig);
+    rebx_com_batch_orbits(sim, batch, REBX_ORBIT_A | REBX_ORBIT_E | REBX_ORBIT_INC);
+
+#pragma omp parallel for
+    for (int k=0; k<batch->N; k++){
+        double invtau_mig;
+        double tau_e;
+        double tau_inc;
+
+        /* Accessing the calculated semi-major axis, eccentricity and inclination for each integration step */
+        const double a0 = batch->a[k];
+        const double e0 = batch->e[k];
+        const double inc0 = batch->inc[k];
+        const double mp = batch->m[k];  
+        const double ms = batch->source_m[k];
+
+        const double dvx = batch->vx[k] - batch->source_vx[k];
+        const double dvy = batch->vy[k] - batch->source_vy[k];
+        const double dvz = batch->vz[k] - batch->source_vz[k];
+        const double dx = batch->x[k] - batch->source_x[k];
+        const double dy = batch->y[k] - batch->source_y[k];
+        const double dz = batch->z[k] - batch->source_z[k];
+        const double r2 = dx*dx + dy*dy + dz*dz;
+
+        /* Calculating the aspect ratio evaluated at the position of the planet, r and defining other variables */
+
+        const double h = (h0) * pow(r2, beta/2); 
+        const double h2 = h*h;
+
+        const double eh = e0/h;
+        const double ih = inc0/h;
+
+        const double wave = rebx_calculate_damping_timescale(G, sd0, sqrt(r2), s, ms, mp, a0, h2);
+        invtau_mig = rebx_calculate_planet_trap(a0, dedge, hedge)/(rebx_calculate_migration_timescale(wave, eh, ih, h2, s));
+        tau_e = rebx_calculate_eccentricity_damping_timescale(wave, eh, ih);
+        tau_inc = rebx_calculate_inclination_damping_timescale(wave, eh, ih);
+
+        double ax = 0.;
+        double ay = 0.;
+        double az = 0.;
+
+        if (invtau_mig != 0.0){
+            ax = -dvx*(invtau_mig);
+            ay = -dvy*(invtau_mig);
+            az = -dvz*(invtau_mig);
+        }
+
+        if (tau_e < INFINITY || tau_inc < INFINITY){
+            const double vdotr = dx*dvx + dy*dvy + dz*dvz;
+            const double prefac = -2*vdotr/r2/tau_e;
+            ax += prefac*dx;
+            ay += prefac*dy;
+            az += prefac*dz - 2*dvz/tau_inc;
+        }
+        batch->ax[k] = ax;
+        batch->ay[k] = ay;
+        batch->az[k] = az;
     }
-
-    if (tau_e < INFINITY || tau_inc < INFINITY){
-        const double vdotr = dx*dvx + dy*dvy + dz*dvz;
-        const double prefac = -2*vdotr/r2/tau_e;
-        a.x += prefac*dx;
-        a.y += prefac*dy;
-        a.z += prefac*dz - 2*dvz/tau_inc;
-    }
-    return a;
 }
 
 void rebx_modify_orbits_with_type_I_migration(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
-    int* ptr = rebx_get_param(sim->extras, force->ap, "coordinates");
-    enum REBX_COORDINATES coordinates = REBX_COORDINATES_JACOBI; // Default
-    if (ptr != NULL){
-        coordinates = *ptr;
+    const struct rebx_type_I_migration_plan* const plan = rebx_get_force_plan(sim, force, particles, N);
+    if (plan == NULL){
+        return;
     }
     const int back_reactions_inclusive = 1;
     const char* reference_name = "primary";
-    rebx_com_force(sim, force, coordinates, back_reactions_inclusive, reference_name, rebx_calculate_modify_orbits_with_type_I_migration, particles, N);
+    rebx_com_force(sim, force, plan->coordinates, back_reactions_inclusive, reference_name, rebx_calculate_modify_orbits_with_type_I_migration, particles, N);
 }
@@ -72,8 +72,9 @@
 #include <stdlib.h>
 #include <float.h>
 #include "reboundx.h"
+#include "rebxtools.h"
 
-static void rebx_calculate_yarkovsky_effect(struct reb_simulation* sim, struct reb_particle* target, struct reb_particle* star, double G, double *density, double *lstar, double *rotation_period, double *Gamma, double *albedo, double *emissivity, double *k, double *c, double *stef_boltz, int *yark_flag, double *sx, double *sy, double *sz){
+static void rebx_calculate_yarkovsky_effect(struct reb_simulation* sim, struct reb_particle* target, struct reb_particle* star, double *density, double *lstar, double *rotation_period, double *Gamma, double *albedo, double *emissivity, double *k, double *c, double *stef_boltz, int *yark_flag, double *sx, double *sy, double *sz, const double P){
     
     int i; //variables needed for future iteration loops
     int j;
@@ -129,8 +130,6 @@ static void rebx_calculate_yarkovsky_effect(struct reb_simulation* sim, struct r
             return;
         }
         
-        struct reb_orbit o = reb_orbit_from_particle(G, *target, *star);
-        
         yarkovsky_magnitude = (3*(*k)*q_yar*(*lstar))/(16*M_PI*radius*(*density)*(*c)*distance*distance);
 
         double Smag = sqrt(((*sx)*(*sx))+ (*sy)*(*sy) + (*sz)*(*sz));
@@ -155,7 +154,7 @@ static void rebx_calculate_yarkovsky_effect(struct reb_simulation* sim, struct r
 
         double tanPhi = 1.0/(1.0+(.5*pow(((*stef_boltz)*(*emissivity))/(M_PI*M_PI*M_PI*M_PI*M_PI), .25))*sqrt((*rotation_period)/((*Gamma)*(*Gamma)))*pow((*lstar*q_yar)/(distance*distance), .75));
     
-        double tanEpsilon = 1.0/(1.0+(.5*pow((*stef_boltz*(*emissivity))/(M_PI*M_PI*M_PI*M_PI*M_PI), .25))*sqrt((o.P)/((*Gamma)*(*Gamma)))*pow((*lstar*q_yar)/(distance*distance), .75));
+        double tanEpsilon = 1.0/(1.0+(.5*pow((*stef_boltz*(*emissivity))/(M_PI*M_PI*M_PI*M_PI*M_PI), .25))*sqrt((P)/((*Gamma)*(*Gamma)))*pow((*lstar*q_yar)/(distance*distance), .75));
     
         double Phi = atan(tanPhi);
         double Epsilon = atan(tanEpsilon);
@@ -218,31 +217,70 @@ static void rebx_calculate_yarkovsky_effect(struct reb_simulation* sim, struct r
 void rebx_yarkovsky_effect(struct reb_simulation* const sim, struct rebx_force* const force, struct reb_particle* const particles, const int N){
         
     struct rebx_extras* const rebx = sim->extras;
-    double G = sim->G;
-    
-    
-    for (int i=1; i<N; i++){
+    double* lstar = rebx_get_param(rebx, force->ap, "ye_lstar");
+    double* c = rebx_get_param(rebx, force->ap, "ye_c");
+    double* stef_boltz = rebx_get_param(rebx, force->ap, "ye_stef_boltz");
+    const int body_density_id = rebx_get_param_id(rebx, "ye_body_density");
+    const int rotation_period_id = rebx_get_param_id(rebx, "ye_rotation_period");
+    const int thermal_inertia_id = rebx_get_param_id(rebx, "ye_thermal_inertia");
+    const int albedo_id = rebx_get_param_id(rebx, "ye_albedo");
+    const int emissivity_id = rebx_get_param_id(rebx, "ye_emissivity");
+    const int k_id = rebx_get_param_id(rebx, "ye_k");
+    const int flag_id = rebx_get_param_id(rebx, "ye_flag");
+    const int spin_axis_x_id = rebx_get_param_id(rebx, "ye_spin_axis_x");
+    const int spin_axis_y_id = rebx_get_param_id(rebx, "ye_spin_axis_y");
+    const int spin_axis_z_id = rebx_get_param_id(rebx, "ye_spin_axis_z");
+    
+    // Particles need ye_flag set to feel the effect
+    const struct rebx_role_list* const bodies = rebx_get_role_particles(rebx, flag_id, particles, N);
+    if (bodies == NULL || bodies->N_roles == 0){
+        return;
+    }
+
+    // The full version needs orbital periods around the star. Get them in one batch, shared with other effects through the orbit cache.
+    struct rebx_com_batch batch;
+    if (!rebx_com_batch_reference(sim, force, &batch, particles, bodies->N_roles, 0)){
+        return;
+    }
+    for (int j=0; j<bodies->N_roles; j++){
+        const int i = bodies->indices[j];
+        const int* const yark_flag = rebx_get_param_by_id(rebx, particles[i].ap, flag_id);
+        if (i != 0 && *yark_flag == 0){
+            rebx_com_batch_add_reference(&batch, particles, i);
+        }
+    }
+    if (batch.N > 0){
+        rebx_com_batch_orbits(sim, &batch, REBX_ORBIT_P);
+    }
+
+    int k_batch = 0;
+    for (int j=0; j<bodies->N_roles; j++){
+        const int i = bodies->indices[j];
+        if (i == 0){
+            continue;
+        }
         
         struct reb_particle* target = &particles[i];
         struct reb_particle* star = &particles[0];
         
-        double* density = rebx_get_param(rebx, target->ap, "ye_body_density");
-        double* lstar = rebx_get_param(rebx, force->ap, "ye_lstar");
-        double* rotation_period = rebx_get_param(rebx, target->ap, "ye_rotation_period");
-        double* Gamma = rebx_get_param(rebx, target->ap, "ye_thermal_inertia");
-        double* albedo = rebx_get_param(rebx, target->ap, "ye_albedo");
-        double* emissivity = rebx_get_param(rebx, target->ap, "ye_emissivity");
-        double* k = rebx_get_param(rebx, target->ap, "ye_k");
-        double* c = rebx_get_param(rebx, force->ap, "ye_c");
-        double* stef_boltz = rebx_get_param(rebx, force->ap, "ye_stef_boltz");
-        int* yark_flag = rebx_get_param(rebx, target->ap, "ye_flag");
-        double* sx = rebx_get_param(rebx, target->ap, "ye_spin_axis_x");
-        double* sy = rebx_get_param(rebx, target->ap, "ye_spin_axis_y");
-        double* sz = rebx_get_param(rebx, target->ap, "ye_spin_axis_z");
+        double* density = rebx_get_param_by_id(rebx, target->ap, body_density_id);
+        double* rotation_period = rebx_get_param_by_id(rebx, target->ap, rotation_period_id);
+        double* Gamma = rebx_get_param_by_id(rebx, target->ap, thermal_inertia_id);
+        double* albedo = rebx_get_param_by_id(rebx, target->ap, albedo_id);
+        double* emissivity = rebx_get_param_by_id(rebx, target->ap, emissivity_id);
+        double* k = rebx_get_param_by_id(rebx, target->ap, k_id);
+        int* yark_flag = rebx_get_param_by_id(rebx, target->ap, flag_id);
+        double* sx = rebx_get_param_by_id(rebx, target->ap, spin_axis_x_id);
+        double* sy = rebx_get_param_by_id(rebx, target->ap, spin_axis_y_id);
+        double* sz = rebx_get_param_by_id(rebx, target->ap, spin_axis_z_id);
+        double P = 0.;
+        if (k_batch < batch.N && batch.indices[k_batch] == i){
+            P = batch.P[k_batch++];
+        }
         
         //if these necessary conditions are met the Yarkovsky effect will be calculated for a particle in the sim
         if (density != NULL && target->r != 0 && albedo != NULL && lstar != NULL && c != NULL && yark_flag != NULL){
-            rebx_calculate_yarkovsky_effect(sim, target, star, G, density, lstar, rotation_period, Gamma, albedo, emissivity, k, c, stef_boltz, yark_flag, sx, sy, sz);
+            rebx_calculate_yarkovsky_effect(sim, target, star, density, lstar, rotation_period, Gamma, albedo, emissivity, k, c, stef_boltz, yark_flag, sx, sy, sz, P);
         }
     }
 }